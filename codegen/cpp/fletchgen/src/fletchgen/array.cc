@@ -25,6 +25,7 @@
 
 #include "fletchgen/bus.h"
 #include "fletchgen/basic_types.h"
+#include "fletchgen/schema.h"
 
 namespace fletchgen {
 
@@ -44,9 +45,15 @@ using fletcher::Mode;
 PARAM_FACTORY(index_width)
 PARAM_FACTORY(tag_width)
 
-// The width of the indices or Arrow.
-// TODO(johanpel): support LARGE_LIST, LARGE_BINARY, LARGE_STRING, etc...
-static const int ARROW_OFFSET_WIDTH = 32;
+/// @brief Return the width of the offsets of a variable-length Arrow type.
+static int GetOffsetWidth(const arrow::DataType &type) {
+  switch (type.id()) {
+    case arrow::Type::LARGE_STRING:
+    case arrow::Type::LARGE_BINARY:
+    case arrow::Type::LARGE_LIST: return ARROW_LARGE_OFFSET_WIDTH;
+    default: return ARROW_OFFSET_WIDTH;
+  }
+}
 
 size_t GetCtrlBufferCount(const arrow::Field &field) {
   fletcher::FieldMetadata field_meta;
@@ -56,7 +63,7 @@ size_t GetCtrlBufferCount(const arrow::Field &field) {
 }
 
 uint32_t GetTagWidth(const arrow::Field &field) {
-  return fletcher::GetUIntMeta(field, fletcher::meta::TAG_WIDTH, 1);
+  return fletcher::GetFieldOptions(field).tag_width;
 }
 
 std::shared_ptr<Type> cmd_type(const std::shared_ptr<Node> &index_width,
@@ -186,7 +193,7 @@ Component *array(Mode mode) {
 }
 
 ConfigType GetConfigType(const arrow::DataType &type) {
-  if (type.id() == arrow::Type::LIST) {
+  if ((type.id() == arrow::Type::LIST) || (type.id() == arrow::Type::LARGE_LIST)) {
     // Detect listprim:
     // Elements must be non-nullable.
     if (!type.field(0)->nullable() && (GetConfigType(*type.field(0)->type()) == ConfigType::PRIM)) {
@@ -198,10 +205,15 @@ ConfigType GetConfigType(const arrow::DataType &type) {
   // listprim(8) types:
   if (type.id() == arrow::Type::BINARY) return ConfigType::LIST_PRIM;
   if (type.id() == arrow::Type::STRING) return ConfigType::LIST_PRIM;
+  if (type.id() == arrow::Type::LARGE_BINARY) return ConfigType::LIST_PRIM;
+  if (type.id() == arrow::Type::LARGE_STRING) return ConfigType::LIST_PRIM;
 
   // Structs
   if (type.id() == arrow::Type::STRUCT) return ConfigType::STRUCT;
 
+  // Fixed-size lists have no offsets, and are streamed as primitives delivering whole lists per transfer.
+  if (type.id() == arrow::Type::FIXED_SIZE_LIST) return ConfigType::PRIM;
+
   // Anything else should be a primitive.
   return ConfigType::PRIM;
 }
@@ -232,6 +244,9 @@ std::shared_ptr<Node> GetWidthNode(const arrow::DataType &type) {
     case arrow::Type::LIST: return strl("OFFSET_WIDTH");
     case arrow::Type::BINARY: return strl("OFFSET_WIDTH");
     case arrow::Type::STRING: return strl("OFFSET_WIDTH");
+    case arrow::Type::LARGE_LIST: return strl("OFFSET_WIDTH");
+    case arrow::Type::LARGE_BINARY: return strl("OFFSET_WIDTH");
+    case arrow::Type::LARGE_STRING: return strl("OFFSET_WIDTH");
 
       // Others:
     default:
@@ -245,6 +260,9 @@ std::shared_ptr<Node> GetWidthNode(const arrow::DataType &type) {
       // Structs have no width
     case arrow::Type::STRUCT: return intl(0);
 
+      // Fixed-size lists have the width of their elements; the list size is in the elements-per-cycle.
+    case arrow::Type::FIXED_SIZE_LIST: return GetWidthNode(*type.field(0)->type());
+
       // Other width types:
     case arrow::Type::FIXED_SIZE_BINARY: {
       const auto *t = dynamic_cast<const arrow::FixedSizeBinaryType *>(&type);
@@ -262,8 +280,9 @@ std::string GenerateConfigString(const arrow::Field &field, int level) {
     level++;
   }
 
-  int epc = fletcher::GetUIntMeta(field, fletcher::meta::VALUE_EPC, 1);
-  int lepc = fletcher::GetUIntMeta(field, fletcher::meta::LIST_EPC, 1);
+  auto options = fletcher::GetFieldOptions(field);
+  int epc = options.epc;
+  int lepc = options.lepc;
 
   bool has_children = false;
 
@@ -275,7 +294,9 @@ std::string GenerateConfigString(const arrow::Field &field, int level) {
     ret += "listprim(";
     level++;
     // Binary and string have no child, so we can't inspect it for the width, which is always 8.
-    if ((field.type()->id() == arrow::Type::BINARY) || (field.type()->id() == arrow::Type::STRING)) {
+    auto id = field.type()->id();
+    if ((id == arrow::Type::BINARY) || (id == arrow::Type::STRING) || (id == arrow::Type::LARGE_BINARY)
+        || (id == arrow::Type::LARGE_STRING)) {
       ret += "8";
     } else {
       // Other list of non-nullable primitives:
@@ -376,8 +397,9 @@ std::shared_ptr<Type> GetStreamType(const arrow::Field &arrow_field, fletcher::M
   //  components! See: hardware/arrays/ArrayConfig_pkg.vhd
 
   // Get the EPC values
-  int epc = fletcher::GetUIntMeta(arrow_field, fletcher::meta::VALUE_EPC, 1);
-  int lepc = fletcher::GetUIntMeta(arrow_field, fletcher::meta::LIST_EPC, 1);
+  auto options = fletcher::GetFieldOptions(arrow_field);
+  int epc = options.epc;
+  int lepc = options.lepc;
 
   // Get their ceiled log2 to determine the count width
   auto e_count_width = static_cast<int>(ceil(log2(epc + 1)));
@@ -386,22 +408,28 @@ std::shared_ptr<Type> GetStreamType(const arrow::Field &arrow_field, fletcher::M
   // Placeholder for the returning type.
   std::shared_ptr<Type> type;
 
+  // The width of the offsets and lengths of variable-length types.
+  auto offset_width = GetOffsetWidth(*arrow_field.type());
+
   // Determine what Cerata type to generate from the Arrow field type.
   switch (arrow_field.type()->id()) {
     // Special case: binary type has a length stream and non-nullable byte stream.
     // The EPC is assumed to relate to the list values.
     // The LEPC can be used for the length stream.
-    case arrow::Type::BINARY: return ListPrimType(epc, lepc, 8, ARROW_OFFSET_WIDTH, "bytes");
+    case arrow::Type::BINARY:
+    case arrow::Type::LARGE_BINARY: return ListPrimType(epc, lepc, 8, offset_width, "bytes");
       // Special case: string type has a length stream and non-nullable utf8 character stream.
       // The EPC is assumed to relate to the list values.
       // The LEPC can be used for the length stream.
       // TODO(johanpel): reconsider the name of the chars stream.
-    case arrow::Type::STRING: return ListPrimType(epc, lepc, 8, ARROW_OFFSET_WIDTH, "chars");
+    case arrow::Type::STRING:
+    case arrow::Type::LARGE_STRING: return ListPrimType(epc, lepc, 8, offset_width, "chars");
 
       // Lists could be either lists of non-nullable primitives, or of something else.
       // If the values are non-nullable primitives, we can use the "listprim" configuration, which has some additional
       // options.
-    case arrow::Type::LIST: {
+    case arrow::Type::LIST:
+    case arrow::Type::LARGE_LIST: {
       // Sanity check, a list should only have one child field.
       if (arrow_field.type()->num_fields() != 1) {
         FLETCHER_LOG(FATAL, "Encountered Arrow list type with other than 1 child.");
@@ -413,7 +441,7 @@ std::shared_ptr<Type> GetStreamType(const arrow::Field &arrow_field, fletcher::M
         auto w = GetFixedWidthTypeBitWidth(*child_field->type());
         FLETCHER_LOG(DEBUG, "Using \"listprim\" configuration for list of non-nullable primitives of width " << w);
         auto values_type = ConvertFixedWidthType(arrow_field.type()->field(0)->type(), epc);
-        return ListPrimType(epc, lepc, w, ARROW_OFFSET_WIDTH, child_field->name());
+        return ListPrimType(epc, lepc, w, offset_width, child_field->name());
       } else {
         // Lists of non-primitive types or nullable primitive types.
         // EPC or LEPC are not supported.
@@ -425,13 +453,19 @@ std::shared_ptr<Type> GetStreamType(const arrow::Field &arrow_field, fletcher::M
                                     field("last", last()),
                                     field("data", values_type),
                                     field("count", count(e_count_width))}));
-        type = record({field("length", length(ARROW_OFFSET_WIDTH)),
+        type = record({field("length", length(offset_width)),
                        field(child_field->name(), child)});
         e_count_width = l_count_width;
       }
       break;
     }
 
+      // Fixed-size lists are streamed as their elements, with an elements-per-cycle that includes the list size.
+    case arrow::Type::FIXED_SIZE_LIST: {
+      type = ConvertFixedWidthType(arrow_field.type()->field(0)->type(), epc);
+      break;
+    }
+
       // Structs
     case arrow::Type::STRUCT: {
       if (arrow_field.type()->num_fields() < 1) {
@@ -477,38 +511,43 @@ std::shared_ptr<Type> GetStreamType(const arrow::Field &arrow_field, fletcher::M
 // TODO(johanpel): move this into GetStreamType
 std::pair<uint32_t, uint32_t> GetArrayDataSpec(const arrow::Field &arrow_field) {
 
-  uint32_t epc = fletcher::GetUIntMeta(arrow_field, fletcher::meta::VALUE_EPC, 1);
-  uint32_t lepc = fletcher::GetUIntMeta(arrow_field, fletcher::meta::LIST_EPC, 1);
+  auto options = fletcher::GetFieldOptions(arrow_field);
+  uint32_t epc = options.epc;
+  uint32_t lepc = options.lepc;
 
   auto e_count_width = static_cast<int>(ceil(log2(epc + 1)));
   auto l_count_width = static_cast<int>(ceil(log2(lepc + 1)));
 
   uint32_t validity_bit = arrow_field.nullable() ? 1 : 0;
+  uint32_t offset_width = GetOffsetWidth(*arrow_field.type());
 
   switch (arrow_field.type()->id()) {
-    case arrow::Type::BINARY: {
+    case arrow::Type::BINARY:
+    case arrow::Type::LARGE_BINARY: {
       auto data_width = epc * 8;
-      auto length_width = lepc * 32;
+      auto length_width = lepc * offset_width;
       return {2, e_count_width + l_count_width + data_width + length_width + validity_bit};
     }
 
-    case arrow::Type::STRING: {
+    case arrow::Type::STRING:
+    case arrow::Type::LARGE_STRING: {
       auto data_width = epc * 8;
-      auto length_width = lepc * 32;
+      auto length_width = lepc * offset_width;
       return {2, e_count_width + l_count_width + data_width + length_width + validity_bit};
     }
 
       // Lists
-    case arrow::Type::LIST: {
+    case arrow::Type::LIST:
+    case arrow::Type::LARGE_LIST: {
       auto child_field = arrow_field.type()->field(0);
       if (GetConfigType(*child_field->type()) == ConfigType::PRIM) {
         auto data_width = GetFixedWidthTypeBitWidth(*child_field->type());
-        return {2, e_count_width + l_count_width + data_width * epc + ARROW_OFFSET_WIDTH * lepc + validity_bit};
+        return {2, e_count_width + l_count_width + data_width * epc + offset_width * lepc + validity_bit};
       } else {
         auto arrow_child = arrow_field.type()->field(0);
         auto elem_spec = GetArrayDataSpec(*arrow_child);
         // Add a length stream to number of streams, and length width to data width.
-        return {elem_spec.first + 1, elem_spec.second + ARROW_OFFSET_WIDTH + validity_bit};
+        return {elem_spec.first + 1, elem_spec.second + offset_width + validity_bit};
       }
     }
 
@@ -533,6 +572,12 @@ std::pair<uint32_t, uint32_t> GetArrayDataSpec(const arrow::Field &arrow_field)
       return spec;
     }
 
+      // Fixed-size lists deliver epc elements of the list type per transfer.
+    case arrow::Type::FIXED_SIZE_LIST: {
+      auto element_width = GetFixedWidthTypeBitWidth(*arrow_field.type()->field(0)->type());
+      return {1, (epc > 1 ? e_count_width : 0) + epc * (element_width + validity_bit)};
+    }
+
       // Non-nested types or unsupported types.
     default: {
       auto fwt = std::dynamic_pointer_cast<arrow::FixedWidthType>(arrow_field.type());
@@ -40,7 +40,7 @@ using RBVector = std::vector<std::shared_ptr<arrow::RecordBatch>>;
 static std::optional<std::shared_ptr<arrow::RecordBatch>> GetRecordBatchWithName(const RBVector &batches,
                                                                                  const std::string &name) {
   for (const auto &b :  batches) {
-    if (fletcher::GetMeta(*b->schema(), fletcher::meta::NAME) == name) {
+    if (fletcher::GetSchemaOptions(*b->schema()).name == name) {
       return b;
     }
   }
@@ -90,6 +90,8 @@ static std::vector<MmioReg> GetDefaultRegs() {
   result.emplace_back(MmioFunction::DEFAULT, MmioBehavior::STATUS, "idle", "Kernel idle status.", 1, 0, 4);
   result.emplace_back(MmioFunction::DEFAULT, MmioBehavior::STATUS, "busy", "Kernel busy status.", 1, 1, 4);
   result.emplace_back(MmioFunction::DEFAULT, MmioBehavior::STATUS, "done", "Kernel done status.", 1, 2, 4);
+  result.emplace_back(MmioFunction::DEFAULT, MmioBehavior::STATUS, "overflow",
+                      "Kernel output overflow status.", 1, 3, 4);
   result.emplace_back(MmioFunction::DEFAULT, MmioBehavior::STATUS, "result", "Result.", 64, 0, 8);
   return result;
 }
@@ -122,7 +124,8 @@ std::vector<MmioReg> Design::ParseCustomRegs(const std::vector<std::string> &reg
 }
 
 /// @brief Generate mmio registers from properly ordered RecordBatchDescriptions.
-std::vector<MmioReg> Design::GetRecordBatchRegs(const std::vector<fletcher::RecordBatchDescription> &batch_desc) {
+std::vector<MmioReg> Design::GetRecordBatchRegs(const std::vector<fletcher::RecordBatchDescription> &batch_desc,
+                                                int index_width) {
   std::vector<MmioReg> result;
 
   // Get first and last indices.
@@ -131,12 +134,12 @@ std::vector<MmioReg> Design::GetRecordBatchRegs(const std::vector<fletcher::Reco
                         MmioBehavior::CONTROL,
                         r.name + "_firstidx",
                         r.name + " first index.",
-                        32);
+                        index_width);
     result.emplace_back(MmioFunction::BATCH,
                         MmioBehavior::CONTROL,
                         r.name + "_lastidx",
                         r.name + " last index (exclusive).",
-                        32);
+                        index_width);
   }
 
   // Get all buffer addresses.
@@ -186,7 +189,7 @@ Design::Design(const std::shared_ptr<Options> &opts) {
   // 3. The custom kernel registers, parsed from the command line arguments.
   // 4. The profiling registers, obtained from inspecting the generated recordbatches.
   default_regs = GetDefaultRegs();
-  recordbatch_regs = GetRecordBatchRegs(batch_desc);
+  recordbatch_regs = GetRecordBatchRegs(batch_desc, schema_set->index_width());
   kernel_regs = ParseCustomRegs(opts->regs);
   profiling_regs = GetProfilingRegs(recordbatch_comps);
 
@@ -87,8 +87,9 @@ struct Design {
   /// @brief Obtain a Cerata OutputSpec from this design for Cerata back-ends to generate output.
   std::vector<cerata::OutputSpec> GetOutputSpec();
 
-  /// @brief Obtain requited mmio registers based on the RecordBatch descriptions.
-  static std::vector<MmioReg> GetRecordBatchRegs(const std::vector<fletcher::RecordBatchDescription> &batch_desc);
+  /// @brief Obtain requited mmio registers based on the RecordBatch descriptions and the index width of the design.
+  static std::vector<MmioReg> GetRecordBatchRegs(const std::vector<fletcher::RecordBatchDescription> &batch_desc,
+                                                 int index_width = 32);
 
   /// @brief Obtain required custom registers based on a vector of strings.
   static std::vector<MmioReg> ParseCustomRegs(const std::vector<std::string> &regs);
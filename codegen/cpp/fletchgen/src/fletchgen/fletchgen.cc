@@ -36,7 +36,7 @@ int fletchgen(int argc, char **argv) {
 
   // Start logging
   std::string program_name = fletchgen::GetProgramName(argv[0]);
-  fletcher::StartLogging(program_name, FLETCHER_LOG_DEBUG, program_name + ".log");
+  fletcher::StartLogging(program_name, FLETCHER_LOG_DEFAULT_LEVEL, program_name + ".log");
 
   // Enable Cerata to log into the Fletcher logger through the callback function.
   cerata::logger().enable(fletchgen::LogCerata);
@@ -157,12 +157,24 @@ bool Options::MustGenerateDesign() const {
 
 bool Options::LoadRecordBatches() {
   for (const auto &path : recordbatch_paths) {
-    std::vector<std::shared_ptr<arrow::RecordBatch>> rbs;
+    std::shared_ptr<fletcher::PrefetchingRecordBatchReader> reader;
     FLETCHER_LOG(INFO, "Loading RecordBatch(es) from " + path);
-    if (!fletcher::ReadRecordBatchesFromFile(path, &rbs)) {
+    // Both the file and the stream format are accepted. The next RecordBatch is read while the current one is stored.
+    if (!fletcher::PrefetchingRecordBatchReader::Open(path, &reader)) {
       return false;
     }
-    recordbatches.insert(recordbatches.end(), rbs.begin(), rbs.end());
+    std::shared_ptr<arrow::RecordBatch> rb;
+    while (true) {
+      auto status = reader->ReadNext(&rb);
+      if (!status.ok()) {
+        FLETCHER_LOG(ERROR, "Could not read RecordBatch from " + path + ". ARROW:[" + status.ToString() + "]");
+        return false;
+      }
+      if (rb == nullptr) {
+        break;
+      }
+      recordbatches.push_back(rb);
+    }
   }
   return true;
 }
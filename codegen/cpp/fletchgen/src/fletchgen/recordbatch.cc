@@ -61,11 +61,8 @@ void RecordBatch::AddArrays(const std::shared_ptr<FletcherSchema> &fletcher_sche
 
   // Iterate over all fields and add ArrayReader/Writer data and control ports.
   for (const auto &field : fletcher_schema->arrow_schema()->fields()) {
-    // Name prefix for all sorts of stuff.
-    auto prefix = fletcher_schema->name() + "_" + field->name();
-
     // Check if we must ignore the field
-    if (fletcher::GetBoolMeta(*field, fletcher::meta::IGNORE, false)) {
+    if (fletcher::GetFieldOptions(*field).ignore) {
       FLETCHER_LOG(DEBUG, "Ignoring field " + field->name());
     } else {
       FLETCHER_LOG(DEBUG, "Instantiating Array" << (mode_ == Mode::READ ? "Reader" : "Writer")
@@ -82,78 +79,99 @@ void RecordBatch::AddArrays(const std::shared_ptr<FletcherSchema> &fletcher_sche
                               "  - clock domain crossings.");
       }
 
-      // Generate the schema-defined Arrow data port for the kernel.
-      // This is the un-concatenated version w.r.t. the streams visible on the Array primitive component.
-      auto kernel_arrow_port = arrow_port(fletcher_schema, field, true, kernel_cd());
-      auto kernel_arrow_type = kernel_arrow_port->type();
-      Add(kernel_arrow_port);
-
-      // Instantiate an ArrayReader/Writer.
-      auto a = Instantiate(array(mode_), field->name() + "_inst");
-      array_instances_.push_back(a);
-
-      // Generate and set a configuration string for the ArrayReader.
-      Connect(a->Get<Parameter>("CFG"), GenerateConfigString(*field));
-
-      // Drive the clocks and resets.
-      Connect(a->prt("kcd"), prt("kcd"));
-      Connect(a->prt("bcd"), prt("bcd"));
-
-      // Connect some global parameters.
-      a->par("CMD_TAG_WIDTH") <<= tw;
-      a->par(index_width()) <<= iw;
-
-      // Connect the bus ports.
-      ConnectBusPorts(a, prefix, &rebinding);
-
-      // Drive the RecordBatch Arrow data port with the ArrayReader/Writer data port, or vice versa.
-      if (mode_ == Mode::READ) {
-        auto a_data_port = a->prt("out");
-        // Rebind the type because now we know the field (also see array()).
-        auto a_data_spec = GetArrayDataSpec(*field);
-        auto a_data_type = array_reader_out(a_data_spec.first, a_data_spec.second);
-        a_data_port->SetType(a_data_type);
-        // Create a mapper between the Arrow port and the Array data port.
-        auto mapper = GetStreamTypeMapper(kernel_arrow_type, a_data_type.get());
-        kernel_arrow_type->AddMapper(mapper);
-        // Connect the ports.
-        kernel_arrow_port <<= a_data_port;
+      if (field->type()->id() == arrow::Type::DICTIONARY) {
+        if (mode_ == Mode::WRITE) {
+          FLETCHER_LOG(FATAL, "Dictionary-encoded field " + field->name() + " can only be read.");
+        }
+        // Stream the indices, and give the kernel an ArrayReader of its own for the dictionary. The kernel looks up
+        // the values of the indices it needs by issuing commands for them on the dictionary command stream.
+        AddArray(fletcher_schema, fletcher::GetDictionaryIndicesField(*field), iw, tw, &rebinding);
+        AddArray(fletcher_schema, fletcher::GetDictionaryValuesField(*field), iw, tw, &rebinding);
       } else {
-        auto a_data_port = a->prt("in");
-        // Rebind the type because now we know the field (also see array()).
-        auto a_data_spec = GetArrayDataSpec(*field);
-        auto a_data_type = array_writer_in(a_data_spec.first, a_data_spec.second);
-        a_data_port->SetType(a_data_type);
-        // Create a mapper between the Arrow port and the Array data port.
-        auto mapper = GetStreamTypeMapper(kernel_arrow_type, a_data_type.get());
-        kernel_arrow_type->AddMapper(mapper);
-        // Connect the ports.
-        a_data_port <<= kernel_arrow_port;
+        AddArray(fletcher_schema, field, iw, tw, &rebinding);
       }
-
-      // Get the command stream and unlock stream ports and set their real type and connect.
-      auto a_cmd = a->Get<Port>("cmd");
-      auto ct = cmd_type(iw,
-                         tw,
-                         a->par(bus_addr_width())->shared_from_this() * GetCtrlBufferCount(*field));
-      a_cmd->SetType(ct);
-
-      auto aw = Get<Parameter>(prefix + "_" + bus_addr_width()->name())->shared_from_this();
-      auto cmd = command_port(fletcher_schema, field, iw, tw, aw, kernel_cd());
-      Connect(a_cmd, cmd);
-      Add(cmd);
-
-      auto a_unl = a->Get<Port>("unl");
-      auto ut = unlock_type(a->par("CMD_TAG_WIDTH")->shared_from_this());
-      a_unl->SetType(ut);
-
-      auto unl = unlock_port(fletcher_schema, field, tw, kernel_cd());
-      Connect(unl, a_unl);
-      Add(unl);
     }
   }
 }
 
+void RecordBatch::AddArray(const std::shared_ptr<FletcherSchema> &fletcher_schema,
+                           const std::shared_ptr<arrow::Field> &field,
+                           const std::shared_ptr<Parameter> &iw,
+                           const std::shared_ptr<Parameter> &tw,
+                           cerata::NodeMap *rebinding) {
+  // Name prefix for all sorts of stuff.
+  auto prefix = fletcher_schema->name() + "_" + field->name();
+
+  // Generate the schema-defined Arrow data port for the kernel.
+  // This is the un-concatenated version w.r.t. the streams visible on the Array primitive component.
+  auto kernel_arrow_port = arrow_port(fletcher_schema, field, true, kernel_cd());
+  auto kernel_arrow_type = kernel_arrow_port->type();
+  Add(kernel_arrow_port);
+
+  // Instantiate an ArrayReader/Writer.
+  auto a = Instantiate(array(mode_), field->name() + "_inst");
+  array_instances_.push_back(a);
+
+  // Generate and set a configuration string for the ArrayReader.
+  Connect(a->Get<Parameter>("CFG"), GenerateConfigString(*field));
+
+  // Drive the clocks and resets.
+  Connect(a->prt("kcd"), prt("kcd"));
+  Connect(a->prt("bcd"), prt("bcd"));
+
+  // Connect some global parameters.
+  a->par("CMD_TAG_WIDTH") <<= tw;
+  a->par(index_width()) <<= iw;
+
+  // Connect the bus ports.
+  ConnectBusPorts(a, prefix, rebinding);
+
+  // Drive the RecordBatch Arrow data port with the ArrayReader/Writer data port, or vice versa.
+  if (mode_ == Mode::READ) {
+    auto a_data_port = a->prt("out");
+    // Rebind the type because now we know the field (also see array()).
+    auto a_data_spec = GetArrayDataSpec(*field);
+    auto a_data_type = array_reader_out(a_data_spec.first, a_data_spec.second);
+    a_data_port->SetType(a_data_type);
+    // Create a mapper between the Arrow port and the Array data port.
+    auto mapper = GetStreamTypeMapper(kernel_arrow_type, a_data_type.get());
+    kernel_arrow_type->AddMapper(mapper);
+    // Connect the ports.
+    kernel_arrow_port <<= a_data_port;
+  } else {
+    auto a_data_port = a->prt("in");
+    // Rebind the type because now we know the field (also see array()).
+    auto a_data_spec = GetArrayDataSpec(*field);
+    auto a_data_type = array_writer_in(a_data_spec.first, a_data_spec.second);
+    a_data_port->SetType(a_data_type);
+    // Create a mapper between the Arrow port and the Array data port.
+    auto mapper = GetStreamTypeMapper(kernel_arrow_type, a_data_type.get());
+    kernel_arrow_type->AddMapper(mapper);
+    // Connect the ports.
+    a_data_port <<= kernel_arrow_port;
+  }
+
+  // Get the command stream and unlock stream ports and set their real type and connect.
+  auto a_cmd = a->Get<Port>("cmd");
+  auto ct = cmd_type(iw,
+                     tw,
+                     a->par(bus_addr_width())->shared_from_this() * GetCtrlBufferCount(*field));
+  a_cmd->SetType(ct);
+
+  auto aw = Get<Parameter>(prefix + "_" + bus_addr_width()->name())->shared_from_this();
+  auto cmd = command_port(fletcher_schema, field, iw, tw, aw, kernel_cd());
+  Connect(a_cmd, cmd);
+  Add(cmd);
+
+  auto a_unl = a->Get<Port>("unl");
+  auto ut = unlock_type(a->par("CMD_TAG_WIDTH")->shared_from_this());
+  a_unl->SetType(ut);
+
+  auto unl = unlock_port(fletcher_schema, field, tw, kernel_cd());
+  Connect(unl, a_unl);
+  Add(unl);
+}
+
 std::vector<std::shared_ptr<FieldPort>>
 RecordBatch::GetFieldPorts(const std::optional<FieldPort::Function> &function) const {
   std::vector<std::shared_ptr<FieldPort>> result;
@@ -210,7 +228,7 @@ std::shared_ptr<FieldPort> arrow_port(const std::shared_ptr<FletcherSchema> &fle
   }
   // Check if the Arrow data stream should be profiled. This is disabled by default but can be conveyed through
   // the schema.
-  bool profile = fletcher::GetBoolMeta(*field, fletcher::meta::PROFILE, false);
+  bool profile = fletcher::GetFieldOptions(*field).profile;
 
   return std::make_shared<FieldPort>(name, FieldPort::ARROW, field, fletcher_schema, type, dir, domain, profile);
 }
@@ -172,6 +172,20 @@ struct RecordBatch : public Component {
    */
   void AddArrays(const std::shared_ptr<FletcherSchema> &fletcher_schema);
 
+  /**
+   * @brief Adds an ArrayReader/Writer for a single field, and its data, command and unlock ports.
+   * @param fletcher_schema   The Fletcher schema of the field.
+   * @param field             The field as it is accessed by the hardware.
+   * @param iw                The index width parameter of this RecordBatch.
+   * @param tw                The tag width parameter of this RecordBatch.
+   * @param rebinding         The rebind map for the bus parameters.
+   */
+  void AddArray(const std::shared_ptr<FletcherSchema> &fletcher_schema,
+                const std::shared_ptr<arrow::Field> &field,
+                const std::shared_ptr<cerata::Parameter> &iw,
+                const std::shared_ptr<cerata::Parameter> &tw,
+                cerata::NodeMap *rebinding);
+
   /// A mapping from ArrayReader/Writer instances to their bus ports.
   std::vector<Instance *> array_instances_;
   /// Fletcher schema implemented by this RecordBatch(Reader/Writer)
@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 #include <optional>
+#include <set>
 
 #include "fletchgen/bus.h"
 
@@ -61,7 +62,7 @@ bool SchemaSet::HasSchemaWithName(const std::string &name) const {
 }
 
 void SchemaSet::AppendSchema(const std::shared_ptr<arrow::Schema> &arrow_schema) {
-  auto name = fletcher::GetMeta(*arrow_schema, fletcher::meta::NAME);
+  auto name = fletcher::GetSchemaOptions(*arrow_schema).name;
   if (name.empty()) {
     FLETCHER_LOG(WARNING, "Skipping anonymous schema with the following contents:\n" + arrow_schema->ToString());
     FLETCHER_LOG(WARNING, "Append {'fletcher_name' : '<name>'} kv-metadata to the schema "
@@ -137,17 +138,139 @@ void SchemaSet::Sort() {
   std::stable_sort(schemas_.begin(), schemas_.end(), ModeSort);
 }
 
+int SchemaSet::index_width() const {
+  std::string large_schema;
+  std::string narrow_schema;
+  for (const auto &fs : schemas_) {
+    if (fs->offset_width() == ARROW_LARGE_OFFSET_WIDTH) {
+      large_schema = fs->name();
+    } else if (fs->offset_width() == ARROW_OFFSET_WIDTH) {
+      narrow_schema = fs->name();
+    }
+  }
+  if (large_schema.empty()) {
+    return ARROW_OFFSET_WIDTH;
+  }
+  if (!narrow_schema.empty()) {
+    FLETCHER_LOG(FATAL, "Schema " + large_schema + " has 64-bit offsets, but schema " + narrow_schema
+        + " has 32-bit offsets. The offset width is set by the design-wide index width, so all variable-length fields "
+          "must use either the regular or the large string, binary and list types.");
+  }
+  return ARROW_LARGE_OFFSET_WIDTH;
+}
+
+/// @brief Add the offset widths of the variable-length types in a (nested) Arrow type to a set of widths.
+static void CollectOffsetWidths(const arrow::DataType &type, std::set<int> *widths) {
+  switch (type.id()) {
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+    case arrow::Type::LIST: widths->insert(ARROW_OFFSET_WIDTH);
+      break;
+    case arrow::Type::LARGE_STRING:
+    case arrow::Type::LARGE_BINARY:
+    case arrow::Type::LARGE_LIST: widths->insert(ARROW_LARGE_OFFSET_WIDTH);
+      break;
+      // The dictionary of a dictionary-encoded field is generated as a field of its own.
+    case arrow::Type::DICTIONARY:
+      CollectOffsetWidths(*dynamic_cast<const arrow::DictionaryType &>(type).value_type(), widths);
+      break;
+    default: break;
+  }
+  for (const auto &child : type.fields()) {
+    CollectOffsetWidths(*child->type(), widths);
+  }
+}
+
+/// @brief Return true if a fixed-size list type is nested anywhere in the children of a type.
+static bool HasNestedFixedSizeList(const arrow::DataType &type) {
+  for (const auto &child : type.fields()) {
+    if ((child->type()->id() == arrow::Type::FIXED_SIZE_LIST) || HasNestedFixedSizeList(*child->type())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// @brief Check the Fletcher metadata of a schema and its fields, before any of it is used in generation.
+static const std::shared_ptr<arrow::Schema> &WithValidOptions(const std::shared_ptr<arrow::Schema> &arrow_schema) {
+  std::string error;
+  if (!fletcher::ValidateOptions(*arrow_schema, &error)) {
+    FLETCHER_LOG(FATAL, "Invalid Fletcher metadata. " + error);
+  }
+  return arrow_schema;
+}
+
+/**
+ * @brief Return a copy of a schema with the elements-per-cycle that follow from the field types.
+ *
+ * Boolean fields have an elements-per-cycle of BOOLEAN_DEFAULT_EPC by default. Fixed-size list fields deliver whole
+ * lists per transfer, so their elements-per-cycle is multiplied by the list size, which must result in a power of two.
+ */
+static std::shared_ptr<arrow::Schema> WithTypeDerivedEPC(const std::shared_ptr<arrow::Schema> &arrow_schema) {
+  auto mode = fletcher::GetSchemaOptions(*arrow_schema).mode;
+  auto fields = arrow_schema->fields();
+  for (auto &f : fields) {
+    if (HasNestedFixedSizeList(*f->type())) {
+      FLETCHER_LOG(FATAL, "Field " + f->name() + " has a nested fixed-size list, which is only supported at the top "
+                          "level.");
+    }
+    if ((f->type()->id() == arrow::Type::DICTIONARY) && (mode == fletcher::Mode::WRITE)
+        && !fletcher::GetFieldOptions(*f).ignore) {
+      FLETCHER_LOG(FATAL, "Dictionary-encoded field " + f->name() + " is not supported in output schemas. "
+                          "Dictionary-encoded fields can only be read.");
+    }
+    bool has_epc = (f->metadata() != nullptr) && (f->metadata()->FindKey(fletcher::meta::VALUE_EPC) >= 0);
+    if ((f->type()->id() == arrow::Type::BOOL) && !has_epc) {
+      auto epc = arrow::key_value_metadata({fletcher::meta::VALUE_EPC}, {std::to_string(BOOLEAN_DEFAULT_EPC)});
+      f = f->WithMergedMetadata(epc);
+    } else if (f->type()->id() == arrow::Type::FIXED_SIZE_LIST) {
+      const auto &list_type = static_cast<const arrow::FixedSizeListType &>(*f->type());
+      const auto &element = list_type.value_field();
+      if (f->nullable() || element->nullable() || !arrow::is_fixed_width(element->type()->id())) {
+        FLETCHER_LOG(FATAL, "Fixed-size list field " + f->name() + " is not supported. Only non-nullable fixed-size "
+                            "lists of non-nullable fixed-width elements are supported.");
+      }
+      auto rows_per_cycle = fletcher::GetFieldOptions(*f).epc;
+      int64_t elements_per_cycle = rows_per_cycle * list_type.list_size();
+      if ((elements_per_cycle & (elements_per_cycle - 1)) != 0) {
+        FLETCHER_LOG(FATAL, "Fixed-size list field " + f->name() + " has " + std::to_string(elements_per_cycle)
+            + " elements per cycle, which is not a power of two. The list size times the elements-per-cycle of the "
+              "field must be a power of two.");
+      }
+      auto epc = arrow::key_value_metadata({fletcher::meta::VALUE_EPC}, {std::to_string(elements_per_cycle)});
+      f = f->WithMergedMetadata(epc);
+    }
+  }
+  return arrow::schema(fields, arrow_schema->metadata());
+}
+
 FletcherSchema::FletcherSchema(const std::shared_ptr<arrow::Schema> &arrow_schema, const std::string &schema_name)
-    : arrow_schema_(arrow_schema), mode_(fletcher::GetMode(*arrow_schema)) {
+    : arrow_schema_(WithTypeDerivedEPC(WithValidOptions(arrow_schema))),
+      mode_(fletcher::GetSchemaOptions(*arrow_schema).mode) {
 
   // Get name from metadata, if available
-  name_ = fletcher::GetMeta(*arrow_schema_, fletcher::meta::NAME);
+  auto options = fletcher::GetSchemaOptions(*arrow_schema_);
+  name_ = options.name;
   if (name_.empty()) {
     FLETCHER_LOG(FATAL, "Schema has no name. Append {'fletcher_name' : '<name>'} kv-metadata to the schema. "
                         "Schema: " + arrow_schema->ToString());
   }
-  auto bus_spec_val = fletcher::GetMeta(*arrow_schema_, fletcher::meta::BUS_SPEC);
-  bus_dims_ = BusDim::FromString(bus_spec_val, BusDim());
+  bus_dims_ = BusDim::FromString(options.bus_spec, BusDim());
+
+  // Determine the width of the offsets of the variable-length fields, which must all be the same.
+  std::set<int> offset_widths;
+  for (const auto &f : arrow_schema_->fields()) {
+    if (!fletcher::GetFieldOptions(*f).ignore) {
+      CollectOffsetWidths(*f->type(), &offset_widths);
+    }
+  }
+  if (offset_widths.size() > 1) {
+    FLETCHER_LOG(FATAL, "Schema " + name() + " mixes 32-bit and 64-bit offsets. Use either the regular or the large "
+                        "string, binary and list types for all of its variable-length fields.");
+  } else if (!offset_widths.empty()) {
+    offset_width_ = *offset_widths.begin();
+  }
+
   FLETCHER_LOG(DEBUG, "Schema " + name() + ":");
   FLETCHER_LOG(DEBUG, "  Direction : " + cerata::Term::str(mode2dir(mode_)));
   FLETCHER_LOG(DEBUG, "  Bus spec  : " + bus_dims_.ToString());
@@ -29,8 +29,22 @@ namespace fletchgen {
 
 using fletcher::Mode;
 
+/// The default number of elements per cycle of bit-packed boolean fields, i.e. one byte of values per cycle.
+constexpr int BOOLEAN_DEFAULT_EPC = 8;
+/// The width of the offsets of Arrow string, binary and list types.
+constexpr int ARROW_OFFSET_WIDTH = 32;
+/// The width of the offsets of Arrow large string, large binary and large list types.
+constexpr int ARROW_LARGE_OFFSET_WIDTH = 64;
+
 /**
  * An Arrow schema augmented with Fletcher specific data and functions.
+ *
+ * Top-level boolean fields without elements-per-cycle metadata get BOOLEAN_DEFAULT_EPC, as delivering a single bit per
+ * cycle would leave nearly all of a bus beat unused.
+ *
+ * Top-level fixed-size list fields are streamed like primitive fields with an elements-per-cycle of the list size
+ * (times any elements-per-cycle set in their metadata), so every transfer holds one or more whole lists and no offsets
+ * are read.
  */
 class FletcherSchema {
  public:
@@ -53,6 +67,8 @@ class FletcherSchema {
   [[nodiscard]] Mode mode() const { return mode_; }
   /// @brief Return the name of this FletcherSchema.
   [[nodiscard]] std::string name() const { return name_; }
+  /// @brief Return the width of the offsets of the variable-length fields in this schema, or 0 if it has none.
+  [[nodiscard]] int offset_width() const { return offset_width_; }
 
  private:
   /// The Arrow schema this FletcherSchema is based on.
@@ -63,6 +79,8 @@ class FletcherSchema {
   std::string name_;
   /// The bus dimensions for the RecordBatch resulting from this schema.
   BusDim bus_dims_;
+  /// The width of the offsets of the variable-length fields in this schema, or 0 if it has none.
+  int offset_width_ = 0;
 };
 
 /**
@@ -92,6 +110,15 @@ class SchemaSet : public cerata::Named {
   [[nodiscard]] std::vector<std::shared_ptr<FletcherSchema>> write_schemas() const;
   /// @brief Sort the schemas by name, then by read/write mode.
   void Sort();
+  /**
+   * @brief Return the index width of the design generated from this set.
+   *
+   * The ArrayReaders and ArrayWriters use the index width for the first and last index of their commands as well as for
+   * the offsets and lengths of variable-length fields. It is ARROW_LARGE_OFFSET_WIDTH if any schema has large string,
+   * large binary or large list fields, and ARROW_OFFSET_WIDTH otherwise. Schemas that mix both offset widths cannot be
+   * generated.
+   */
+  [[nodiscard]] int index_width() const;
 
  private:
   /// @brief Schemas of RecordBatches.
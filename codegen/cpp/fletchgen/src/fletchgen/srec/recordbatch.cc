@@ -44,6 +44,7 @@ void GenerateReadSREC(const std::vector<fletcher::RecordBatchDescription> &meta_
       desc_out.fields.clear();
       for (const auto &f : desc_in.fields) {
         desc_out.fields.emplace_back(f.type_, f.length, f.null_count);
+        desc_out.fields.back().column = f.column;
         FLETCHER_LOG(DEBUG, "RecordBatch " + desc_in.name + " buffers: \n" + desc_in.ToString());
         for (const auto &buf : f.buffers) {
           // May the force be with us
@@ -51,10 +52,12 @@ void GenerateReadSREC(const std::vector<fletcher::RecordBatchDescription> &meta_
           // Determine the place of the buffer in the SREC output
           desc_out.fields.back().buffers.emplace_back(srec_buf_address, buf.size_, buf.desc_, buf.level_);
 
-          // Print some debug info
-          auto hv = fletcher::HexView(offset);
-          hv.AddData(buf.raw_buffer_, buf.size_);
-          FLETCHER_LOG(DEBUG, fletcher::ToString(buf.desc_) + "\n" + hv.ToString());
+          // Print some debug info. Only build the hex view if it is logged, as buffers can be huge.
+          if (fletcher::LogEnabled(FLETCHER_LOG_DEBUG)) {
+            auto hv = fletcher::HexView(offset);
+            hv.AddData(buf.raw_buffer_, buf.size_);
+            FLETCHER_LOG(DEBUG, fletcher::ToString(buf.desc_) + "\n" + hv.ToString());
+          }
 
           // Calculate the padded length and calculate the next offset.
           auto padded_size = PaddedLength(buf.size_, buffer_align);
@@ -36,6 +36,9 @@ std::string GenerateAXITop(const Mantle &mantle,
   // Template for AXI top level
   auto t = Template::FromString(axi_source);
 
+  // Accelerator properties
+  t.Replace("INDEX_WIDTH", schema_set.index_width());
+
   // Bus properties
   t.Replace("BUS_ADDR_WIDTH", 64);
   t.Replace("BUS_DATA_WIDTH", 512);
@@ -53,7 +53,7 @@ static char axi_source[] =
     "entity AxiTop is\n"
     "  generic (\n"
     "    -- Accelerator properties\n"
-    "    INDEX_WIDTH                 : natural := 32;\n"
+    "    INDEX_WIDTH                 : natural := ${INDEX_WIDTH};\n"
     "    REG_WIDTH                   : natural := 32;\n"
     "    TAG_WIDTH                   : natural := 1;\n"
     "    -- AXI4 (full) bus properties for memory access.\n"
@@ -95,6 +95,11 @@ std::string GenerateSimTop(const Design &design,
   // Total number of RecordBatches
   size_t num_rbs = read_schemas.size() + write_schemas.size();
 
+  // Indices wider than 32 bits take two registers each, low word first.
+  auto index_width = design.schema_set->index_width();
+  size_t regs_per_index = index_width > 32 ? 2 : 1;
+  t.Replace("INDEX_WIDTH", index_width);
+
   // Bus properties
   t.Replace("BUS_ADDR_WIDTH", 64);
   t.Replace("BUS_DATA_WIDTH", 512);
@@ -135,7 +140,7 @@ std::string GenerateSimTop(const Design &design,
         auto addr = reinterpret_cast<uint64_t>(b.raw_buffer_);
         auto addr_lo = (uint32_t) (addr & 0xFFFFFFFF);
         auto addr_hi = (uint32_t) (addr >> 32u);
-        uint32_t buffer_idx = 2 * (buffer_offset) + (ndefault + 2 * num_rbs);
+        uint32_t buffer_idx = 2 * (buffer_offset) + (ndefault + 2 * regs_per_index * num_rbs);
         buffer_meta << GenMMIOWrite(buffer_idx,
                                     addr_lo,
                                     rb.name + " " + fletcher::ToString(b.desc_) + " buffer address.");
@@ -144,9 +149,13 @@ std::string GenerateSimTop(const Design &design,
         buffer_offset++;
       }
     }
-    uint32_t rb_idx = 2 * (rb_offset) + ndefault;
+    uint32_t rb_idx = 2 * regs_per_index * (rb_offset) + ndefault;
     rb_meta << GenMMIOWrite(rb_idx, 0, rb.name + " first index.");
-    rb_meta << GenMMIOWrite(rb_idx + 1, rb.rows, rb.name + " last index.");
+    rb_meta << GenMMIOWrite(rb_idx + regs_per_index, rb.rows, rb.name + " last index.");
+    if (regs_per_index > 1) {
+      rb_meta << GenMMIOWrite(rb_idx + 1, 0);
+      rb_meta << GenMMIOWrite(rb_idx + 3, static_cast<uint32_t>(static_cast<uint64_t>(rb.rows) >> 32u));
+    }
     rb_offset++;
   }
   t.Replace("SREC_BUFFER_ADDRESSES", buffer_meta.str());
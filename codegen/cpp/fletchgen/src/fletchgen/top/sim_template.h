@@ -46,7 +46,7 @@ static char sim_source[] =
     "entity SimTop_tc is\n"
     "  generic (\n"
     "    -- Accelerator properties\n"
-    "    INDEX_WIDTH                 : natural := 32;\n"
+    "    INDEX_WIDTH                 : natural := ${INDEX_WIDTH};\n"
     "    TAG_WIDTH                   : natural := 1;\n"
     "\n"
     "    -- Host bus properties\n"
@@ -69,3 +69,11 @@ typedef union {
 #define FLETCHER_REG_STATUS_IDLE    0x0u
 #define FLETCHER_REG_STATUS_BUSY    0x1u
 #define FLETCHER_REG_STATUS_DONE    0x2u
+/// Set together with the done bit when the kernel ran out of space in an output buffer. The number of completed rows
+/// is then reported in FLETCHER_REG_RETURN0, or in FLETCHER_REG_RETURN0 (low word) and FLETCHER_REG_RETURN1 (high
+/// word) for kernels with 64-bit index registers.
+#define FLETCHER_REG_STATUS_OVERFLOW 0x3u
+
+/// Platform capability flags, as reported by the optional platformGetCapabilities function.
+/// The device accesses host memory in the same address space as the application, i.e. without copies.
+#define FLETCHER_CAP_SHARED_ADDRESS_SPACE 0x1u
@@ -0,0 +1,169 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arrow/api.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fletcher/arrow-utils.h"
+
+namespace fletcher {
+
+/// A reference to the bytes of a single buffer of a RecordBatch.
+struct BufferRef {
+  /// The first byte of the buffer.
+  const uint8_t *data = nullptr;
+  /// The size of the buffer in bytes.
+  int64_t size = 0;
+  /// Whether the buffer is not required logically, e.g. the validity bitmap of an array without nulls.
+  bool implicit = false;
+  /// Owner of the bytes, if they are not owned by the RecordBatch itself (i.e. rebased offsets or a realigned bitmap).
+  std::shared_ptr<arrow::Buffer> owner;
+};
+
+/**
+ * @brief The buffers of all RecordBatches with some schema, compiled once into a flat array of buffer slots.
+ *
+ * The RecordBatchAnalyzer walks the type tree of every RecordBatch it analyzes, and names every buffer it visits. A
+ * BufferLayout walks the type tree only once per schema. Extracting the buffers of a RecordBatch is then a linear pass
+ * over the slots, which only allocates to rebase the offsets or realign the bitmaps of sliced arrays. The buffers are
+ * the same, and in the same order, as the buffers described by the RecordBatchAnalyzer.
+ */
+class BufferLayout {
+ public:
+  /// How the array of a node follows from the array of its parent node.
+  enum class Relation {
+    COLUMN,                  ///< A column of the RecordBatch.
+    STRUCT_CHILD,            ///< A child of a struct array.
+    LIST_VALUES,             ///< The values of a (large) list array.
+    FIXED_SIZE_LIST_VALUES,  ///< The values of a fixed-size list array.
+    DICTIONARY               ///< The dictionary of a dictionary-encoded column.
+  };
+
+  /// The kind of buffer held by a slot.
+  enum class Kind {
+    VALIDITY,       ///< A validity bitmap, which is implicit if there are no nulls, except for output RecordBatches.
+    BITMAP_VALUES,  ///< The values of a boolean array.
+    FIXED_VALUES,   ///< The values of a fixed-width array.
+    OFFSETS,        ///< The offsets of a variable-length array, rebased to start at zero.
+    BINARY_VALUES   ///< The values of a (large) binary or string array that are covered by its offsets.
+  };
+
+  /// An array in the type tree of the schema.
+  struct Node {
+    /// How the array follows from its parent.
+    Relation relation = Relation::COLUMN;
+    /// The index of the parent node, or the column of the RecordBatch for columns.
+    int parent = 0;
+    /// The index of the child of the parent, for struct children.
+    int child = 0;
+    /// The size of the offsets of the parent for list values, or the list size for fixed-size list values.
+    int64_t parent_param = 0;
+  };
+
+  /// A buffer in the layout.
+  struct Slot {
+    /// The kind of buffer.
+    Kind kind = Kind::FIXED_VALUES;
+    /// The index of the node of the array the buffer belongs to.
+    int node = 0;
+    /// The width in bytes of the elements, for fixed-width values and offsets.
+    int64_t width = 0;
+    /// The nesting level of the buffer.
+    int level = 0;
+    /// The name of the buffer, as produced by the RecordBatchAnalyzer.
+    std::vector<std::string> desc;
+  };
+
+  /// A field as seen by the kernel, holding a consecutive range of slots.
+  struct Field {
+    /// The field.
+    std::shared_ptr<arrow::Field> field;
+    /// The index of the column of the RecordBatch.
+    int column = 0;
+    /// Whether this is the dictionary of a dictionary-encoded column.
+    bool dictionary = false;
+    /// The index of the first slot.
+    size_t first_slot = 0;
+    /// The number of slots.
+    size_t num_slots = 0;
+  };
+
+  /**
+   * @brief Compile the buffer layout of RecordBatches with some schema.
+   * @param[in]  batch_schema   The schema of the RecordBatches.
+   * @param[in]  kernel_schema  The schema of the kernel to project the RecordBatches on, or nullptr to use all
+   *                            non-ignored columns. See RecordBatchAnalyzer::Analyze().
+   * @param[out] out            The compiled layout.
+   * @return                    True if successful, false if the schemas contain unsupported types or the RecordBatches
+   *                            lack a field of the kernel schema.
+   */
+  static bool Make(const arrow::Schema &batch_schema,
+                   const arrow::Schema *kernel_schema,
+                   std::shared_ptr<BufferLayout> *out);
+
+  /**
+   * @brief Extract the buffers of a RecordBatch with the schema of this layout.
+   * @param[in]  batch    The RecordBatch.
+   * @param[out] buffers  The buffers, one for every slot. The vector is reused, so extracting into the same vector
+   *                      again does not allocate.
+   * @return              True if successful, false otherwise.
+   */
+  bool Extract(const arrow::RecordBatch &batch, std::vector<BufferRef> *buffers) const;
+
+  /// @brief Return the description of a RecordBatch from the buffers extracted from it.
+  RecordBatchDescription Describe(const arrow::RecordBatch &batch, const std::vector<BufferRef> &buffers) const;
+
+  /// @brief Return the name of the RecordBatches, i.e. the name of the kernel schema if there is one.
+  const std::string &name() const { return name_; }
+  /// @brief Return the access mode of the RecordBatches.
+  Mode mode() const { return mode_; }
+  /// @brief Return the number of buffers of every RecordBatch.
+  size_t num_buffers() const { return slots_.size(); }
+  /// @brief Return the fields of the layout.
+  const std::vector<Field> &fields() const { return fields_; }
+
+ protected:
+  /// An array of a RecordBatch, with its first element and number of elements.
+  struct Span {
+    const arrow::ArrayData *data = nullptr;
+    int64_t offset = 0;
+    int64_t length = 0;
+  };
+
+  /// @brief Add the nodes and slots of a field at some nesting level.
+  bool AddNode(const arrow::Field &field,
+               Relation relation,
+               int parent,
+               int child,
+               int64_t parent_param,
+               std::vector<std::string> desc,
+               int level);
+  /// @brief Locate the array of a node in a RecordBatch.
+  bool Locate(const arrow::RecordBatch &batch, int node, Span *out) const;
+  /// @brief Extract the buffer of a single slot.
+  bool ExtractSlot(const arrow::RecordBatch &batch, const Slot &slot, BufferRef *out) const;
+
+  std::string name_;
+  Mode mode_ = Mode::READ;
+  std::vector<Node> nodes_;
+  std::vector<Slot> slots_;
+  std::vector<Field> fields_;
+};
+
+}  // namespace fletcher
@@ -0,0 +1,87 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arrow/api.h>
+#include <cstdint>
+#include <string>
+
+#include "fletcher/arrow-utils.h"
+
+namespace fletcher {
+
+/// The Fletcher options of a field, parsed from its fletcher_* metadata. See fletcher/meta/meta.h.
+struct FieldOptions {
+  /// Whether the field is ignored in generation and at run-time.
+  bool ignore = false;
+  /// Whether the data stream of the field is profiled.
+  bool profile = false;
+  /// The number of value elements per cycle.
+  uint32_t epc = 1;
+  /// The number of list elements per cycle.
+  uint32_t lepc = 1;
+  /// The width of the tag of the command and unlock streams.
+  uint32_t tag_width = 1;
+
+  /**
+   * @brief Parse the options of a field from its metadata.
+   * @param[in]  field  The field.
+   * @param[out] out    The options. Keys with invalid values keep their default.
+   * @param[out] error  A description of the first invalid key, if any. May be nullptr.
+   * @return            True if all fletcher_* keys hold valid values, false otherwise.
+   */
+  static bool Parse(const arrow::Field &field, FieldOptions *out, std::string *error = nullptr);
+};
+
+/// The Fletcher options of a schema, parsed from its fletcher_* metadata. See fletcher/meta/meta.h.
+struct SchemaOptions {
+  /// The name of the schema, or an empty string if it has none.
+  std::string name;
+  /// The access mode of the schema, as seen by the kernel.
+  Mode mode = Mode::READ;
+  /// The bus specification of the schema, or an empty string if it has none.
+  std::string bus_spec;
+
+  /**
+   * @brief Parse the options of a schema from its metadata. The options of its fields are not parsed.
+   * @param[in]  schema The schema.
+   * @param[out] out    The options. Keys with invalid values keep their default.
+   * @param[out] error  A description of the first invalid key, if any. May be nullptr.
+   * @return            True if all fletcher_* keys hold valid values, false otherwise.
+   */
+  static bool Parse(const arrow::Schema &schema, SchemaOptions *out, std::string *error = nullptr);
+};
+
+/**
+ * @brief Return the options of a field.
+ *
+ * The metadata of a field is parsed once, and the options are cached for as long as the metadata is used. Invalid
+ * values are reported with a warning the first time, and replaced with their default. Use ValidateOptions() to reject
+ * them instead.
+ */
+FieldOptions GetFieldOptions(const arrow::Field &field);
+
+/// @brief Return the options of a schema, parsed once and cached like GetFieldOptions().
+SchemaOptions GetSchemaOptions(const arrow::Schema &schema);
+
+/**
+ * @brief Validate the options of a schema and all of its (nested) fields.
+ * @param[in]  schema The schema to validate.
+ * @param[out] error  A description of the first invalid key, if any. May be nullptr.
+ * @return            True if all fletcher_* keys of the schema and its fields hold valid values, false otherwise.
+ */
+bool ValidateOptions(const arrow::Schema &schema, std::string *error = nullptr);
+
+}  // namespace fletcher
@@ -0,0 +1,120 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arrow/api.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "fletcher/arrow-utils.h"
+
+namespace fletcher {
+
+/// @brief Options for reading ahead of the consumer of a PrefetchingRecordBatchReader.
+struct PrefetchOptions {
+  /// The maximum number of RecordBatches to read ahead of the consumer. At least one RecordBatch is read ahead.
+  size_t max_batches = 2;
+  /**
+   * The number of bytes read ahead of the consumer after which no further RecordBatches are read ahead. Zero means
+   * unlimited. The bound may be exceeded by at most one RecordBatch.
+   */
+  int64_t max_bytes = 0;
+  /// The options for reading the file.
+  FileReadOptions read_options;
+};
+
+/**
+ * @brief Reads RecordBatches lazily on a background thread, keeping a bounded number of them ready for the consumer.
+ *
+ * Unlike ReadRecordBatchesFromFile(), memory usage does not grow with the size of the input, and the first RecordBatch
+ * is available as soon as it is read. Because this is an arrow::RecordBatchReader, it can be fed to a
+ * fletcher::StreamExecutor directly.
+ */
+class PrefetchingRecordBatchReader : public arrow::RecordBatchReader {
+ public:
+  /// A function that obtains the next RecordBatch of a source, or nullptr at the end of the source.
+  using Source = std::function<arrow::Status(std::shared_ptr<arrow::RecordBatch> *)>;
+
+  /**
+   * @brief Construct a new PrefetchingRecordBatchReader, and start reading ahead.
+   * @param schema  The schema of the RecordBatches of the source.
+   * @param source  The source of the RecordBatches. It is called from the background thread only.
+   * @param options The options for reading ahead.
+   */
+  PrefetchingRecordBatchReader(std::shared_ptr<arrow::Schema> schema, Source source, PrefetchOptions options);
+
+  /// @brief Stop reading ahead and wait for the background thread.
+  ~PrefetchingRecordBatchReader() override;
+
+  /**
+   * @brief Open an Arrow IPC file in either the file or the stream format.
+   * @param file_name The path to the input file.
+   * @param out       The new reader.
+   * @param options   The options for reading ahead.
+   * @return          True if successful, false otherwise.
+   */
+  static bool Open(const std::string &file_name,
+                   std::shared_ptr<PrefetchingRecordBatchReader> *out,
+                   const PrefetchOptions &options = PrefetchOptions());
+
+  /**
+   * @brief Read ahead of the consumer of another RecordBatchReader.
+   * @param reader  The reader to read ahead of.
+   * @param options The options for reading ahead.
+   * @return        The new reader.
+   */
+  static std::shared_ptr<PrefetchingRecordBatchReader> Make(const std::shared_ptr<arrow::RecordBatchReader> &reader,
+                                                            const PrefetchOptions &options = PrefetchOptions());
+
+  /// @brief Return the schema of the RecordBatches.
+  std::shared_ptr<arrow::Schema> schema() const override { return schema_; }
+
+  /// @brief Obtain the next RecordBatch, waiting for it if it was not read ahead yet. Sets batch to nullptr at the end.
+  arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) override;
+
+  /// @brief Return the number of bytes of the RecordBatches that were read ahead but not consumed yet.
+  int64_t bytes_prefetched() const;
+
+ private:
+  /// @brief Read RecordBatches from the source until it is exhausted, the reader is destructed, or an error occurs.
+  void Run();
+  /// @brief Return true if the bounds of the options allow to read ahead another RecordBatch.
+  bool MayReadAhead() const;
+
+  std::shared_ptr<arrow::Schema> schema_;
+  Source source_;
+  PrefetchOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<std::shared_ptr<arrow::RecordBatch>> queue_;
+  int64_t queued_bytes_ = 0;
+  /// Whether the source is exhausted or failed.
+  bool done_ = false;
+  /// Whether the reader is being destructed.
+  bool stop_ = false;
+  /// The status of the source when it was exhausted or failed.
+  arrow::Status status_;
+  std::thread thread_;
+};
+
+}  // namespace fletcher
@@ -29,6 +29,24 @@ namespace fletcher {
  *
  * Follows the general approach of the RecordBatchSerializer in arrow::ipc, but is more simplified as it only has to
  * figure out where all the buffers are.
+ *
+ * The analyzer takes array offsets into account. For sliced RecordBatches, only the bytes covered by the slice are
+ * described, such that all resulting buffers start at row 0 of the slice. Where the Arrow buffers cannot be referenced
+ * in place (offsets buffers with a non-zero first offset, or validity bitmaps that don't start at a byte boundary),
+ * the analyzer creates a rebased copy that is owned by the resulting BufferMetadata.
+ *
+ * The offsets of RecordBatches with a write-mode schema are not inspected, as they are still to be written by a kernel.
+ * For these, the full values buffers are described.
+ *
+ * Large string, large binary and large list columns are described like their regular counterparts, except that their
+ * offsets buffers hold 64-bit offsets. Fixed-size list columns have no offsets buffer at all; only the values covered by
+ * the rows are described.
+ *
+ * Like fletchgen, the analyzer skips fields with the fletcher_ignore metadata, so only the columns that the hardware
+ * consumes are described.
+ *
+ * Top-level dictionary-encoded columns of read-mode RecordBatches are described by two fields: the indices, with the
+ * validity bitmap of the column, and the dictionary, with the buffers of its (unsliced) values array.
  */
 class RecordBatchAnalyzer : public arrow::ArrayVisitor {
  public:
@@ -36,23 +54,96 @@ class RecordBatchAnalyzer : public arrow::ArrayVisitor {
   ~RecordBatchAnalyzer() override = default;
   bool Analyze(const arrow::RecordBatch &batch);
 
+  /**
+   * @brief Analyze the columns of a RecordBatch that are used by a kernel with a specific schema.
+   *
+   * The kernel schema is the schema that the hardware was generated from. Its fields are matched by name with the
+   * columns of the RecordBatch, which may have any other columns as well. The fields are described in the order of the
+   * kernel schema. The name and mode of the description are taken from the kernel schema, as is the nullability of
+   * every field.
+   *
+   * @param batch         The RecordBatch to analyze.
+   * @param kernel_schema The schema of the kernel.
+   * @return              True if successful, false if the RecordBatch lacks a field of the kernel schema or has a
+   *                      different type for it.
+   */
+  bool Analyze(const arrow::RecordBatch &batch, const arrow::Schema &kernel_schema);
+
  protected:
+  /// @brief Add the description of a column of the RecordBatch that is seen by the kernel as some field.
+  bool AnalyzeColumn(const arrow::RecordBatch &batch, int column, const std::shared_ptr<arrow::Field> &column_field);
+
   arrow::Status VisitArray(const arrow::Array &arr);
 
+  /// @brief Add a buffer to the description of the current field.
+  void AddBuffer(const uint8_t *data, int64_t size, const std::string &name,
+                 std::shared_ptr<arrow::Buffer> owner = nullptr);
+
+  /// @brief Add the validity bitmap bytes covering the elements of an array.
+  arrow::Status AddValidity(const arrow::Array &arr);
+
+  /// @brief Add a new validity bitmap with all of some number of elements valid, for an output array without one.
+  arrow::Status AddValidBitmap(int64_t length);
+
+  /**
+   * @brief Add the bytes of a bitmap covering some bits. The bitmap is realigned if the first bit is not the first bit
+   * of a byte, so the first bit described is always bit 0 of the first byte.
+   * @param[in] bitmap  The bitmap.
+   * @param[in] offset  The index of the first bit.
+   * @param[in] length  The number of bits.
+   * @param[in] name    The name of the buffer.
+   * @return arrow::Status::OK() if successful, otherwise an error status.
+   */
+  arrow::Status AddBitmap(const std::shared_ptr<arrow::Buffer> &bitmap,
+                          int64_t offset,
+                          int64_t length,
+                          const std::string &name);
+
+  /**
+   * @brief Add an offsets buffer covering \p length elements, rebased to start at zero if required.
+   * @tparam     OffsetType  The type of the offsets, int32_t or int64_t for large types.
+   * @param[in]  offsets     Pointer to the offsets of the first element, i.e. array offset already applied.
+   * @param[in]  length      Number of elements.
+   * @param[out] first       The first offset, i.e. the first covered element (list) or byte (binary) of the values.
+   * @param[out] last        The last offset (exclusive).
+   * @return arrow::Status::OK() if successful, otherwise an error status.
+   */
+  template<typename OffsetType>
+  arrow::Status AddOffsets(const OffsetType *offsets, int64_t length, int64_t *first, int64_t *last);
+
+  /// @brief Add the offsets and values buffers of a (large) binary or string array.
+  template<typename ArrayType>
+  arrow::Status VisitOffsetsAndValues(const ArrayType &array);
+
+  /// @brief Add the offsets buffer of a (large) list array, and visit its values.
+  template<typename ArrayType>
+  arrow::Status VisitOffsetsAndChild(const ArrayType &array);
+
   template<typename ArrayType>
   arrow::Status VisitFixedWidth(const ArrayType &array) {
+    // Only describe the bytes of the values covered by this (possibly sliced) array.
     std::shared_ptr<arrow::Buffer> buf = array.values();
-    auto desc = buf_name;
-    desc.emplace_back("values");
-    out_->fields.back().buffers.emplace_back(buf->data(), buf->size(), desc, level);
+    auto byte_width = static_cast<const arrow::FixedWidthType &>(*array.type()).bit_width() / 8;
+    const uint8_t *data = buf == nullptr ? nullptr : buf->data() + array.offset() * byte_width;
+    AddBuffer(data, array.length() * byte_width, "values");
     return arrow::Status::OK();
   }
 
   arrow::Status VisitBinary(const arrow::BinaryArray &array);
+  arrow::Status VisitBinary(const arrow::LargeBinaryArray &array);
   arrow::Status Visit(const arrow::StringArray &array) override { return VisitBinary(array); }
   arrow::Status Visit(const arrow::BinaryArray &array) override { return VisitBinary(array); }
+  arrow::Status Visit(const arrow::LargeStringArray &array) override { return VisitBinary(array); }
+  arrow::Status Visit(const arrow::LargeBinaryArray &array) override { return VisitBinary(array); }
   arrow::Status Visit(const arrow::ListArray &array) override;
+  arrow::Status Visit(const arrow::LargeListArray &array) override;
+  arrow::Status Visit(const arrow::FixedSizeListArray &array) override;
   arrow::Status Visit(const arrow::StructArray &array) override;
+  arrow::Status Visit(const arrow::DictionaryArray &array) override;
+  arrow::Status Visit(const arrow::BooleanArray &array) override {
+    // Booleans are bit-packed, like validity bitmaps.
+    return AddBitmap(array.values(), array.offset(), array.length(), "values");
+  }
 
 #define VISIT_FIXED_WIDTH(TYPE) \
   arrow::Status Visit(const TYPE& array) override { return VisitFixedWidth<TYPE>(array); }
@@ -77,10 +168,8 @@ class RecordBatchAnalyzer : public arrow::ArrayVisitor {
 #undef VISIT_FIXED_WIDTH
 
   // TODO(johanpel): Not implemented yet:
-  //arrow::Status Visit(const arrow::BooleanArray &array) override {}
   //arrow::Status Visit(const arrow::NullArray &array) override {}
   //arrow::Status Visit(const UnionArray& array) override {}
-  //arrow::Status Visit(const DictionaryArray& array) override {}
   //arrow::Status Visit(const ExtensionArray& array) override {}
 
   std::vector<std::string> buf_name;
@@ -45,11 +45,17 @@ class FieldAnalyzer : public arrow::TypeVisitor {
     return arrow::Status::OK();
   }
 
-  arrow::Status VisitBinary(const arrow::BinaryType &type);
+  arrow::Status VisitBinary(const arrow::BaseBinaryType &type);
+  arrow::Status VisitList(const arrow::BaseListType &type);
   arrow::Status Visit(const arrow::StringType &type) override { return VisitBinary(type); }
   arrow::Status Visit(const arrow::BinaryType &type) override { return VisitBinary(type); }
-  arrow::Status Visit(const arrow::ListType &type) override;
+  arrow::Status Visit(const arrow::LargeStringType &type) override { return VisitBinary(type); }
+  arrow::Status Visit(const arrow::LargeBinaryType &type) override { return VisitBinary(type); }
+  arrow::Status Visit(const arrow::ListType &type) override { return VisitList(type); }
+  arrow::Status Visit(const arrow::LargeListType &type) override { return VisitList(type); }
+  arrow::Status Visit(const arrow::FixedSizeListType &type) override;
   arrow::Status Visit(const arrow::StructType &type) override;
+  arrow::Status Visit(const arrow::BooleanType &type) override { return VisitFixedWidth(type); }
 
 #define VISIT_FIXED_WIDTH(TYPE) \
   arrow::Status Visit(const TYPE& type) override { return VisitFixedWidth<TYPE>(type); }
@@ -74,10 +80,8 @@ class FieldAnalyzer : public arrow::TypeVisitor {
 #undef VISIT_FIXED_WIDTH
 
   // TODO(johanpel): Not implemented yet:
-  // arrow::Status Visit(const arrow::BooleanType &type) override {}
   // arrow::Status Visit(const arrow::NullType &type) override {}
   // arrow::Status Visit(const UnionType& type) override {}
-  // arrow::Status Visit(const DictionaryType& type) override {}
   // arrow::Status Visit(const ExtensionType& type) override {}
 
   int level = 0;
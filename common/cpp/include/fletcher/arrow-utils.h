@@ -15,6 +15,9 @@
 #pragma once
 
 #include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <arrow/ipc/api.h>
+#include <arrow/util/compression.h>
 
 #include <vector>
 #include <memory>
@@ -39,18 +42,34 @@ struct BufferMetadata {
   /// non-nullable fields).
   bool implicit_ = false;
 
+  /// Owner of the bytes at raw_buffer_, if these are not owned by the analyzed Arrow data itself (e.g. a rebased
+  /// offsets buffer or a realigned validity bitmap of a sliced array).
+  std::shared_ptr<arrow::Buffer> owner_;
+
   BufferMetadata(const uint8_t *raw_buffer,
                  int64_t size,
                  std::vector<std::string> desc,
                  int level = 0,
-                 bool implicit = false)
-      : raw_buffer_(raw_buffer), size_(size), desc_(std::move(desc)), level_(level), implicit_(implicit) {}
+                 bool implicit = false,
+                 std::shared_ptr<arrow::Buffer> owner = nullptr)
+      : raw_buffer_(raw_buffer),
+        size_(size),
+        desc_(std::move(desc)),
+        level_(level),
+        implicit_(implicit),
+        owner_(std::move(owner)) {}
 };
 
 struct FieldMetadata {
   std::shared_ptr<arrow::DataType> type_{};
   int64_t length = 0;
   int64_t null_count = 0;
+  /// The index of the column of the RecordBatch or Schema that is described. Ignored columns are not described, so
+  /// this may differ from the index of the field description.
+  int column = 0;
+  /// Whether this describes the dictionary of a dictionary-encoded column. Such a column is described by two fields:
+  /// first its indices, then its dictionary.
+  bool dictionary = false;
   FieldMetadata() = default;
   FieldMetadata(std::shared_ptr<arrow::DataType> type, int64_t length, int64_t null_count)
       : type_(std::move(type)), length(length), null_count(null_count) {}
@@ -156,6 +175,27 @@ std::shared_ptr<arrow::Field> WithMetaIgnore(const arrow::Field &field);
 */
 std::shared_ptr<arrow::Field> WithMetaProfile(const arrow::Field &field);
 
+/**
+ * @brief Return the field through which the hardware accesses the indices of a dictionary-encoded field.
+ *
+ * It has the name, nullability and metadata of the dictionary-encoded field, and the index type of the dictionary.
+ *
+ * @param field   The dictionary-encoded field.
+ * @return        The field of the indices.
+ */
+std::shared_ptr<arrow::Field> GetDictionaryIndicesField(const arrow::Field &field);
+
+/**
+ * @brief Return the field through which the hardware accesses the dictionary of a dictionary-encoded field.
+ *
+ * It is named after the dictionary-encoded field with a "_dictionary" suffix, has the value type of the dictionary and
+ * is not nullable. Null elements of the column are expressed by the validity bitmap of the indices.
+ *
+ * @param field   The dictionary-encoded field.
+ * @return        The field of the dictionary.
+ */
+std::shared_ptr<arrow::Field> GetDictionaryValuesField(const arrow::Field &field);
+
 /**
  * Write a schema to a Flatbuffer file
  * @param file_name   File to write to.
@@ -164,21 +204,118 @@ std::shared_ptr<arrow::Field> WithMetaProfile(const arrow::Field &field);
  */
 void WriteSchemaToFile(const std::string &file_name, const arrow::Schema &schema);
 
+/// @brief Options for writing RecordBatches to Arrow IPC files.
+struct FileWriteOptions {
+  /**
+   * The alignment in bytes of every buffer in the file, e.g. 64 for bus beats or 4096 for pages. Must be a power of two
+   * of at least 8. Buffers are padded with zeros up to this alignment, so they can be used by the device straight from
+   * a memory-mapped file without realignment copies.
+   */
+  int64_t alignment = 64;
+  /// The codec to compress the buffers with, e.g. arrow::Compression::LZ4_FRAME or arrow::Compression::ZSTD.
+  arrow::Compression::type compression = arrow::Compression::UNCOMPRESSED;
+};
+
+/**
+ * @brief Writes a stream of RecordBatches with the same schema to a single Arrow IPC file.
+ *
+ * Unlike the writers of Arrow, every buffer in the file is aligned to FileWriteOptions::alignment relative to the start
+ * of the file, rather than to 8 bytes.
+ */
+class RecordBatchFileWriter {
+ public:
+  /**
+   * @brief Open a new file to write RecordBatches to.
+   * @param file_name The path to the output file.
+   * @param schema    The schema of all RecordBatches to write.
+   * @param out       The new writer.
+   * @param options   The options for writing the file.
+   * @return          True if successful, false otherwise.
+   */
+  static bool Make(const std::string &file_name,
+                   const std::shared_ptr<arrow::Schema> &schema,
+                   std::shared_ptr<RecordBatchFileWriter> *out,
+                   const FileWriteOptions &options = FileWriteOptions());
+
+  /// @brief Close the file, if this was not done already.
+  ~RecordBatchFileWriter();
+
+  /**
+   * @brief Append a RecordBatch to the file.
+   * @param batch The RecordBatch, which must have the schema of the writer.
+   * @return      True if successful, false otherwise.
+   */
+  bool Write(const arrow::RecordBatch &batch);
+
+  /**
+   * @brief Write the footer of the file and close it. No RecordBatches can be written afterwards.
+   * @return      True if successful, false otherwise.
+   */
+  bool Close();
+
+ private:
+  RecordBatchFileWriter(std::string file_name,
+                        std::shared_ptr<arrow::io::OutputStream> file,
+                        std::shared_ptr<arrow::ipc::RecordBatchWriter> writer)
+      : file_name_(std::move(file_name)), file_(std::move(file)), writer_(std::move(writer)) {}
+
+  std::string file_name_;
+  std::shared_ptr<arrow::io::OutputStream> file_;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> writer_;
+};
+
 /**
- * @brief Write the data buffers of an arrow::RecordBatch to a file.
- * @param filename    The path to the output file.
- * @param recordbatch The RecordBatch
+ * @brief Write one or multiple arrow::RecordBatch with the same schema to a file.
+ * @param filename      The path to the output file.
+ * @param recordbatches The RecordBatches.
+ * @param options       The options for writing the file.
  */
 void WriteRecordBatchesToFile(const std::string &filename,
-                              const std::vector<std::shared_ptr<arrow::RecordBatch>> &recordbatches);
+                              const std::vector<std::shared_ptr<arrow::RecordBatch>> &recordbatches,
+                              const FileWriteOptions &options = FileWriteOptions());
+
+/// @brief Options for reading RecordBatches from Arrow IPC files.
+struct FileReadOptions {
+  /**
+   * The pool to allocate the buffers of compressed files from, when they are decompressed. Arrow pools align
+   * allocations to 64 bytes, so the buffers can be made available to the device without realignment.
+   */
+  arrow::MemoryPool *memory_pool = arrow::default_memory_pool();
+  /// Whether to decompress the buffers of compressed (LZ4 frame or ZSTD) files in parallel on Arrow's CPU thread pool.
+  bool use_threads = true;
+};
 
 /**
  * @brief Read one or multiple arrow::RecordBatch from a file.
+ *
+ * Files with compressed buffers are decompressed per buffer, directly into memory of the memory pool in the options.
+ *
+ * @param file_name The path to the input file.
+ * @param out       Vector to store the RecordBatches.
+ * @param options   The options for reading the file.
+ * @return          True if successful, false otherwise.
+ */
+bool ReadRecordBatchesFromFile(const std::string &file_name,
+                               std::vector<std::shared_ptr<arrow::RecordBatch>> *out,
+                               const FileReadOptions &options = FileReadOptions());
+
+/**
+ * @brief Read one or multiple arrow::RecordBatch from a memory-mapped file.
+ *
+ * The buffers of the resulting RecordBatches reference the mapped pages directly, without copies to the heap. The
+ * mapping stays alive as long as any of the buffers do. Sequential readahead is advised for the whole mapping.
+ *
+ * Buffers of compressed files can not reference the mapping, and are decompressed like ReadRecordBatchesFromFile()
+ * does.
+ *
  * @param file_name The path to the input file.
  * @param out       Vector to store the RecordBatches.
+ * @param options   The options for reading the file.
  * @return          True if successful, false otherwise.
  */
-bool ReadRecordBatchesFromFile(const std::string &file_name, std::vector<std::shared_ptr<arrow::RecordBatch>> *out);
+bool ReadRecordBatchesFromMappedFile(const std::string &file_name,
+                                     std::vector<std::shared_ptr<arrow::RecordBatch>> *out,
+                                     const FileReadOptions &options = FileReadOptions());
 
 /**
  * @brief Reads a schema from a file.
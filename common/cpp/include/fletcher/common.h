@@ -18,6 +18,9 @@
 #include "fletcher/timer.h"
 #include "fletcher/logging.h"
 #include "fletcher/arrow-utils.h"
+#include "fletcher/arrow-options.h"
+#include "fletcher/arrow-layout.h"
+#include "fletcher/arrow-reader.h"
 #include "fletcher/arrow-recordbatch.h"
 #include "fletcher/arrow-schema.h"
 #include "fletcher/meta/meta.h"
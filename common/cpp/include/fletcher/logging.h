@@ -15,6 +15,7 @@
 #pragma once
 
 #include <string>
+#include <sstream>
 #include <cstdlib>
 
 #ifdef FLETCHER_USE_ARROW_LOGGING
@@ -23,9 +24,12 @@
  */
 #include <arrow/util/logging.h>
 
-// Logging Macros
+// Logging Macros. The message is only formatted if the level is enabled.
 #define FLETCHER_LOG_INTERNAL(level) ::arrow::util::ArrowLog(__FILE__, __LINE__, level)
-#define FLETCHER_LOG(level, msg) FLETCHER_LOG_INTERNAL(fletcher::FLETCHER_LOG_##level) << msg
+#define FLETCHER_LOG(level, msg)                                                        \
+  !::arrow::util::ArrowLog::IsLevelEnabled(FLETCHER_LOG_##level)                        \
+      ? static_cast<void>(0)                                                            \
+      : ::arrow::util::Voidify() & FLETCHER_LOG_INTERNAL(FLETCHER_LOG_##level) << msg
 
 // Logging levels
 constexpr arrow::util::ArrowLogLevel FLETCHER_LOG_DEBUG = arrow::util::ArrowLogLevel::ARROW_DEBUG;
@@ -34,6 +38,9 @@ constexpr arrow::util::ArrowLogLevel FLETCHER_LOG_WARNING = arrow::util::ArrowLo
 constexpr arrow::util::ArrowLogLevel FLETCHER_LOG_ERROR = arrow::util::ArrowLogLevel::ARROW_ERROR;
 constexpr arrow::util::ArrowLogLevel FLETCHER_LOG_FATAL = arrow::util::ArrowLogLevel::ARROW_FATAL;
 
+// The level from which messages are logged by default.
+constexpr arrow::util::ArrowLogLevel FLETCHER_LOG_DEFAULT_LEVEL = FLETCHER_LOG_DEBUG;
+
 namespace fletcher {
 
 using LogLevel = arrow::util::ArrowLogLevel;
@@ -46,11 +53,16 @@ inline void StopLogging() {
   arrow::util::ArrowLog::ShutDownArrowLog();
 }
 
+/// @brief Return true if messages of some level are logged.
+inline bool LogEnabled(LogLevel level) {
+  return arrow::util::ArrowLog::IsLevelEnabled(level);
+}
+
 }  // namespace fletcher
 
 #else
 /*
- * Use stdout to log
+ * Use stdout to log, or an asynchronous file sink if one is started.
  */
 #include <iostream>
 
@@ -61,35 +73,27 @@ constexpr int FLETCHER_LOG_WARNING = 1;
 constexpr int FLETCHER_LOG_ERROR = 2;
 constexpr int FLETCHER_LOG_FATAL = 3;
 
+// The level from which messages are logged by default.
 #ifndef NDEBUG
-#define FLETCHER_LOG(level, msg) \
-  if (FLETCHER_LOG_##level > FLETCHER_LOG_WARNING) {                      \
-    std::cerr << "[" + fletcher::level2str(FLETCHER_LOG_##level) + "]: "  \
-              << msg                                                      \
-              << std::endl;                                               \
-    std::exit(-1);                                                        \
-  } else {                                                                \
-    std::cout << "[" << fletcher::level2str(FLETCHER_LOG_##level) + "]: " \
-              << msg                                                      \
-              << std::endl;                                               \
-  }                                                                       \
-(void)0
-// ^ prevent empty statement linting errors
+constexpr int FLETCHER_LOG_DEFAULT_LEVEL = FLETCHER_LOG_DEBUG;
 #else
-#define FLETCHER_LOG(level, msg)                                          \
-if (FLETCHER_LOG_##level > FLETCHER_LOG_WARNING) {                        \
-    std::cerr << "[" + fletcher::level2str(FLETCHER_LOG_##level) + "]: "  \
-              << msg                                                      \
-              << std::endl;                                               \
-    std::exit(-1);                                                        \
-  } else if (FLETCHER_LOG_##level > FLETCHER_LOG_DEBUG) {                 \
-    std::cout << "[" << fletcher::level2str(FLETCHER_LOG_##level) + "]: " \
-              << msg                                                      \
-              << std::endl;                                               \
-  }                                                                       \
+constexpr int FLETCHER_LOG_DEFAULT_LEVEL = FLETCHER_LOG_INFO;
+#endif
+
+// The message is only formatted if the level is enabled. Errors always exit the program.
+#define FLETCHER_LOG(level, msg)                                                    \
+  if (FLETCHER_LOG_##level > FLETCHER_LOG_WARNING) {                                \
+    std::ostringstream fletcher_log_message;                                        \
+    fletcher_log_message << msg;                                                    \
+    fletcher::LogMessage(FLETCHER_LOG_##level, fletcher_log_message.str());         \
+    std::exit(-1);                                                                  \
+  } else if (fletcher::LogEnabled(FLETCHER_LOG_##level)) {                          \
+    std::ostringstream fletcher_log_message;                                        \
+    fletcher_log_message << msg;                                                    \
+    fletcher::LogMessage(FLETCHER_LOG_##level, fletcher_log_message.str());         \
+  }                                                                                 \
 (void)0
 // ^ prevent empty statement linting errors
-#endif
 
 namespace fletcher {
 
@@ -105,15 +109,49 @@ inline std::string level2str(int level) {
   }
 }
 
+/// @brief Set the level from which messages are logged. Errors are always logged.
+void SetLogLevel(LogLevel level);
+
+/// @brief Return the level from which messages are logged.
+LogLevel GetLogLevel();
+
+/// @brief Return true if messages of some level are logged.
+bool LogEnabled(LogLevel level);
+
+/**
+ * @brief Log a formatted message. Use FLETCHER_LOG instead, which only formats messages of enabled levels.
+ *
+ * Messages go to stdout, or to the file sink if one is started. Errors go to stderr, after the file sink is flushed.
+ * Messages are not flushed line by line.
+ */
+void LogMessage(LogLevel level, const std::string &message);
+
+/**
+ * @brief Start logging to a file, instead of stdout.
+ *
+ * Messages are appended to a buffer, which a background thread writes to the file in large blocks. Logging threads
+ * only wait for the file if the buffer holds many megabytes of messages that are still to be written.
+ *
+ * @param[in] file_name The file to log to. It is truncated.
+ * @return True if the file could be opened, false otherwise.
+ */
+bool StartLogFile(const std::string &file_name);
+
+/// @brief Write all buffered messages to the log file, and stop logging to it.
+void StopLogFile();
+
+/// @brief Set the level from which messages are logged.
 inline void StartLogging(const std::string &app_name, LogLevel level, const std::string &file_name) {
-  // No init required, but prevent compiler warnings by pretending to use the arguments.
+  // Messages go to stdout, unless StartLogFile() is used. Prevent compiler warnings by pretending to use the arguments.
   (void) app_name;
-  (void) level;
   (void) file_name;
+  SetLogLevel(level);
 }
 
+/// @brief Flush all logged messages.
 inline void StopLogging() {
-  // No shutdown required.
+  StopLogFile();
+  std::cout.flush();
 }
 
 }  // namespace fletcher
@@ -0,0 +1,436 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arrow/util/bitmap_ops.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fletcher/common.h"
+
+namespace fletcher {
+
+/// @brief Return the offset at some index of an offsets buffer with 32-bit or 64-bit offsets.
+static inline int64_t OffsetAt(const uint8_t *offsets, int64_t width, int64_t index) {
+  if (width == sizeof(int64_t)) {
+    return reinterpret_cast<const int64_t *>(offsets)[index];
+  }
+  return reinterpret_cast<const int32_t *>(offsets)[index];
+}
+
+/// @brief Return the width in bytes of the values of a fixed-width type supported by the analyzer, or 0 otherwise.
+static int64_t FixedByteWidth(const arrow::DataType &type) {
+  switch (type.id()) {
+    case arrow::Type::INT8:
+    case arrow::Type::INT16:
+    case arrow::Type::INT32:
+    case arrow::Type::INT64:
+    case arrow::Type::UINT8:
+    case arrow::Type::UINT16:
+    case arrow::Type::UINT32:
+    case arrow::Type::UINT64:
+    case arrow::Type::HALF_FLOAT:
+    case arrow::Type::FLOAT:
+    case arrow::Type::DOUBLE:
+    case arrow::Type::DATE32:
+    case arrow::Type::DATE64:
+    case arrow::Type::TIMESTAMP:
+    case arrow::Type::TIME32:
+    case arrow::Type::TIME64:
+    case arrow::Type::FIXED_SIZE_BINARY:
+    case arrow::Type::DECIMAL128:
+      return dynamic_cast<const arrow::FixedWidthType &>(type).bit_width() / 8;
+    default:
+      return 0;
+  }
+}
+
+bool BufferLayout::Make(const arrow::Schema &batch_schema,
+                        const arrow::Schema *kernel_schema,
+                        std::shared_ptr<BufferLayout> *out) {
+  auto layout = std::make_shared<BufferLayout>();
+  // The kernel schema, if any, determines the name, mode and fields as seen by the kernel.
+  const auto &schema = kernel_schema != nullptr ? *kernel_schema : batch_schema;
+  auto options = GetSchemaOptions(schema);
+  layout->name_ = options.name;
+  layout->mode_ = options.mode;
+  for (const auto &field : schema.fields()) {
+    if (GetFieldOptions(*field).ignore) {
+      continue;
+    }
+    auto column = batch_schema.GetFieldIndex(field->name());
+    if (column < 0) {
+      FLETCHER_LOG(WARNING, "RecordBatch has no (unique) column for kernel field " + field->name());
+      return false;
+    }
+    if (!batch_schema.field(column)->type()->Equals(field->type())) {
+      FLETCHER_LOG(WARNING, "Column " + field->name() + " has type " + batch_schema.field(column)->type()->ToString()
+          + ", but the kernel expects " + field->type()->ToString());
+      return false;
+    }
+    layout->fields_.emplace_back();
+    layout->fields_.back().field = field;
+    layout->fields_.back().column = column;
+    layout->fields_.back().first_slot = layout->slots_.size();
+    if (!layout->AddNode(*field, Relation::COLUMN, column, 0, 0, {field->name()}, 0)) {
+      FLETCHER_LOG(WARNING, "Unsupported type of field " + field->name() + ": " + field->type()->ToString());
+      return false;
+    }
+    // A dictionary-encoded column has added a field for its dictionary, which holds the remaining slots.
+    auto &column_field = layout->fields_.back().dictionary ? layout->fields_[layout->fields_.size() - 2]
+                                                           : layout->fields_.back();
+    if (layout->fields_.back().dictionary) {
+      column_field.num_slots = layout->fields_.back().first_slot - column_field.first_slot;
+      layout->fields_.back().num_slots = layout->slots_.size() - layout->fields_.back().first_slot;
+    } else {
+      column_field.num_slots = layout->slots_.size() - column_field.first_slot;
+    }
+  }
+  *out = layout;
+  return true;
+}
+
+bool BufferLayout::AddNode(const arrow::Field &field,
+                           Relation relation,
+                           int parent,
+                           int child,
+                           int64_t parent_param,
+                           std::vector<std::string> desc,
+                           int level) {
+  auto node = static_cast<int>(nodes_.size());
+  nodes_.emplace_back();
+  nodes_.back().relation = relation;
+  nodes_.back().parent = parent;
+  nodes_.back().child = child;
+  nodes_.back().parent_param = parent_param;
+
+  auto add_slot = [&](Kind kind, int64_t width, const std::string &name) {
+    slots_.emplace_back();
+    slots_.back().kind = kind;
+    slots_.back().node = node;
+    slots_.back().width = width;
+    slots_.back().level = level;
+    slots_.back().desc = desc;
+    slots_.back().desc.push_back(name);
+  };
+
+  if (field.nullable()) {
+    add_slot(Kind::VALIDITY, 0, "validity");
+  }
+
+  const auto &type = *field.type();
+  switch (type.id()) {
+    case arrow::Type::BOOL:
+      add_slot(Kind::BITMAP_VALUES, 0, "values");
+      return true;
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+      add_slot(Kind::OFFSETS, sizeof(int32_t), "offsets");
+      add_slot(Kind::BINARY_VALUES, sizeof(int32_t), "values");
+      return true;
+    case arrow::Type::LARGE_STRING:
+    case arrow::Type::LARGE_BINARY:
+      add_slot(Kind::OFFSETS, sizeof(int64_t), "offsets");
+      add_slot(Kind::BINARY_VALUES, sizeof(int64_t), "values");
+      return true;
+    case arrow::Type::LIST:
+    case arrow::Type::LARGE_LIST: {
+      if (type.num_fields() != 1) return false;
+      int64_t width = type.id() == arrow::Type::LIST ? sizeof(int32_t) : sizeof(int64_t);
+      add_slot(Kind::OFFSETS, width, "offsets");
+      return AddNode(*type.field(0), Relation::LIST_VALUES, node, 0, width, desc, level + 1);
+    }
+    case arrow::Type::FIXED_SIZE_LIST: {
+      if (type.num_fields() != 1) return false;
+      auto list_size = dynamic_cast<const arrow::FixedSizeListType &>(type).list_size();
+      return AddNode(*type.field(0), Relation::FIXED_SIZE_LIST_VALUES, node, 0, list_size, desc, level + 1);
+    }
+    case arrow::Type::STRUCT: {
+      for (int i = 0; i < type.num_fields(); i++) {
+        auto child_desc = desc;
+        child_desc.push_back(type.field(i)->name());
+        if (!AddNode(*type.field(i), Relation::STRUCT_CHILD, node, i, 0, child_desc, level + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case arrow::Type::DICTIONARY: {
+      if (relation != Relation::COLUMN) {
+        FLETCHER_LOG(WARNING, "Only top-level fields can be dictionary-encoded.");
+        return false;
+      }
+      if (mode_ == Mode::WRITE) {
+        FLETCHER_LOG(WARNING, "Kernels can not write dictionary-encoded fields.");
+        return false;
+      }
+      // The indices are held by the column itself, the dictionary is described in a field of its own.
+      const auto &dict_type = dynamic_cast<const arrow::DictionaryType &>(type);
+      add_slot(Kind::FIXED_VALUES, FixedByteWidth(*dict_type.index_type()), "values");
+      auto values_field = GetDictionaryValuesField(field);
+      auto column = fields_.back().column;
+      fields_.emplace_back();
+      fields_.back().field = values_field;
+      fields_.back().column = column;
+      fields_.back().dictionary = true;
+      fields_.back().first_slot = slots_.size();
+      return AddNode(*values_field, Relation::DICTIONARY, node, 0, 0, {values_field->name()}, 0);
+    }
+    default: {
+      auto width = FixedByteWidth(type);
+      if (width == 0) return false;
+      add_slot(Kind::FIXED_VALUES, width, "values");
+      return true;
+    }
+  }
+}
+
+bool BufferLayout::Locate(const arrow::RecordBatch &batch, int node, Span *out) const {
+  const auto &n = nodes_[node];
+  if (n.relation == Relation::COLUMN) {
+    const auto &data = batch.column_data(n.parent);
+    out->data = data.get();
+    out->offset = data->offset;
+    out->length = data->length;
+    return true;
+  }
+  Span parent;
+  if (!Locate(batch, n.parent, &parent)) {
+    return false;
+  }
+  switch (n.relation) {
+    case Relation::STRUCT_CHILD: {
+      // The physical offset of the struct applies to its children.
+      const auto *child = parent.data->child_data[n.child].get();
+      out->data = child;
+      out->offset = child->offset + parent.offset;
+      out->length = parent.length;
+      return true;
+    }
+    case Relation::LIST_VALUES: {
+      const auto *child = parent.data->child_data[0].get();
+      out->data = child;
+      const auto &offsets = parent.data->buffers[1];
+      if (mode_ == Mode::WRITE) {
+        // The kernel may use all the space that was allocated for the values of an output RecordBatch.
+        out->offset = child->offset;
+        out->length = child->length;
+      } else if (offsets == nullptr) {
+        out->offset = child->offset;
+        out->length = 0;
+      } else {
+        // Only the range of the values covered by the offsets.
+        auto first = OffsetAt(offsets->data(), n.parent_param, parent.offset);
+        auto last = OffsetAt(offsets->data(), n.parent_param, parent.offset + parent.length);
+        out->offset = child->offset + first;
+        out->length = last - first;
+      }
+      return true;
+    }
+    case Relation::FIXED_SIZE_LIST_VALUES: {
+      const auto *child = parent.data->child_data[0].get();
+      out->data = child;
+      out->offset = child->offset + parent.offset * n.parent_param;
+      out->length = parent.length * n.parent_param;
+      return true;
+    }
+    case Relation::DICTIONARY: {
+      // The dictionary is referenced as a whole, as any index may occur.
+      const auto *dictionary = parent.data->dictionary.get();
+      if (dictionary == nullptr) {
+        return false;
+      }
+      if (dictionary->GetNullCount() != 0) {
+        FLETCHER_LOG(WARNING, "Dictionaries with null values are not supported.");
+        return false;
+      }
+      out->data = dictionary;
+      out->offset = dictionary->offset;
+      out->length = dictionary->length;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+/// @brief Reference a bitmap in place if it starts at a byte boundary, or realign the covered range otherwise.
+static bool RefBitmap(const std::shared_ptr<arrow::Buffer> &bitmap, int64_t offset, int64_t length, BufferRef *out) {
+  if (bitmap == nullptr) {
+    return true;
+  }
+  out->size = (length + 7) / 8;
+  if (offset % 8 == 0) {
+    out->data = bitmap->data() + offset / 8;
+    return true;
+  }
+  auto result = arrow::internal::CopyBitmap(arrow::default_memory_pool(), bitmap->data(), offset, length);
+  if (!result.ok()) {
+    return false;
+  }
+  out->owner = result.ValueOrDie();
+  out->data = out->owner->data();
+  return true;
+}
+
+/// @brief Allocate a bitmap with all elements valid, for an output array without a validity bitmap.
+static bool AllocateValidBitmap(int64_t length, BufferRef *out) {
+  out->size = (length + 7) / 8;
+  auto result = arrow::AllocateBuffer(out->size);
+  if (!result.ok()) {
+    return false;
+  }
+  out->owner = std::move(result).ValueOrDie();
+  std::memset(out->owner->mutable_data(), 0xFF, out->size);
+  out->data = out->owner->data();
+  return true;
+}
+
+bool BufferLayout::ExtractSlot(const arrow::RecordBatch &batch, const Slot &slot, BufferRef *out) const {
+  Span span;
+  if (!Locate(batch, slot.node, &span)) {
+    return false;
+  }
+  const auto &buffers = span.data->buffers;
+  switch (slot.kind) {
+    case Kind::VALIDITY: {
+      const auto &bitmap = buffers[0];
+      if (mode_ == Mode::WRITE) {
+        // The validity of the elements of output RecordBatches is yet to be written by the kernel, so the bitmap can't
+        // be inspected, and must always be available to the kernel.
+        return bitmap == nullptr ? AllocateValidBitmap(span.length, out) : RefBitmap(bitmap, span.offset, span.length,
+                                                                                      out);
+      }
+      int64_t null_count = 0;
+      if (bitmap != nullptr) {
+        if (span.offset == span.data->offset && span.length == span.data->length) {
+          null_count = span.data->GetNullCount();
+        } else {
+          null_count = span.length - arrow::internal::CountSetBits(bitmap->data(), span.offset, span.length);
+        }
+      }
+      if (null_count == 0) {
+        out->implicit = true;
+        return true;
+      }
+      return RefBitmap(bitmap, span.offset, span.length, out);
+    }
+    case Kind::BITMAP_VALUES:
+      return RefBitmap(buffers[1], span.offset, span.length, out);
+    case Kind::FIXED_VALUES: {
+      if (buffers[1] != nullptr) {
+        out->data = buffers[1]->data() + span.offset * slot.width;
+      }
+      out->size = span.length * slot.width;
+      return true;
+    }
+    case Kind::OFFSETS: {
+      if (buffers[1] == nullptr) {
+        return true;
+      }
+      const auto *offsets = buffers[1]->data() + span.offset * slot.width;
+      out->data = offsets;
+      out->size = (span.length + 1) * slot.width;
+      // Offsets of output RecordBatches are yet to be written by the kernel, so they can't be inspected.
+      auto first = mode_ == Mode::WRITE ? 0 : OffsetAt(offsets, slot.width, 0);
+      if (first == 0) {
+        return true;
+      }
+      // Rebase the offsets, such that the first offset points to the first value covered by this array.
+      auto result = arrow::AllocateBuffer(out->size);
+      if (!result.ok()) {
+        return false;
+      }
+      out->owner = std::move(result).ValueOrDie();
+      auto *rebased = out->owner->mutable_data();
+      for (int64_t i = 0; i <= span.length; i++) {
+        if (slot.width == sizeof(int64_t)) {
+          reinterpret_cast<int64_t *>(rebased)[i] = OffsetAt(offsets, slot.width, i) - first;
+        } else {
+          reinterpret_cast<int32_t *>(rebased)[i] = static_cast<int32_t>(OffsetAt(offsets, slot.width, i) - first);
+        }
+      }
+      out->data = out->owner->data();
+      return true;
+    }
+    case Kind::BINARY_VALUES: {
+      const auto &values = buffers[2];
+      if (values == nullptr) {
+        return true;
+      }
+      if (mode_ == Mode::WRITE) {
+        // The kernel may use all the space that was allocated for the values of an output RecordBatch.
+        out->data = values->data();
+        out->size = values->size();
+        return true;
+      }
+      // Only the bytes of the values that are covered by the offsets.
+      int64_t first = 0;
+      int64_t last = 0;
+      if (buffers[1] != nullptr) {
+        first = OffsetAt(buffers[1]->data(), slot.width, span.offset);
+        last = OffsetAt(buffers[1]->data(), slot.width, span.offset + span.length);
+      }
+      out->data = values->data() + first;
+      out->size = last - first;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool BufferLayout::Extract(const arrow::RecordBatch &batch, std::vector<BufferRef> *buffers) const {
+  buffers->resize(slots_.size());
+  for (size_t i = 0; i < slots_.size(); i++) {
+    auto &ref = (*buffers)[i];
+    ref.data = nullptr;
+    ref.size = 0;
+    ref.implicit = false;
+    ref.owner.reset();
+    if (!ExtractSlot(batch, slots_[i], &ref)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+RecordBatchDescription BufferLayout::Describe(const arrow::RecordBatch &batch,
+                                              const std::vector<BufferRef> &buffers) const {
+  RecordBatchDescription desc;
+  desc.name = name_;
+  desc.rows = batch.num_rows();
+  desc.mode = mode_;
+  for (const auto &f : fields_) {
+    if (f.dictionary) {
+      const auto &dictionary = batch.column_data(f.column)->dictionary;
+      desc.fields.emplace_back(f.field->type(), dictionary->length, 0);
+    } else {
+      const auto &column = batch.column(f.column);
+      desc.fields.emplace_back(column->type(), column->length(), column->null_count());
+    }
+    desc.fields.back().column = f.column;
+    desc.fields.back().dictionary = f.dictionary;
+    for (size_t s = f.first_slot; s < f.first_slot + f.num_slots; s++) {
+      const auto &ref = buffers[s];
+      desc.fields.back().buffers.emplace_back(ref.data, ref.size, slots_[s].desc, slots_[s].level, ref.implicit,
+                                              ref.owner);
+    }
+  }
+  return desc;
+}
+
+}  // namespace fletcher
@@ -0,0 +1,201 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arrow/api.h>
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "fletcher/arrow-options.h"
+#include "fletcher/logging.h"
+#include "fletcher/meta/meta.h"
+
+namespace fletcher {
+
+/// The maximum number of metadata objects of which the options are cached, per cache.
+static constexpr size_t kMaxCachedOptions = 4096;
+
+/// @brief Record the first error of a parse.
+static void SetError(std::string *error, const std::string &key, const std::string &value, const std::string &what) {
+  if ((error != nullptr) && error->empty()) {
+    *error = "Invalid value \"" + value + "\" for key " + key + ": " + what;
+  }
+}
+
+/// @brief Parse a positive decimal integer that fits 32 bits, without any other characters.
+static bool ParsePositive(const std::string &value, uint32_t *out) {
+  if (value.empty() || (value.size() > 10)) {
+    return false;
+  }
+  uint64_t result = 0;
+  for (auto c : value) {
+    if ((c < '0') || (c > '9')) {
+      return false;
+    }
+    result = 10 * result + static_cast<uint64_t>(c - '0');
+  }
+  if ((result == 0) || (result > std::numeric_limits<uint32_t>::max())) {
+    return false;
+  }
+  *out = static_cast<uint32_t>(result);
+  return true;
+}
+
+bool FieldOptions::Parse(const arrow::Field &field, FieldOptions *out, std::string *error) {
+  *out = FieldOptions();
+  bool ok = true;
+  const auto &metadata = field.metadata();
+  if (metadata == nullptr) {
+    return true;
+  }
+  for (int64_t i = 0; i < metadata->size(); i++) {
+    const auto &key = metadata->key(i);
+    const auto &value = metadata->value(i);
+    if ((key == meta::IGNORE) || (key == meta::PROFILE)) {
+      // Any value other than "true" disables the option.
+      (key == meta::IGNORE ? out->ignore : out->profile) = value == meta::TRUE;
+    } else if ((key == meta::VALUE_EPC) || (key == meta::LIST_EPC) || (key == meta::TAG_WIDTH)) {
+      auto *option = key == meta::VALUE_EPC ? &out->epc : (key == meta::LIST_EPC ? &out->lepc : &out->tag_width);
+      if (!ParsePositive(value, option)) {
+        SetError(error, key, value, "expected a positive integer.");
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+bool SchemaOptions::Parse(const arrow::Schema &schema, SchemaOptions *out, std::string *error) {
+  *out = SchemaOptions();
+  bool ok = true;
+  const auto &metadata = schema.metadata();
+  if (metadata == nullptr) {
+    return true;
+  }
+  for (int64_t i = 0; i < metadata->size(); i++) {
+    const auto &key = metadata->key(i);
+    const auto &value = metadata->value(i);
+    if (key == meta::NAME) {
+      out->name = value;
+    } else if (key == meta::MODE) {
+      if (value == meta::WRITE) {
+        out->mode = Mode::WRITE;
+      } else if (value != meta::READ) {
+        SetError(error, key, value, std::string("expected \"") + meta::READ + "\" or \"" + meta::WRITE + "\".");
+        ok = false;
+      }
+    } else if (key == meta::BUS_SPEC) {
+      out->bus_spec = value;
+    }
+  }
+  return ok;
+}
+
+/**
+ * @brief A cache of options, keyed by the metadata they were parsed from.
+ *
+ * Metadata is immutable and shared by all fields or schemas derived from the same field or schema, so options can be
+ * cached per metadata object. The cache holds on to the metadata, so the addresses used as keys are never reused.
+ */
+template<typename Options>
+class OptionsCache {
+ public:
+  template<typename Subject>
+  Options Get(const Subject &subject, const std::string &kind) {
+    const auto &metadata = subject.metadata();
+    if (metadata == nullptr) {
+      return Options();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = entries_.find(metadata.get());
+    if (entry != entries_.end()) {
+      return entry->second.options;
+    }
+    Options options;
+    std::string error;
+    if (!Options::Parse(subject, &options, &error)) {
+      FLETCHER_LOG(WARNING, kind + " " + subject_name(subject) + ": " + error + " Using the default.");
+    }
+    if (entries_.size() == kMaxCachedOptions) {
+      entries_.clear();
+    }
+    entries_[metadata.get()] = {metadata, options};
+    return options;
+  }
+
+ private:
+  static std::string subject_name(const arrow::Field &field) { return field.name(); }
+  static std::string subject_name(const arrow::Schema &schema) {
+    auto i = schema.metadata()->FindKey(meta::NAME);
+    return i < 0 ? "(unnamed)" : schema.metadata()->value(i);
+  }
+
+  struct Entry {
+    std::shared_ptr<const arrow::KeyValueMetadata> metadata;
+    Options options;
+  };
+  std::mutex mutex_;
+  std::unordered_map<const arrow::KeyValueMetadata *, Entry> entries_;
+};
+
+FieldOptions GetFieldOptions(const arrow::Field &field) {
+  static OptionsCache<FieldOptions> cache;
+  return cache.Get(field, "Field");
+}
+
+SchemaOptions GetSchemaOptions(const arrow::Schema &schema) {
+  static OptionsCache<SchemaOptions> cache;
+  return cache.Get(schema, "Schema");
+}
+
+/// @brief Validate the options of a field and its children.
+static bool ValidateOptions(const arrow::Field &field, std::string *error) {
+  FieldOptions options;
+  std::string field_error;
+  if (!FieldOptions::Parse(field, &options, &field_error)) {
+    if (error != nullptr) {
+      *error = "Field " + field.name() + ": " + field_error;
+    }
+    return false;
+  }
+  for (const auto &child : field.type()->fields()) {
+    if (!ValidateOptions(*child, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ValidateOptions(const arrow::Schema &schema, std::string *error) {
+  SchemaOptions options;
+  std::string schema_error;
+  if (!SchemaOptions::Parse(schema, &options, &schema_error)) {
+    if (error != nullptr) {
+      *error = "Schema " + options.name + ": " + schema_error;
+    }
+    return false;
+  }
+  for (const auto &field : schema.fields()) {
+    if (!ValidateOptions(*field, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace fletcher
@@ -0,0 +1,194 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/arrow-reader.h"
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <arrow/ipc/api.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "fletcher/logging.h"
+
+namespace fletcher {
+
+/// @brief Return the number of bytes of all buffers of some ArrayData, including those of children and dictionaries.
+static int64_t BufferSize(const arrow::ArrayData &data) {
+  int64_t result = 0;
+  for (const auto &buffer : data.buffers) {
+    if (buffer != nullptr) {
+      result += buffer->size();
+    }
+  }
+  for (const auto &child : data.child_data) {
+    result += BufferSize(*child);
+  }
+  if (data.dictionary != nullptr) {
+    result += BufferSize(*data.dictionary);
+  }
+  return result;
+}
+
+/// @brief Return the number of bytes of all buffers of a RecordBatch.
+static int64_t BufferSize(const arrow::RecordBatch &batch) {
+  int64_t result = 0;
+  for (int i = 0; i < batch.num_columns(); i++) {
+    result += BufferSize(*batch.column_data(i));
+  }
+  return result;
+}
+
+PrefetchingRecordBatchReader::PrefetchingRecordBatchReader(std::shared_ptr<arrow::Schema> schema,
+                                                           Source source,
+                                                           PrefetchOptions options)
+    : schema_(std::move(schema)), source_(std::move(source)), options_(std::move(options)) {
+  thread_ = std::thread(&PrefetchingRecordBatchReader::Run, this);
+}
+
+PrefetchingRecordBatchReader::~PrefetchingRecordBatchReader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+}
+
+bool PrefetchingRecordBatchReader::Open(const std::string &file_name,
+                                        std::shared_ptr<PrefetchingRecordBatchReader> *out,
+                                        const PrefetchOptions &options) {
+  auto file_result = arrow::io::ReadableFile::Open(file_name, options.read_options.memory_pool);
+  if (!file_result.ok()) {
+    FLETCHER_LOG(ERROR,
+                 "Could not open file for reading: " + file_name + " ARROW:[" + file_result.status().ToString() + "]");
+    return false;
+  }
+  std::shared_ptr<arrow::io::ReadableFile> file = file_result.ValueOrDie();
+
+  auto ipc_options = arrow::ipc::IpcReadOptions::Defaults();
+  ipc_options.memory_pool = options.read_options.memory_pool;
+  ipc_options.use_threads = options.read_options.use_threads;
+
+  // Files in the file format start with magic bytes, files in the stream format start with a message.
+  const char magic[] = "ARROW1";
+  auto head = file->ReadAt(0, sizeof(magic) - 1);
+  bool file_format = head.ok() && (head.ValueOrDie()->size() == sizeof(magic) - 1)
+      && (std::memcmp(head.ValueOrDie()->data(), magic, sizeof(magic) - 1) == 0);
+
+  if (file_format) {
+    auto reader_result = arrow::ipc::RecordBatchFileReader::Open(file, ipc_options);
+    if (!reader_result.ok()) {
+      FLETCHER_LOG(ERROR,
+                   "Could not open RecordBatchFileReader. ARROW:[" + reader_result.status().ToString() + "]");
+      return false;
+    }
+    std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader = reader_result.ValueOrDie();
+    auto index = std::make_shared<int>(0);
+    Source source = [reader, index](std::shared_ptr<arrow::RecordBatch> *batch) {
+      if (*index >= reader->num_record_batches()) {
+        *batch = nullptr;
+        return arrow::Status::OK();
+      }
+      ARROW_ASSIGN_OR_RAISE(*batch, reader->ReadRecordBatch((*index)++));
+      return arrow::Status::OK();
+    };
+    *out = std::make_shared<PrefetchingRecordBatchReader>(reader->schema(), source, options);
+  } else {
+    // Streams are read from the current position, which is undefined after a ReadAt().
+    auto seek_status = file->Seek(0);
+    if (!seek_status.ok()) {
+      FLETCHER_LOG(ERROR, "Could not seek in file " + file_name + ". ARROW:[" + seek_status.ToString() + "]");
+      return false;
+    }
+    auto reader_result = arrow::ipc::RecordBatchStreamReader::Open(file, ipc_options);
+    if (!reader_result.ok()) {
+      FLETCHER_LOG(ERROR,
+                   "Could not open RecordBatchStreamReader. ARROW:[" + reader_result.status().ToString() + "]");
+      return false;
+    }
+    *out = Make(reader_result.ValueOrDie(), options);
+  }
+  return true;
+}
+
+std::shared_ptr<PrefetchingRecordBatchReader> PrefetchingRecordBatchReader::Make(
+    const std::shared_ptr<arrow::RecordBatchReader> &reader,
+    const PrefetchOptions &options) {
+  Source source = [reader](std::shared_ptr<arrow::RecordBatch> *batch) { return reader->ReadNext(batch); };
+  return std::make_shared<PrefetchingRecordBatchReader>(reader->schema(), source, options);
+}
+
+arrow::Status PrefetchingRecordBatchReader::ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return !queue_.empty() || done_; });
+  if (queue_.empty()) {
+    *batch = nullptr;
+    return status_;
+  }
+  *batch = queue_.front();
+  queue_.pop_front();
+  queued_bytes_ -= BufferSize(**batch);
+  lock.unlock();
+  changed_.notify_all();
+  return arrow::Status::OK();
+}
+
+int64_t PrefetchingRecordBatchReader::bytes_prefetched() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queued_bytes_;
+}
+
+bool PrefetchingRecordBatchReader::MayReadAhead() const {
+  if (queue_.empty()) {
+    return true;
+  }
+  if (queue_.size() >= options_.max_batches) {
+    return false;
+  }
+  return (options_.max_bytes == 0) || (queued_bytes_ < options_.max_bytes);
+}
+
+void PrefetchingRecordBatchReader::Run() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this] { return stop_ || MayReadAhead(); });
+      if (stop_) {
+        return;
+      }
+    }
+    std::shared_ptr<arrow::RecordBatch> batch;
+    auto status = source_(&batch);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!status.ok() || (batch == nullptr)) {
+        status_ = status;
+        done_ = true;
+      } else {
+        queue_.push_back(batch);
+        queued_bytes_ += BufferSize(*batch);
+      }
+    }
+    changed_.notify_all();
+    if (!status.ok() || (batch == nullptr)) {
+      return;
+    }
+  }
+}
+
+}  // namespace fletcher
@@ -12,8 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <arrow/util/bitmap_ops.h>
+
 #include <iomanip>
 #include <sstream>
+#include <cstring>
 
 #include "fletcher/common.h"
 
@@ -30,16 +33,114 @@ std::string RecordBatchDescription::ToString() const {
   return str.str();
 }
 
+void RecordBatchAnalyzer::AddBuffer(const uint8_t *data,
+                                    int64_t size,
+                                    const std::string &name,
+                                    std::shared_ptr<arrow::Buffer> owner) {
+  auto desc = buf_name;
+  desc.push_back(name);
+  out_->fields.back().buffers.emplace_back(data, size, desc, level, false, std::move(owner));
+}
+
+arrow::Status RecordBatchAnalyzer::AddValidity(const arrow::Array &arr) {
+  return AddBitmap(arr.null_bitmap(), arr.offset(), arr.length(), "validity");
+}
+
+arrow::Status RecordBatchAnalyzer::AddValidBitmap(int64_t length) {
+  auto num_bytes = (length + 7) / 8;
+  auto result = arrow::AllocateBuffer(num_bytes);
+  if (!result.ok()) {
+    return result.status();
+  }
+  std::shared_ptr<arrow::Buffer> bitmap = std::move(result).ValueOrDie();
+  std::memset(bitmap->mutable_data(), 0xFF, num_bytes);
+  AddBuffer(bitmap->data(), num_bytes, "validity", bitmap);
+  return arrow::Status::OK();
+}
+
+arrow::Status RecordBatchAnalyzer::AddBitmap(const std::shared_ptr<arrow::Buffer> &bitmap,
+                                             int64_t offset,
+                                             int64_t length,
+                                             const std::string &name) {
+  auto num_bytes = (length + 7) / 8;
+  if (bitmap == nullptr) {
+    AddBuffer(nullptr, 0, name);
+  } else if (offset % 8 == 0) {
+    // The bitmap of the array starts at a byte boundary and can be referenced in place.
+    AddBuffer(bitmap->data() + offset / 8, num_bytes, name);
+  } else {
+    // The first bit is somewhere in the middle of a byte. Realign the covered range of the bitmap.
+    auto result = arrow::internal::CopyBitmap(arrow::default_memory_pool(), bitmap->data(), offset, length);
+    if (!result.ok()) {
+      return result.status();
+    }
+    auto realigned = result.ValueOrDie();
+    AddBuffer(realigned->data(), num_bytes, name, realigned);
+  }
+  return arrow::Status::OK();
+}
+
+template<typename OffsetType>
+arrow::Status RecordBatchAnalyzer::AddOffsets(const OffsetType *offsets,
+                                              int64_t length,
+                                              int64_t *first,
+                                              int64_t *last) {
+  // Empty arrays may not have an offsets buffer at all.
+  if (offsets == nullptr) {
+    *first = 0;
+    *last = 0;
+    AddBuffer(nullptr, 0, "offsets");
+    return arrow::Status::OK();
+  }
+  auto size = static_cast<int64_t>((length + 1) * sizeof(OffsetType));
+  if (out_->mode == Mode::WRITE) {
+    // Offsets of output RecordBatches are yet to be written by the kernel, so they can't be inspected.
+    *first = 0;
+    *last = 0;
+    AddBuffer(reinterpret_cast<const uint8_t *>(offsets), size, "offsets");
+    return arrow::Status::OK();
+  }
+  *first = offsets[0];
+  *last = offsets[length];
+  if (*first == 0) {
+    // Offsets already start at zero, reference them in place.
+    AddBuffer(reinterpret_cast<const uint8_t *>(offsets), size, "offsets");
+  } else {
+    // Rebase the offsets, such that the first offset points to the first value covered by this array.
+    auto result = arrow::AllocateBuffer(size);
+    if (!result.ok()) {
+      return result.status();
+    }
+    std::shared_ptr<arrow::Buffer> rebased = std::move(result).ValueOrDie();
+    auto rebased_offsets = reinterpret_cast<OffsetType *>(rebased->mutable_data());
+    for (int64_t i = 0; i <= length; i++) {
+      rebased_offsets[i] = static_cast<OffsetType>(offsets[i] - *first);
+    }
+    AddBuffer(rebased->data(), size, "offsets", rebased);
+  }
+  return arrow::Status::OK();
+}
+
 arrow::Status RecordBatchAnalyzer::VisitArray(const arrow::Array &arr) {
   // buf_name += ":" + arr.type()->ToString();
   // buf_name.push_back(arr.type()->ToString());
   // Check if the field is nullable. If so, add the (implicit) validity bitmap buffer
   if (field->nullable()) {
-    auto desc = buf_name;
-    desc.emplace_back("validity");
-    if (arr.null_count() > 0) {
-      out_->fields.back().buffers.emplace_back(arr.null_bitmap()->data(), arr.null_bitmap()->size(), desc, level);
+    if (out_->mode == Mode::WRITE) {
+      // The validity of the elements of output RecordBatches is yet to be written by the kernel, so the bitmap can't
+      // be inspected, and must always be available to the kernel.
+      auto status = arr.null_bitmap() == nullptr ? AddValidBitmap(arr.length()) : AddValidity(arr);
+      if (!status.ok()) {
+        return status;
+      }
+    } else if (arr.null_count() > 0) {
+      auto status = AddValidity(arr);
+      if (!status.ok()) {
+        return status;
+      }
     } else {
+      auto desc = buf_name;
+      desc.emplace_back("validity");
       auto dummy = std::make_shared<arrow::Buffer>(nullptr, 0);
       out_->fields.back().buffers.emplace_back(dummy->data(), dummy->size(), desc, level, true);
     }
@@ -48,36 +149,106 @@ arrow::Status RecordBatchAnalyzer::VisitArray(const arrow::Array &arr) {
 }
 
 bool RecordBatchAnalyzer::Analyze(const arrow::RecordBatch &batch) {
-  out_->name = fletcher::GetMeta(*batch.schema(), fletcher::meta::NAME);
+  auto options = GetSchemaOptions(*batch.schema());
+  out_->name = options.name;
   out_->rows = batch.num_rows();
+  // The mode must be known before visiting, because the offsets of output RecordBatches can't be inspected.
+  out_->mode = options.mode;
   // Depth-first search every column (arrow::Array) for buffers.
   for (int i = 0; i < batch.num_columns(); ++i) {
-    auto arr = batch.column(i);
-    // Remember what field we are at
-    field = batch.schema()->field(i);
-    buf_name = {field->name()};
-    out_->fields.emplace_back(arr->type(), arr->length(), arr->null_count());
-    if (!VisitArray(*arr).ok()) {
+    auto column_field = batch.schema()->field(i);
+    if (GetFieldOptions(*column_field).ignore) {
+      continue;
+    }
+    if (!AnalyzeColumn(batch, i, column_field)) {
       return false;
     }
   }
   return true;
 }
 
+bool RecordBatchAnalyzer::Analyze(const arrow::RecordBatch &batch, const arrow::Schema &kernel_schema) {
+  auto options = GetSchemaOptions(kernel_schema);
+  out_->name = options.name;
+  out_->rows = batch.num_rows();
+  out_->mode = options.mode;
+  for (const auto &kernel_field : kernel_schema.fields()) {
+    if (GetFieldOptions(*kernel_field).ignore) {
+      continue;
+    }
+    auto i = batch.schema()->GetFieldIndex(kernel_field->name());
+    if (i < 0) {
+      FLETCHER_LOG(WARNING, "RecordBatch has no (unique) column for kernel field " + kernel_field->name());
+      return false;
+    }
+    if (!batch.column(i)->type()->Equals(kernel_field->type())) {
+      FLETCHER_LOG(WARNING, "Column " + kernel_field->name() + " has type " + batch.column(i)->type()->ToString()
+          + ", but the kernel expects " + kernel_field->type()->ToString());
+      return false;
+    }
+    if (!AnalyzeColumn(batch, i, kernel_field)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RecordBatchAnalyzer::AnalyzeColumn(const arrow::RecordBatch &batch,
+                                        int column,
+                                        const std::shared_ptr<arrow::Field> &column_field) {
+  auto arr = batch.column(column);
+  // Remember what field we are at
+  field = column_field;
+  buf_name = {field->name()};
+  level = 0;
+  out_->fields.emplace_back(arr->type(), arr->length(), arr->null_count());
+  out_->fields.back().column = column;
+  return VisitArray(*arr).ok();
+}
+
 arrow::Status RecordBatchAnalyzer::VisitBinary(const arrow::BinaryArray &array) {
-  auto odesc = buf_name;
-  odesc.emplace_back("offsets");
-  auto vdesc = buf_name;
-  vdesc.emplace_back("values");
-  out_->fields.back().buffers.emplace_back(array.value_offsets()->data(), array.value_offsets()->size(), odesc, level);
-  out_->fields.back().buffers.emplace_back(array.value_data()->data(), array.value_data()->size(), vdesc, level);
+  return VisitOffsetsAndValues(array);
+}
+
+arrow::Status RecordBatchAnalyzer::VisitBinary(const arrow::LargeBinaryArray &array) {
+  return VisitOffsetsAndValues(array);
+}
+
+template<typename ArrayType>
+arrow::Status RecordBatchAnalyzer::VisitOffsetsAndValues(const ArrayType &array) {
+  int64_t first = 0;
+  int64_t last = 0;
+  auto status = AddOffsets(array.raw_value_offsets(), array.length(), &first, &last);
+  if (!status.ok()) {
+    return status;
+  }
+  auto values = array.value_data();
+  if (out_->mode == Mode::WRITE) {
+    // The kernel may use all the space that was allocated for the values of an output RecordBatch.
+    AddBuffer(values == nullptr ? nullptr : values->data(), values == nullptr ? 0 : values->size(), "values");
+  } else {
+    // Only describe the bytes of the values that are covered by the offsets.
+    AddBuffer(values == nullptr ? nullptr : values->data() + first, last - first, "values");
+  }
   return arrow::Status::OK();
 }
 
 arrow::Status RecordBatchAnalyzer::Visit(const arrow::ListArray &array) {
-  auto desc = buf_name;
-  desc.emplace_back("offsets");
-  out_->fields.back().buffers.emplace_back(array.value_offsets()->data(), array.value_offsets()->size(), desc, level);
+  return VisitOffsetsAndChild(array);
+}
+
+arrow::Status RecordBatchAnalyzer::Visit(const arrow::LargeListArray &array) {
+  return VisitOffsetsAndChild(array);
+}
+
+template<typename ArrayType>
+arrow::Status RecordBatchAnalyzer::VisitOffsetsAndChild(const ArrayType &array) {
+  int64_t first = 0;
+  int64_t last = 0;
+  auto status = AddOffsets(array.raw_value_offsets(), array.length(), &first, &last);
+  if (!status.ok()) {
+    return status;
+  }
   // Advance to the next nesting level.
   level++;
   // A list should only have one child.
@@ -85,8 +256,24 @@ arrow::Status RecordBatchAnalyzer::Visit(const arrow::ListArray &array) {
     return arrow::Status::TypeError("List type does not have exactly one child.");
   }
   field = field->type()->field(0);
-  // Visit the nested values array
-  return VisitArray(*array.values());
+  if (out_->mode == Mode::WRITE) {
+    // The kernel may use all the space that was allocated for the values of an output RecordBatch.
+    return VisitArray(*array.values());
+  }
+  // Visit the range of the nested values array that is covered by the offsets.
+  return VisitArray(*array.values()->Slice(first, last - first));
+}
+
+arrow::Status RecordBatchAnalyzer::Visit(const arrow::FixedSizeListArray &array) {
+  // Advance to the next nesting level.
+  level++;
+  // A list should only have one child.
+  if (field->type()->num_fields() != 1) {
+    return arrow::Status::TypeError("Fixed-size list type does not have exactly one child.");
+  }
+  field = field->type()->field(0);
+  // Every list has the same size, so there are no offsets. Visit the range of the values covered by this array.
+  return VisitArray(*array.values()->Slice(array.value_offset(0), array.length() * array.list_type()->list_size()));
 }
 
 arrow::Status RecordBatchAnalyzer::Visit(const arrow::StructArray &array) {
@@ -100,6 +287,7 @@ arrow::Status RecordBatchAnalyzer::Visit(const arrow::StructArray &array) {
         "Number of child arrays for struct does not match number of child fields for field type.");
   }
   for (int i = 0; i < array.num_fields(); ++i) {
+    // The child array returned by Arrow already has the offset and length of the struct applied.
     std::shared_ptr<arrow::Array> child_array = array.field(i);
     // Go down one nesting level
     level++;
@@ -116,4 +304,31 @@ arrow::Status RecordBatchAnalyzer::Visit(const arrow::StructArray &array) {
   return arrow::Status::OK();
 }
 
+arrow::Status RecordBatchAnalyzer::Visit(const arrow::DictionaryArray &array) {
+  if (level != 0) {
+    return arrow::Status::NotImplemented("Only top-level fields can be dictionary-encoded.");
+  }
+  if (out_->mode == Mode::WRITE) {
+    return arrow::Status::NotImplemented("Kernels can not write dictionary-encoded fields.");
+  }
+  auto dictionary = array.dictionary();
+  if (dictionary->null_count() != 0) {
+    return arrow::Status::NotImplemented("Dictionaries with null values are not supported.");
+  }
+  // The indices are described in the field of the column itself. Any validity bitmap was added already.
+  auto column_field = field;
+  auto status = array.indices()->Accept(this);
+  if (!status.ok()) {
+    return status;
+  }
+  // The dictionary is described in a field of its own. It is referenced as a whole, as any index may occur.
+  auto column = out_->fields.back().column;
+  field = GetDictionaryValuesField(*column_field);
+  buf_name = {field->name()};
+  out_->fields.emplace_back(field->type(), dictionary->length(), 0);
+  out_->fields.back().column = column;
+  out_->fields.back().dictionary = true;
+  return VisitArray(*dictionary);
+}
+
 }  // namespace fletcher
@@ -20,6 +20,7 @@
 
 #include "fletcher/logging.h"
 #include "fletcher/arrow-schema.h"
+#include "fletcher/arrow-options.h"
 #include "fletcher/meta/meta.h"
 
 namespace fletcher {
@@ -28,15 +29,40 @@ bool SchemaAnalyzer::Analyze(const arrow::Schema &schema) {
   // RecordBatch is virtual, i.e. there is no physically stored RecordBatch
   out_->is_virtual = true;
   // Get schema/recordbatch name
-  out_->name = fletcher::GetMeta(schema, fletcher::meta::NAME);
+  auto options = GetSchemaOptions(schema);
+  out_->name = options.name;
+  out_->mode = options.mode;
   // Set number of rows to 0
   out_->rows = 0;
 
   // Analyze every field using a FieldAnalyzer.
   for (int i = 0; i < schema.num_fields(); ++i) {
+    // Ignored fields are not used by the hardware.
+    if (GetFieldOptions(*schema.field(i)).ignore) {
+      continue;
+    }
+    auto field = schema.field(i);
+    if (field->type()->id() == arrow::Type::DICTIONARY) {
+      // Describe the indices and the dictionary as two fields, like the RecordBatchAnalyzer does.
+      FieldMetadata indices_meta;
+      indices_meta.column = i;
+      FieldAnalyzer ia(&indices_meta, {field->name()});
+      ia.Analyze(*GetDictionaryIndicesField(*field));
+      indices_meta.type_ = field->type();
+      out_->fields.push_back(indices_meta);
+      auto dictionary_field = GetDictionaryValuesField(*field);
+      FieldMetadata dictionary_meta;
+      dictionary_meta.column = i;
+      dictionary_meta.dictionary = true;
+      FieldAnalyzer da(&dictionary_meta, {dictionary_field->name()});
+      da.Analyze(*dictionary_field);
+      out_->fields.push_back(dictionary_meta);
+      continue;
+    }
     FieldMetadata field_meta;
-    FieldAnalyzer fa(&field_meta, {schema.field(i)->name()});
-    fa.Analyze(*schema.field(i));
+    field_meta.column = i;
+    FieldAnalyzer fa(&field_meta, {field->name()});
+    fa.Analyze(*field);
     out_->fields.push_back(field_meta);
   }
   return true;
@@ -79,7 +105,7 @@ arrow::Status FieldAnalyzer::VisitType(const arrow::DataType &type) {
   return type.Accept(this);
 }
 
-arrow::Status FieldAnalyzer::VisitBinary(const arrow::BinaryType &type) {
+arrow::Status FieldAnalyzer::VisitBinary(const arrow::BaseBinaryType &type) {
   // Suppress unused warning
   (void) type;
   // Expect an offsets buffer
@@ -93,7 +119,7 @@ arrow::Status FieldAnalyzer::VisitBinary(const arrow::BinaryType &type) {
   return arrow::Status::OK();
 }
 
-arrow::Status FieldAnalyzer::Visit(const arrow::ListType &type) {
+arrow::Status FieldAnalyzer::VisitList(const arrow::BaseListType &type) {
   // Expect an offsets buffer
   auto desc = buf_name_;
   desc.emplace_back("offsets");
@@ -108,6 +134,17 @@ arrow::Status FieldAnalyzer::Visit(const arrow::ListType &type) {
   return VisitType(*type.field(0)->type());
 }
 
+arrow::Status FieldAnalyzer::Visit(const arrow::FixedSizeListType &type) {
+  // Fixed-size lists have no offsets buffer. Advance to the next nesting level.
+  level++;
+  // A list should only have one child.
+  if (type.num_fields() != 1) {
+    return arrow::Status::TypeError("Fixed-size list type does not have exactly one child.");
+  }
+  // Visit the nested values array
+  return VisitType(*type.field(0)->type());
+}
+
 arrow::Status FieldAnalyzer::Visit(const arrow::StructType &type) {
   arrow::Status status;
   // Remember this nesting level name
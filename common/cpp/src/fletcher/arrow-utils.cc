@@ -15,53 +15,45 @@
 #include <arrow/api.h>
 #include <arrow/io/api.h>
 #include <arrow/ipc/api.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <utility>
 #include <memory>
 #include <vector>
 #include <iostream>
-#include <unordered_map>
 #include <sstream>
+#include <cstring>
 
 #include "fletcher/arrow-utils.h"
+#include "fletcher/arrow-options.h"
 #include "fletcher/logging.h"
 #include "fletcher/meta/meta.h"
 
 namespace fletcher {
 
-std::string GetMeta(const arrow::Schema &schema, const std::string &key) {
-  if (schema.metadata() != nullptr) {
-    std::unordered_map<std::string, std::string> meta;
-    schema.metadata()->ToUnorderedMap(&meta);
-
-    auto k = meta.find(key);
-    if (k != meta.end()) {
-      return k->second;
+/// @brief Return the value of a key of some metadata, or an empty string if the key is absent.
+static std::string FindMeta(const std::shared_ptr<const arrow::KeyValueMetadata> &metadata, const std::string &key) {
+  if (metadata != nullptr) {
+    auto i = metadata->FindKey(key);
+    if (i >= 0) {
+      return metadata->value(i);
     }
   }
   // Return empty string if no metadata
   return "";
 }
 
+std::string GetMeta(const arrow::Schema &schema, const std::string &key) {
+  return FindMeta(schema.metadata(), key);
+}
+
 std::string GetMeta(const arrow::Field &field, const std::string &key) {
-  if (field.metadata() != nullptr) {
-    std::unordered_map<std::string, std::string> meta;
-    field.metadata()->ToUnorderedMap(&meta);
-    auto k = meta.find(key);
-    if (k != meta.end()) {
-      return k->second;
-    }
-  }
-  // Return empty string if no metadata
-  return "";
+  return FindMeta(field.metadata(), key);
 }
 
 Mode GetMode(const arrow::Schema &schema) {
-  Mode mode = Mode::READ;
-  if (GetMeta(schema, fletcher::meta::MODE) == "write") {
-    mode = Mode::WRITE;
-  }
-  return mode;
+  return GetSchemaOptions(schema).mode;
 }
 
 uint64_t GetUIntMeta(const arrow::Field &field, const std::string &key, int default_to) {
@@ -144,6 +136,16 @@ std::shared_ptr<arrow::Field> WithMetaProfile(const arrow::Field &field) {
   return field.WithMetadata(meta);
 }
 
+std::shared_ptr<arrow::Field> GetDictionaryIndicesField(const arrow::Field &field) {
+  const auto &type = static_cast<const arrow::DictionaryType &>(*field.type());
+  return field.WithType(type.index_type());
+}
+
+std::shared_ptr<arrow::Field> GetDictionaryValuesField(const arrow::Field &field) {
+  const auto &type = static_cast<const arrow::DictionaryType &>(*field.type());
+  return arrow::field(field.name() + "_dictionary", type.value_type(), false, field.metadata());
+}
+
 bool ReadSchemaFromFile(const std::string &file_name,
                         std::shared_ptr<arrow::Schema> *out) {
   std::shared_ptr<arrow::Schema> schema;
@@ -203,39 +205,264 @@ void WriteSchemaToFile(const std::string &file_name, const arrow::Schema &schema
   }
 }
 
-void WriteRecordBatchesToFile(const std::string &filename,
-                              const std::vector<std::shared_ptr<arrow::RecordBatch>> &recordbatches) {
-  std::shared_ptr<arrow::io::FileOutputStream>
-      file = arrow::io::FileOutputStream::Open(filename).ValueOrDie();
-  arrow::Status status;
-  for (const auto &rb : recordbatches) {
-    std::shared_ptr<arrow::ipc::RecordBatchWriter>
-        writer = arrow::ipc::MakeFileWriter(file.get(), rb->schema()).ValueOrDie();
-    status = writer->WriteRecordBatch(*rb);
-    if (!status.ok()) {
-      throw std::runtime_error("Error writing recordbatches to file " + filename);
-    }
-    status = writer->Close();
+namespace {
+
+/// @brief Load a little-endian value from a flatbuffer.
+template<typename T>
+T Load(const uint8_t *buffer, int64_t position) {
+  T value;
+  std::memcpy(&value, buffer + position, sizeof(T));
+  return value;
+}
+
+/// @brief Return the position of a field of a flatbuffer table, or zero if the field is absent.
+int64_t FieldPosition(const uint8_t *buffer, int64_t table, int field) {
+  auto vtable = table - Load<int32_t>(buffer, table);
+  auto entry = 4 + 2 * field;
+  if (entry >= Load<uint16_t>(buffer, vtable)) {
+    return 0;
   }
-  status = file->Close();
+  auto offset = Load<uint16_t>(buffer, vtable + entry);
+  return offset == 0 ? 0 : table + offset;
 }
 
-bool ReadRecordBatchesFromFile(const std::string &file_name,
-                               std::vector<std::shared_ptr<arrow::RecordBatch>> *out) {
-  std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader;
+/// @brief Return the position of the table or vector referenced by a field of a flatbuffer table, or zero if absent.
+int64_t Dereference(const uint8_t *buffer, int64_t table, int field) {
+  auto position = FieldPosition(buffer, table, field);
+  return position == 0 ? 0 : position + Load<uint32_t>(buffer, position);
+}
 
-  arrow::Result<std::shared_ptr<arrow::io::ReadableFile>>
-      result = arrow::io::ReadableFile::Open(file_name);
-  if (!result.ok()) {
+// Field indices in the flatbuffer tables of the Arrow IPC format, see Message.fbs.
+constexpr int kMessageHeaderType = 1;
+constexpr int kMessageHeader = 2;
+constexpr int kMessageBodyLength = 3;
+constexpr int kDictionaryBatchData = 1;
+constexpr int kRecordBatchBuffers = 2;
+constexpr uint8_t kHeaderDictionaryBatch = 2;
+constexpr uint8_t kHeaderRecordBatch = 3;
+// The size of the continuation marker and the length that precede the metadata of every message.
+constexpr int64_t kMessagePrefixSize = 8;
+
+/**
+ * @brief Aligns every body buffer of the IPC messages written to a file.
+ *
+ * The layout of message bodies is fixed by Arrow to 8-byte aligned buffers. This writer moves the buffers of every
+ * body to multiples of the alignment, by updating the buffer offsets and body length in the message metadata and
+ * inserting zero padding between the buffers. It also pads the metadata of every message such that its body starts at
+ * a multiple of the alignment in the file. The result is a regular Arrow IPC file that any reader can read.
+ */
+class AligningPayloadWriter : public arrow::ipc::internal::IpcPayloadWriter {
+ public:
+  AligningPayloadWriter(std::unique_ptr<arrow::ipc::internal::IpcPayloadWriter> writer, int64_t alignment)
+      : writer_(std::move(writer)), alignment_(alignment) {}
+
+  arrow::Status Start() override {
+    // The file writer starts with the magic bytes, padded to 8 bytes.
+    position_ = 8;
+    return writer_->Start();
+  }
+
+  arrow::Status WritePayload(const arrow::ipc::IpcPayload &payload) override {
+    arrow::ipc::IpcPayload aligned = payload;
+    if (payload.metadata == nullptr) {
+      return writer_->WritePayload(aligned);
+    }
+    // Make a copy of the metadata to update, with room for padding.
+    auto size = static_cast<int64_t>(payload.metadata->size());
+    auto padded_size = Align(position_ + kMessagePrefixSize + size) - position_ - kMessagePrefixSize;
+    ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::Buffer> metadata, arrow::AllocateBuffer(padded_size));
+    std::memset(metadata->mutable_data(), 0, static_cast<size_t>(padded_size));
+    std::memcpy(metadata->mutable_data(), payload.metadata->data(), static_cast<size_t>(size));
+    aligned.metadata = metadata;
+    if (!payload.body_buffers.empty()) {
+      ARROW_RETURN_NOT_OK(AlignBody(metadata->mutable_data(), &aligned));
+    }
+    position_ += kMessagePrefixSize + padded_size + aligned.body_length;
+    return writer_->WritePayload(aligned);
+  }
+
+  arrow::Status Close() override { return writer_->Close(); }
+
+ private:
+  int64_t Align(int64_t value) const { return (value + alignment_ - 1) / alignment_ * alignment_; }
+
+  /// @brief Move all body buffers to multiples of the alignment.
+  arrow::Status AlignBody(uint8_t *metadata, arrow::ipc::IpcPayload *payload) {
+    auto message = static_cast<int64_t>(Load<uint32_t>(metadata, 0));
+    auto header_type_field = FieldPosition(metadata, message, kMessageHeaderType);
+    auto header_type = header_type_field == 0 ? 0 : Load<uint8_t>(metadata, header_type_field);
+    auto record_batch = Dereference(metadata, message, kMessageHeader);
+    if (header_type == kHeaderDictionaryBatch) {
+      record_batch = Dereference(metadata, record_batch, kDictionaryBatchData);
+    } else if (header_type != kHeaderRecordBatch) {
+      return arrow::Status::Invalid("Unexpected IPC message with a body.");
+    }
+    auto buffers = Dereference(metadata, record_batch, kRecordBatchBuffers);
+    auto num_buffers = static_cast<size_t>(buffers == 0 ? 0 : Load<uint32_t>(metadata, buffers));
+    if (num_buffers != payload->body_buffers.size()) {
+      return arrow::Status::Invalid("IPC message metadata does not match its body.");
+    }
+
+    // Every Buffer struct in the vector holds a 64-bit offset followed by a 64-bit length.
+    std::vector<std::shared_ptr<arrow::Buffer>> body;
+    int64_t offset = 0;
+    for (size_t i = 0; i < num_buffers; i++) {
+      auto entry = buffers + 4 + 16 * static_cast<int64_t>(i);
+      auto length = Load<int64_t>(metadata, entry + 8);
+      std::memcpy(metadata + entry, &offset, sizeof(offset));
+      const auto &buffer = payload->body_buffers[i];
+      if (buffer != nullptr) {
+        body.push_back(buffer);
+      }
+      // Arrow pads every buffer to 8 bytes itself, so only add the remainder.
+      auto padding = Align(length) - ((length + 7) / 8 * 8);
+      if (padding > 0) {
+        ARROW_ASSIGN_OR_RAISE(auto zeros, Zeros());
+        body.push_back(arrow::SliceBuffer(zeros, 0, padding));
+      }
+      offset += Align(length);
+    }
+
+    auto body_length_field = FieldPosition(metadata, message, kMessageBodyLength);
+    if (body_length_field == 0) {
+      if (offset != 0) {
+        return arrow::Status::Invalid("IPC message metadata has no body length.");
+      }
+    } else {
+      std::memcpy(metadata + body_length_field, &offset, sizeof(offset));
+    }
+    payload->body_buffers = body;
+    payload->body_length = offset;
+    return arrow::Status::OK();
+  }
+
+  /// @brief Return a buffer of zeros as large as the alignment.
+  arrow::Result<std::shared_ptr<arrow::Buffer>> Zeros() {
+    if (zeros_ == nullptr) {
+      ARROW_ASSIGN_OR_RAISE(zeros_, arrow::AllocateBuffer(alignment_));
+      std::memset(zeros_->mutable_data(), 0, static_cast<size_t>(alignment_));
+    }
+    return zeros_;
+  }
+
+  std::unique_ptr<arrow::ipc::internal::IpcPayloadWriter> writer_;
+  int64_t alignment_;
+  int64_t position_ = 0;
+  std::shared_ptr<arrow::Buffer> zeros_;
+};
+
+}  // namespace
+
+bool RecordBatchFileWriter::Make(const std::string &file_name,
+                                 const std::shared_ptr<arrow::Schema> &schema,
+                                 std::shared_ptr<RecordBatchFileWriter> *out,
+                                 const FileWriteOptions &options) {
+  if ((options.alignment < 8) || ((options.alignment & (options.alignment - 1)) != 0)) {
+    FLETCHER_LOG(ERROR, "Alignment must be a power of two of at least 8, but is " << options.alignment);
+    return false;
+  }
+  auto ipc_options = arrow::ipc::IpcWriteOptions::Defaults();
+  if (options.compression != arrow::Compression::UNCOMPRESSED) {
+    auto codec = arrow::util::Codec::Create(options.compression);
+    if (!codec.ok()) {
+      FLETCHER_LOG(ERROR, "Could not create compression codec. ARROW:[" + codec.status().ToString() + "]");
+      return false;
+    }
+    ipc_options.codec = std::move(codec).ValueOrDie();
+  }
+
+  auto file = arrow::io::FileOutputStream::Open(file_name);
+  if (!file.ok()) {
     FLETCHER_LOG(ERROR,
-                 "Could not open file for reading: " + file_name + " ARROW:["
-                     + result.status().ToString() + "]");
+                 "Could not open file for writing: " + file_name + " ARROW:[" + file.status().ToString() + "]");
+    return false;
+  }
+  std::shared_ptr<arrow::io::OutputStream> stream = file.ValueOrDie();
+  auto payload_writer = arrow::ipc::internal::MakePayloadFileWriter(stream.get(), schema, ipc_options);
+  if (!payload_writer.ok()) {
+    FLETCHER_LOG(ERROR, "Could not create IPC file writer. ARROW:[" + payload_writer.status().ToString() + "]");
+    return false;
+  }
+  std::unique_ptr<arrow::ipc::internal::IpcPayloadWriter> aligning_writer(
+      new AligningPayloadWriter(std::move(payload_writer).ValueOrDie(), options.alignment));
+  auto writer = arrow::ipc::internal::OpenRecordBatchWriter(std::move(aligning_writer), schema, ipc_options);
+  if (!writer.ok()) {
+    FLETCHER_LOG(ERROR, "Could not create IPC file writer. ARROW:[" + writer.status().ToString() + "]");
     return false;
   }
-  std::shared_ptr<arrow::io::ReadableFile> file = result.ValueOrDie();
+  out->reset(new RecordBatchFileWriter(file_name, stream, std::move(writer).ValueOrDie()));
+  return true;
+}
 
+RecordBatchFileWriter::~RecordBatchFileWriter() {
+  if (writer_ != nullptr) {
+    Close();
+  }
+}
+
+bool RecordBatchFileWriter::Write(const arrow::RecordBatch &batch) {
+  if (writer_ == nullptr) {
+    FLETCHER_LOG(ERROR, "Can not write to closed file " + file_name_);
+    return false;
+  }
+  auto status = writer_->WriteRecordBatch(batch);
+  if (!status.ok()) {
+    FLETCHER_LOG(ERROR, "Could not write RecordBatch to file " + file_name_ + " ARROW:[" + status.ToString() + "]");
+    return false;
+  }
+  return true;
+}
+
+bool RecordBatchFileWriter::Close() {
+  if (writer_ == nullptr) {
+    return true;
+  }
+  auto status = writer_->Close();
+  writer_ = nullptr;
+  if (status.ok()) {
+    status = file_->Close();
+  }
+  if (!status.ok()) {
+    FLETCHER_LOG(ERROR, "Could not close file " + file_name_ + " ARROW:[" + status.ToString() + "]");
+    return false;
+  }
+  return true;
+}
+
+void WriteRecordBatchesToFile(const std::string &filename,
+                              const std::vector<std::shared_ptr<arrow::RecordBatch>> &recordbatches,
+                              const FileWriteOptions &options) {
+  if (recordbatches.empty()) {
+    throw std::runtime_error("No recordbatches to write to file " + filename);
+  }
+  // All RecordBatches go through a single writer, so the file holds one schema and one footer.
+  std::shared_ptr<RecordBatchFileWriter> writer;
+  if (!RecordBatchFileWriter::Make(filename, recordbatches[0]->schema(), &writer, options)) {
+    throw std::runtime_error("Could not open file for writing: " + filename);
+  }
+  for (const auto &rb : recordbatches) {
+    if (!writer->Write(*rb)) {
+      throw std::runtime_error("Error writing recordbatches to file " + filename);
+    }
+  }
+  if (!writer->Close()) {
+    throw std::runtime_error("Error writing recordbatches to file " + filename);
+  }
+}
+
+/// @brief Read all RecordBatches from an Arrow IPC file.
+static bool ReadRecordBatches(const std::shared_ptr<arrow::io::RandomAccessFile> &file,
+                              std::vector<std::shared_ptr<arrow::RecordBatch>> *out,
+                              const FileReadOptions &options) {
+  // Arrow decompresses every buffer of a compressed RecordBatch into a new allocation of the memory pool. With
+  // threads enabled, the buffers of a RecordBatch are decompressed in parallel.
+  auto ipc_options = arrow::ipc::IpcReadOptions::Defaults();
+  ipc_options.memory_pool = options.memory_pool;
+  ipc_options.use_threads = options.use_threads;
+
+  std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader;
   arrow::Result<std::shared_ptr<arrow::ipc::RecordBatchFileReader>> file_result;
-  file_result = arrow::ipc::RecordBatchFileReader::Open(file);
+  file_result = arrow::ipc::RecordBatchFileReader::Open(file, ipc_options);
   if (file_result.ok()) {
     reader = file_result.ValueOrDie();
   } else {
@@ -263,6 +490,49 @@ bool ReadRecordBatchesFromFile(const std::string &file_name,
   return true;
 }
 
+bool ReadRecordBatchesFromFile(const std::string &file_name,
+                               std::vector<std::shared_ptr<arrow::RecordBatch>> *out,
+                               const FileReadOptions &options) {
+  arrow::Result<std::shared_ptr<arrow::io::ReadableFile>>
+      result = arrow::io::ReadableFile::Open(file_name);
+  if (!result.ok()) {
+    FLETCHER_LOG(ERROR,
+                 "Could not open file for reading: " + file_name + " ARROW:["
+                     + result.status().ToString() + "]");
+    return false;
+  }
+  return ReadRecordBatches(result.ValueOrDie(), out, options);
+}
+
+bool ReadRecordBatchesFromMappedFile(const std::string &file_name,
+                                     std::vector<std::shared_ptr<arrow::RecordBatch>> *out,
+                                     const FileReadOptions &options) {
+  arrow::Result<std::shared_ptr<arrow::io::MemoryMappedFile>>
+      result = arrow::io::MemoryMappedFile::Open(file_name, arrow::io::FileMode::READ);
+  if (!result.ok()) {
+    FLETCHER_LOG(ERROR,
+                 "Could not map file for reading: " + file_name + " ARROW:["
+                     + result.status().ToString() + "]");
+    return false;
+  }
+  std::shared_ptr<arrow::io::MemoryMappedFile> file = result.ValueOrDie();
+
+  // The buffers are typically consumed from front to back, e.g. when they are transferred to the device, so advise
+  // the kernel to read ahead aggressively. Reading from a memory-mapped file returns a view on the mapping.
+  auto size = file->GetSize();
+  if (size.ok() && (size.ValueOrDie() > 0)) {
+    auto region = file->ReadAt(0, size.ValueOrDie());
+    if (region.ok()) {
+      auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+      auto begin = reinterpret_cast<uintptr_t>(region.ValueOrDie()->data());
+      auto aligned = begin / page * page;
+      posix_madvise(reinterpret_cast<void *>(aligned), region.ValueOrDie()->size() + (begin - aligned),
+                    POSIX_MADV_SEQUENTIAL);
+    }
+  }
+  return ReadRecordBatches(file, out, options);
+}
+
 std::string ToString(const std::vector<std::string> &strvec, const std::string &sep) {
   std::string result;
   for (const auto &s : strvec) {
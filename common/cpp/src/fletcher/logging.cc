@@ -0,0 +1,192 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/logging.h"
+
+#ifndef FLETCHER_USE_ARROW_LOGGING
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fletcher {
+
+/// The number of buffered bytes from which the background thread is woken up to write them.
+static constexpr size_t kLogFileBlockSize = 64 * 1024;
+/// The number of buffered bytes from which logging threads wait for the background thread.
+static constexpr size_t kLogFileMaxPending = 64 * 1024 * 1024;
+/// The interval at which the background thread writes buffered messages, regardless of their size.
+static constexpr std::chrono::milliseconds kLogFileInterval(100);
+
+/// A log file that is written by a background thread.
+class AsyncLogFile {
+ public:
+  explicit AsyncLogFile(const std::string &file_name) : file_(file_name, std::ios::out | std::ios::trunc) {
+    if (file_.good()) {
+      thread_ = std::thread([this]() { Run(); });
+    }
+  }
+
+  ~AsyncLogFile() {
+    if (thread_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wake_.notify_one();
+      thread_.join();
+    }
+    file_.flush();
+  }
+
+  bool good() const { return thread_.joinable(); }
+
+  void Append(const std::string &line) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Apply back pressure if the file can't keep up, rather than buffering without bounds.
+    space_.wait(lock, [this]() { return pending_.size() < kLogFileMaxPending; });
+    pending_ += line;
+    if (pending_.size() >= kLogFileBlockSize) {
+      wake_.notify_one();
+    }
+  }
+
+  /// @brief Wait until all messages appended so far are written to the file.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto ticket = ++flush_requested_;
+    wake_.notify_one();
+    space_.wait(lock, [this, ticket]() { return flushed_ >= ticket; });
+  }
+
+ private:
+  void Run() {
+    std::string block;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait_for(lock, kLogFileInterval, [this]() {
+        return stop_ || (flush_requested_ != flushed_) || (pending_.size() >= kLogFileBlockSize);
+      });
+      block.swap(pending_);
+      auto stop = stop_;
+      // All messages appended before this flush request are in the block.
+      auto flush = flush_requested_;
+      lock.unlock();
+      file_.write(block.data(), static_cast<std::streamsize>(block.size()));
+      if (stop || (flush != flushed_)) {
+        file_.flush();
+      }
+      block.clear();
+      lock.lock();
+      flushed_ = flush;
+      space_.notify_all();
+      if (stop && pending_.empty()) {
+        return;
+      }
+    }
+  }
+
+  std::ofstream file_;
+  std::thread thread_;
+  std::mutex mutex_;
+  /// Signals the background thread.
+  std::condition_variable wake_;
+  /// Signals logging threads that the buffer was written.
+  std::condition_variable space_;
+  std::string pending_;
+  /// The number of flushes requested, and the number of those that completed.
+  uint64_t flush_requested_ = 0;
+  uint64_t flushed_ = 0;
+  bool stop_ = false;
+};
+
+static std::atomic<int> log_level(FLETCHER_LOG_DEFAULT_LEVEL);
+/// Serializes writes to stdout, and guards the log file.
+static std::mutex log_mutex;
+static std::shared_ptr<AsyncLogFile> log_file;
+
+void SetLogLevel(LogLevel level) {
+  log_level.store(level, std::memory_order_relaxed);
+}
+
+LogLevel GetLogLevel() {
+  return log_level.load(std::memory_order_relaxed);
+}
+
+bool LogEnabled(LogLevel level) {
+  return (level > FLETCHER_LOG_WARNING) || (level >= log_level.load(std::memory_order_relaxed));
+}
+
+void LogMessage(LogLevel level, const std::string &message) {
+  std::string line = "[" + level2str(level) + "]: " + message + "\n";
+  std::shared_ptr<AsyncLogFile> file;
+  {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    file = log_file;
+    if (file == nullptr) {
+      if (level > FLETCHER_LOG_WARNING) {
+        std::cout.flush();
+        std::cerr << line;
+        std::cerr.flush();
+      } else {
+        std::cout << line;
+      }
+      return;
+    }
+  }
+  file->Append(line);
+  if (level > FLETCHER_LOG_WARNING) {
+    // The program is about to exit, so make sure the error ends up in the file and is shown.
+    file->Flush();
+    std::cerr << line;
+    std::cerr.flush();
+  }
+}
+
+bool StartLogFile(const std::string &file_name) {
+  auto file = std::make_shared<AsyncLogFile>(file_name);
+  if (!file->good()) {
+    return false;
+  }
+  std::shared_ptr<AsyncLogFile> previous;
+  {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    previous = log_file;
+    log_file = file;
+  }
+  // The previous file, if any, is written and closed when the last logging thread is done with it.
+  return true;
+}
+
+void StopLogFile() {
+  std::shared_ptr<AsyncLogFile> file;
+  {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    file.swap(log_file);
+  }
+  if (file != nullptr) {
+    file->Flush();
+  }
+}
+
+}  // namespace fletcher
+
+#endif
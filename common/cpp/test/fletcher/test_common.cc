@@ -15,9 +15,14 @@
 #include <gtest/gtest.h>
 #include <fletcher/common.h>
 #include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <arrow/ipc/api.h>
+#include <arrow/util/compression.h>
 
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <fstream>
 
 #include "fletcher/test_schemas.h"
 #include "fletcher/test_recordbatches.h"
@@ -33,6 +38,41 @@ TEST(Common, AppendMetaRequired) {
   ASSERT_EQ(map.at("fletcher_mode"), "read");
 }
 
+TEST(Common, Options) {
+  auto schema = fletcher::GetPrimReadSchema();
+  auto schema_options = fletcher::GetSchemaOptions(*schema);
+  ASSERT_EQ(schema_options.name, "PrimRead");
+  ASSERT_EQ(schema_options.mode, fletcher::Mode::READ);
+
+  auto field = arrow::field("x", arrow::utf8())->WithMetadata(
+      arrow::key_value_metadata({"fletcher_epc", "fletcher_lepc", "fletcher_profile"}, {"4", "2", "true"}));
+  auto options = fletcher::GetFieldOptions(*field);
+  ASSERT_EQ(options.epc, 4);
+  ASSERT_EQ(options.lepc, 2);
+  ASSERT_TRUE(options.profile);
+  ASSERT_FALSE(options.ignore);
+  // Fields without metadata have the default options.
+  ASSERT_EQ(fletcher::GetFieldOptions(*arrow::field("y", arrow::int8())).epc, 1);
+
+  // Invalid values are rejected by parsing, and replaced with their default by the cached accessor.
+  auto invalid = arrow::field("z", arrow::int8())->WithMetadata(
+      arrow::key_value_metadata({"fletcher_epc", "fletcher_tag_width"}, {"4x", "3"}));
+  fletcher::FieldOptions parsed;
+  std::string error;
+  ASSERT_FALSE(fletcher::FieldOptions::Parse(*invalid, &parsed, &error));
+  ASSERT_NE(error.find("fletcher_epc"), std::string::npos);
+  ASSERT_EQ(parsed.epc, 1);
+  ASSERT_EQ(parsed.tag_width, 3);
+  ASSERT_EQ(fletcher::GetFieldOptions(*invalid).epc, 1);
+
+  // Validation covers nested fields and the schema itself.
+  auto nested = arrow::schema({arrow::field("s", arrow::struct_({invalid}))});
+  ASSERT_TRUE(fletcher::ValidateOptions(*schema));
+  ASSERT_FALSE(fletcher::ValidateOptions(*nested, &error));
+  auto wrong_mode = schema->WithMetadata(arrow::key_value_metadata({"fletcher_mode"}, {"Write"}));
+  ASSERT_FALSE(fletcher::ValidateOptions(*wrong_mode));
+}
+
 TEST(Common, RecordBatchFileRoundTrip) {
   auto rb_out = fletcher::GetStringRB();
   std::vector<std::shared_ptr<arrow::RecordBatch>> rbs_in;
@@ -42,6 +82,133 @@ TEST(Common, RecordBatchFileRoundTrip) {
   ASSERT_TRUE(rb_out->Equals(*rbs_in[0]));
 }
 
+/// @brief Return true if an address lies within a memory mapping of a file, according to /proc/self/maps.
+static bool IsInFileMapping(const void *address, const std::string &file_name) {
+  auto addr = reinterpret_cast<uintptr_t>(address);
+  std::ifstream maps("/proc/self/maps");
+  std::string line;
+  while (std::getline(maps, line)) {
+    // Lines are formatted as: <begin>-<end> <perms> <offset> <dev> <inode> <path>
+    if ((line.size() < file_name.size())
+        || (line.compare(line.size() - file_name.size(), file_name.size(), file_name) != 0)) {
+      continue;
+    }
+    auto dash = line.find('-');
+    auto begin = std::stoull(line.substr(0, dash), nullptr, 16);
+    auto end = std::stoull(line.substr(dash + 1), nullptr, 16);
+    if ((addr >= begin) && (addr < end)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TEST(Common, RecordBatchMappedFile) {
+  auto rb_out = fletcher::GetStringRB();
+  std::vector<std::shared_ptr<arrow::RecordBatch>> rbs_in;
+  fletcher::WriteRecordBatchesToFile("test-common-mapped.rb", {rb_out});
+  ASSERT_TRUE(fletcher::ReadRecordBatchesFromMappedFile("test-common-mapped.rb", &rbs_in));
+  ASSERT_TRUE(rb_out->Equals(*rbs_in[0]));
+  // The buffers must not be owned by the heap, but reference the mapping.
+  ASSERT_TRUE(IsInFileMapping(rbs_in[0]->column(0)->data()->buffers[2]->data(), "/test-common-mapped.rb"));
+}
+
+TEST(Common, RecordBatchCompressedFile) {
+  if (!arrow::util::Codec::IsAvailable(arrow::Compression::LZ4_FRAME)) {
+    GTEST_SKIP() << "Arrow was built without LZ4 support.";
+  }
+  auto rb_out = fletcher::GetStringRB();
+  auto write_options = arrow::ipc::IpcWriteOptions::Defaults();
+  write_options.codec = arrow::util::Codec::Create(arrow::Compression::LZ4_FRAME).ValueOrDie();
+  auto file = arrow::io::FileOutputStream::Open("test-common-lz4.rb").ValueOrDie();
+  auto writer = arrow::ipc::MakeFileWriter(file.get(), rb_out->schema(), write_options).ValueOrDie();
+  ASSERT_TRUE(writer->WriteRecordBatch(*rb_out).ok());
+  ASSERT_TRUE(writer->Close().ok());
+  ASSERT_TRUE(file->Close().ok());
+
+  // Decompressed buffers must be allocated from the supplied pool, and be aligned for the device.
+  arrow::ProxyMemoryPool pool(arrow::default_memory_pool());
+  fletcher::FileReadOptions options;
+  options.memory_pool = &pool;
+  std::vector<std::shared_ptr<arrow::RecordBatch>> rbs_in;
+  ASSERT_TRUE(fletcher::ReadRecordBatchesFromFile("test-common-lz4.rb", &rbs_in, options));
+  ASSERT_TRUE(rb_out->Equals(*rbs_in[0]));
+  ASSERT_GT(pool.bytes_allocated(), 0);
+  for (const auto &buffer : rbs_in[0]->column(0)->data()->buffers) {
+    if (buffer != nullptr) {
+      ASSERT_EQ(reinterpret_cast<uintptr_t>(buffer->data()) % 64, 0);
+    }
+  }
+}
+
+TEST(Common, RecordBatchFileAlignment) {
+  auto rb_out = fletcher::GetStringRB();
+  for (int64_t alignment : {64, 4096}) {
+    fletcher::FileWriteOptions options;
+    options.alignment = alignment;
+    fletcher::WriteRecordBatchesToFile("test-common-aligned.rb", {rb_out, rb_out->Slice(1)}, options);
+    std::vector<std::shared_ptr<arrow::RecordBatch>> rbs_in;
+    ASSERT_TRUE(fletcher::ReadRecordBatchesFromMappedFile("test-common-aligned.rb", &rbs_in));
+    ASSERT_EQ(rbs_in.size(), 2);
+    ASSERT_TRUE(rb_out->Equals(*rbs_in[0]));
+    ASSERT_TRUE(rb_out->Slice(1)->Equals(*rbs_in[1]));
+    // Mappings start at page boundaries, so every buffer is aligned in memory as well.
+    for (const auto &rb : rbs_in) {
+      for (const auto &buffer : rb->column(0)->data()->buffers) {
+        if (buffer != nullptr) {
+          ASSERT_EQ(reinterpret_cast<uintptr_t>(buffer->data()) % alignment, 0);
+        }
+      }
+    }
+  }
+  if (arrow::util::Codec::IsAvailable(arrow::Compression::LZ4_FRAME)) {
+    fletcher::FileWriteOptions options;
+    options.compression = arrow::Compression::LZ4_FRAME;
+    fletcher::WriteRecordBatchesToFile("test-common-aligned.rb", {rb_out, rb_out}, options);
+    std::vector<std::shared_ptr<arrow::RecordBatch>> rbs_in;
+    ASSERT_TRUE(fletcher::ReadRecordBatchesFromFile("test-common-aligned.rb", &rbs_in));
+    ASSERT_EQ(rbs_in.size(), 2);
+    ASSERT_TRUE(rb_out->Equals(*rbs_in[1]));
+  }
+}
+
+TEST(Common, PrefetchingRecordBatchReader) {
+  auto rb = fletcher::GetStringRB();
+  std::vector<std::shared_ptr<arrow::RecordBatch>> rbs_out = {rb, rb->Slice(1), rb->Slice(2), rb};
+  fletcher::WriteRecordBatchesToFile("test-common-prefetch.rb", rbs_out);
+
+  // Write the same RecordBatches in the stream format.
+  auto file = arrow::io::FileOutputStream::Open("test-common-prefetch-stream.rb").ValueOrDie();
+  auto writer = arrow::ipc::MakeStreamWriter(file.get(), rb->schema()).ValueOrDie();
+  for (const auto &r : rbs_out) {
+    ASSERT_TRUE(writer->WriteRecordBatch(*r).ok());
+  }
+  ASSERT_TRUE(writer->Close().ok());
+  ASSERT_TRUE(file->Close().ok());
+
+  fletcher::PrefetchOptions options;
+  options.max_batches = 1;
+  for (const auto &path : {"test-common-prefetch.rb", "test-common-prefetch-stream.rb"}) {
+    std::shared_ptr<fletcher::PrefetchingRecordBatchReader> reader;
+    ASSERT_TRUE(fletcher::PrefetchingRecordBatchReader::Open(path, &reader, options));
+    ASSERT_TRUE(reader->schema()->Equals(*rb->schema()));
+    std::shared_ptr<arrow::RecordBatch> rb_in;
+    for (const auto &r : rbs_out) {
+      ASSERT_TRUE(reader->ReadNext(&rb_in).ok());
+      ASSERT_NE(rb_in, nullptr);
+      ASSERT_TRUE(r->Equals(*rb_in));
+    }
+    ASSERT_TRUE(reader->ReadNext(&rb_in).ok());
+    ASSERT_EQ(rb_in, nullptr);
+    ASSERT_EQ(reader->bytes_prefetched(), 0);
+  }
+
+  // Destructing a reader that is still reading ahead must not block.
+  std::shared_ptr<fletcher::PrefetchingRecordBatchReader> reader;
+  ASSERT_TRUE(fletcher::PrefetchingRecordBatchReader::Open("test-common-prefetch.rb", &reader));
+  reader.reset();
+}
+
 TEST(Common, HexView) {
   fletcher::HexView hv0(0, 8);
   fletcher::HexView hv1(3, 16);
@@ -54,3 +221,37 @@ TEST(Common, HexView) {
   // Test without header and offset
   ASSERT_EQ(hv1.ToString(false), "0000000000000000          01 02 03 04                               ....         ");
 }
+
+TEST(Common, Logging) {
+  auto level = fletcher::GetLogLevel();
+  int formatted = 0;
+  auto message = [&formatted]() {
+    formatted++;
+    return std::string("formatted");
+  };
+
+  // Messages of disabled levels are not formatted.
+  fletcher::SetLogLevel(FLETCHER_LOG_WARNING);
+  FLETCHER_LOG(DEBUG, message());
+  FLETCHER_LOG(INFO, message());
+  ASSERT_EQ(formatted, 0);
+
+  // Messages can be logged to a file in the background.
+  ASSERT_TRUE(fletcher::StartLogFile("test-common.log"));
+  fletcher::SetLogLevel(FLETCHER_LOG_DEBUG);
+  for (int i = 0; i < 1000; i++) {
+    FLETCHER_LOG(DEBUG, "line " << i << " " << message());
+  }
+  fletcher::StopLogFile();
+  fletcher::SetLogLevel(level);
+  ASSERT_EQ(formatted, 1000);
+
+  std::ifstream file("test-common.log");
+  std::string line;
+  int lines = 0;
+  while (std::getline(file, line)) {
+    ASSERT_EQ(line, "[DEBUG]: line " + std::to_string(lines) + " formatted");
+    lines++;
+  }
+  ASSERT_EQ(lines, 1000);
+}
@@ -16,6 +16,7 @@
 #include <fletcher/common.h>
 #include <arrow/api.h>
 #include <vector>
+#include <cstring>
 #include <string>
 #include <iostream>
 
@@ -98,6 +99,372 @@ TEST(RecordBatchAnalyzer, VisitStruct) {
   ASSERT_EQ(rbd.fields[0].buffers[1].size_, 4 * sizeof(uint32_t));
 }
 
+TEST(RecordBatchAnalyzer, VisitSlicedPrimitive) {
+  auto rb = fletcher::GetIntRB()->Slice(1, 2);
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  rba.Analyze(*rb);
+  ASSERT_EQ(rbd.rows, 2);
+  ASSERT_EQ(rbd.fields[0].length, 2);
+  ASSERT_EQ(rbd.fields[0].buffers[0].size_, 2);
+  auto values = std::static_pointer_cast<arrow::Int8Array>(rb->column(0));
+  ASSERT_EQ(rbd.fields[0].buffers[0].raw_buffer_, reinterpret_cast<const uint8_t *>(values->raw_values()));
+}
+
+TEST(RecordBatchAnalyzer, VisitSlicedString) {
+  // David, Eve, Frank, Grace, Harry
+  auto rb = fletcher::GetStringRB()->Slice(3, 5);
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  rba.Analyze(*rb);
+  ASSERT_EQ(rbd.rows, 5);
+  ASSERT_EQ(rbd.fields[0].buffers[0].size_, 6 * sizeof(int32_t));
+  ASSERT_EQ(rbd.fields[0].buffers[1].size_, 23);
+  // Offsets must be rebased to start at zero.
+  auto offsets = reinterpret_cast<const int32_t *>(rbd.fields[0].buffers[0].raw_buffer_);
+  ASSERT_EQ(std::vector<int32_t>(offsets, offsets + 6), std::vector<int32_t>({0, 5, 8, 13, 18, 23}));
+  // Values must start at the first character of the slice.
+  auto values = reinterpret_cast<const char *>(rbd.fields[0].buffers[1].raw_buffer_);
+  ASSERT_EQ(std::string(values, 23), "DavidEveFrankGraceHarry");
+}
+
+TEST(RecordBatchAnalyzer, VisitSlicedList) {
+  // {3, 1, 4, 1, 5, 9, 2}, {4, 2}
+  auto rb = fletcher::GetListUint8RB()->Slice(1, 2);
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  rba.Analyze(*rb);
+  ASSERT_EQ(rbd.fields[0].buffers[0].size_, 3 * sizeof(int32_t));
+  auto offsets = reinterpret_cast<const int32_t *>(rbd.fields[0].buffers[0].raw_buffer_);
+  ASSERT_EQ(std::vector<int32_t>(offsets, offsets + 3), std::vector<int32_t>({0, 7, 9}));
+  ASSERT_EQ(rbd.fields[0].buffers[1].size_, 9);
+  ASSERT_EQ(rbd.fields[0].buffers[1].raw_buffer_[0], 3);
+  ASSERT_EQ(rbd.fields[0].buffers[1].raw_buffer_[8], 2);
+}
+
+TEST(RecordBatchAnalyzer, VisitSlicedLargeOffsets) {
+  arrow::LargeStringBuilder str_builder;
+  ASSERT_TRUE(str_builder.AppendValues({"Alice", "Bob", "Carol", "David"}).ok());
+  std::shared_ptr<arrow::Array> str_array;
+  ASSERT_TRUE(str_builder.Finish(&str_array).ok());
+  auto value_builder = std::make_shared<arrow::UInt8Builder>();
+  arrow::LargeListBuilder list_builder(arrow::default_memory_pool(), value_builder);
+  for (const auto &list : std::vector<std::vector<uint8_t>>({{1, 2}, {3}, {4, 5, 6}, {7}})) {
+    ASSERT_TRUE(list_builder.Append().ok());
+    ASSERT_TRUE(value_builder->AppendValues(list).ok());
+  }
+  std::shared_ptr<arrow::Array> list_array;
+  ASSERT_TRUE(list_builder.Finish(&list_array).ok());
+  auto schema = arrow::schema({arrow::field("name", arrow::large_utf8(), false),
+                               arrow::field("list", arrow::large_list(arrow::field("item", arrow::uint8(), false)),
+                                            false)});
+  auto rb = arrow::RecordBatch::Make(schema, 4, {str_array, list_array})->Slice(1, 2);
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  ASSERT_TRUE(rba.Analyze(*rb));
+  // Offsets are 64 bits wide, and rebased to start at zero.
+  ASSERT_EQ(rbd.fields[0].buffers[0].size_, 3 * sizeof(int64_t));
+  auto str_offsets = reinterpret_cast<const int64_t *>(rbd.fields[0].buffers[0].raw_buffer_);
+  ASSERT_EQ(std::vector<int64_t>(str_offsets, str_offsets + 3), std::vector<int64_t>({0, 3, 8}));
+  ASSERT_EQ(std::string(reinterpret_cast<const char *>(rbd.fields[0].buffers[1].raw_buffer_),
+                        rbd.fields[0].buffers[1].size_), "BobCarol");
+  ASSERT_EQ(rbd.fields[1].buffers[0].size_, 3 * sizeof(int64_t));
+  auto list_offsets = reinterpret_cast<const int64_t *>(rbd.fields[1].buffers[0].raw_buffer_);
+  ASSERT_EQ(std::vector<int64_t>(list_offsets, list_offsets + 3), std::vector<int64_t>({0, 1, 4}));
+  ASSERT_EQ(rbd.fields[1].buffers[1].size_, 4);
+  ASSERT_EQ(rbd.fields[1].buffers[1].raw_buffer_[0], 3);
+
+  // The schema analyzer expects the same buffers.
+  fletcher::FieldMetadata field_meta;
+  fletcher::FieldAnalyzer fa(&field_meta);
+  fa.Analyze(*schema->field(1));
+  ASSERT_EQ(field_meta.buffers.size(), 2);
+}
+
+TEST(RecordBatchAnalyzer, VisitSlicedFixedSizeList) {
+  auto value_builder = std::make_shared<arrow::FloatBuilder>();
+  arrow::FixedSizeListBuilder builder(arrow::default_memory_pool(), value_builder, 4);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(builder.Append().ok());
+    ASSERT_TRUE(value_builder->AppendValues({1.0f * i, 2.0f * i, 3.0f * i, 4.0f * i}).ok());
+  }
+  std::shared_ptr<arrow::Array> array;
+  ASSERT_TRUE(builder.Finish(&array).ok());
+  auto type = arrow::fixed_size_list(arrow::field("item", arrow::float32(), false), 4);
+  auto schema = arrow::schema({arrow::field("vec", type, false)});
+  auto rb = arrow::RecordBatch::Make(schema, 4, {array})->Slice(2, 2);
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  ASSERT_TRUE(rba.Analyze(*rb));
+  // There is no offsets buffer, only the values of the rows in the slice.
+  ASSERT_EQ(rbd.fields[0].buffers.size(), 1);
+  ASSERT_EQ(rbd.fields[0].buffers[0].size_, 2 * 4 * sizeof(float));
+  auto values = reinterpret_cast<const float *>(rbd.fields[0].buffers[0].raw_buffer_);
+  ASSERT_EQ(values[0], 2.0f);
+  ASSERT_EQ(values[7], 12.0f);
+
+  fletcher::FieldMetadata field_meta;
+  fletcher::FieldAnalyzer fa(&field_meta);
+  fa.Analyze(*schema->field(0));
+  ASSERT_EQ(field_meta.buffers.size(), 1);
+}
+
+TEST(RecordBatchAnalyzer, VisitSlicedValidity) {
+  arrow::UInt8Builder builder;
+  std::vector<uint8_t> values(20);
+  std::vector<bool> valid(20, true);
+  valid[11] = false;
+  ASSERT_TRUE(builder.AppendValues(values, valid).ok());
+  std::shared_ptr<arrow::Array> array;
+  ASSERT_TRUE(builder.Finish(&array).ok());
+  auto schema = arrow::schema({arrow::field("x", arrow::uint8(), true)});
+  // Slice at a bit offset that is not byte aligned.
+  auto rb = arrow::RecordBatch::Make(schema, 20, {array})->Slice(9, 10);
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  rba.Analyze(*rb);
+  ASSERT_EQ(rbd.fields[0].buffers[0].desc_, vs({"x", "validity"}));
+  ASSERT_FALSE(rbd.fields[0].buffers[0].implicit_);
+  ASSERT_EQ(rbd.fields[0].buffers[0].size_, 2);
+  // Bit 2 of the realigned bitmap corresponds to element 11 of the original array.
+  ASSERT_EQ(rbd.fields[0].buffers[0].raw_buffer_[0], 0xFB);
+  ASSERT_EQ(rbd.fields[0].buffers[0].raw_buffer_[1] & 0x03, 0x03);
+  ASSERT_EQ(rbd.fields[0].buffers[1].size_, 10);
+}
+
+TEST(RecordBatchAnalyzer, VisitSlicedBoolean) {
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("flag", arrow::boolean(), false)}),
+                                           "BoolRead",
+                                           fletcher::Mode::READ);
+  arrow::BooleanBuilder builder;
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(builder.Append(i % 3 == 0).ok());
+  }
+  auto rb = arrow::RecordBatch::Make(schema, 20, {builder.Finish().ValueOrDie()})->Slice(3, 12);
+
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  ASSERT_TRUE(rba.Analyze(*rb));
+  ASSERT_EQ(rbd.fields[0].buffers.size(), 1);
+  ASSERT_EQ(rbd.fields[0].buffers[0].desc_, vs({"flag", "values"}));
+  // The values stay bit-packed, realigned to start at element 3 of the original array.
+  ASSERT_EQ(rbd.fields[0].buffers[0].size_, 2);
+  ASSERT_EQ(rbd.fields[0].buffers[0].raw_buffer_[0], 0x49);
+  ASSERT_EQ(rbd.fields[0].buffers[0].raw_buffer_[1] & 0x0F, 0x02);
+
+  fletcher::RecordBatchDescription virtual_rbd;
+  fletcher::SchemaAnalyzer sa(&virtual_rbd);
+  ASSERT_TRUE(sa.Analyze(*schema));
+  ASSERT_EQ(virtual_rbd.fields[0].buffers.size(), 1);
+  ASSERT_EQ(virtual_rbd.fields[0].buffers[0].desc_, vs({"flag", "values"}));
+}
+
+TEST(RecordBatchAnalyzer, Projection) {
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::int8(), false),
+                                                           fletcher::WithMetaIgnore(*arrow::field("b", arrow::utf8())),
+                                                           arrow::field("c", arrow::int32(), false)}),
+                                           "Wide",
+                                           fletcher::Mode::READ);
+  arrow::Int8Builder a;
+  arrow::StringBuilder b;
+  arrow::Int32Builder c;
+  ASSERT_TRUE(a.AppendValues({1, 2, 3}).ok());
+  ASSERT_TRUE(b.AppendValues({"x", "y", "z"}).ok());
+  ASSERT_TRUE(c.AppendValues({4, 5, 6}).ok());
+  auto rb = arrow::RecordBatch::Make(schema, 3, {a.Finish().ValueOrDie(), b.Finish().ValueOrDie(),
+                                                 c.Finish().ValueOrDie()});
+
+  // Ignored fields are skipped.
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  ASSERT_TRUE(rba.Analyze(*rb));
+  ASSERT_EQ(rbd.fields.size(), 2);
+  ASSERT_EQ(rbd.fields[0].column, 0);
+  ASSERT_EQ(rbd.fields[1].column, 2);
+  ASSERT_EQ(rbd.fields[1].buffers[0].desc_, vs({"c", "values"}));
+
+  // Only the fields of a kernel schema are described, in its order.
+  auto kernel_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("c", arrow::int32(), false),
+                                                                  arrow::field("b", arrow::utf8())}),
+                                                  "Narrow",
+                                                  fletcher::Mode::READ);
+  fletcher::RecordBatchDescription projected;
+  fletcher::RecordBatchAnalyzer pra(&projected);
+  ASSERT_TRUE(pra.Analyze(*rb, *kernel_schema));
+  ASSERT_EQ(projected.name, "Narrow");
+  ASSERT_EQ(projected.fields.size(), 2);
+  ASSERT_EQ(projected.fields[0].column, 2);
+  ASSERT_EQ(projected.fields[1].column, 1);
+  ASSERT_EQ(projected.fields[1].buffers.size(), 3);
+  ASSERT_EQ(projected.fields[1].buffers[1].desc_, vs({"b", "offsets"}));
+
+  // The kernel schema must match the RecordBatch.
+  auto wrong_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("c", arrow::int64(), false)}),
+                                                 "Wrong",
+                                                 fletcher::Mode::READ);
+  fletcher::RecordBatchDescription wrong;
+  fletcher::RecordBatchAnalyzer wra(&wrong);
+  ASSERT_FALSE(wra.Analyze(*rb, *wrong_schema));
+}
+
+TEST(RecordBatchAnalyzer, VisitDictionary) {
+  auto type = arrow::dictionary(arrow::int8(), arrow::utf8());
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("Category", type)}),
+                                           "DictRead",
+                                           fletcher::Mode::READ);
+  arrow::Int8Builder indices;
+  ASSERT_TRUE(indices.AppendValues({1, 0, 2, 1, 1, 0}).ok());
+  ASSERT_TRUE(indices.AppendNull().ok());
+  arrow::StringBuilder dictionary;
+  ASSERT_TRUE(dictionary.AppendValues({"apple", "banana", "cherry"}).ok());
+  auto array = arrow::DictionaryArray::FromArrays(type,
+                                                  indices.Finish().ValueOrDie(),
+                                                  dictionary.Finish().ValueOrDie()).ValueOrDie();
+  auto rb = arrow::RecordBatch::Make(schema, 7, {array})->Slice(2);
+
+  fletcher::RecordBatchDescription rbd;
+  fletcher::RecordBatchAnalyzer rba(&rbd);
+  ASSERT_TRUE(rba.Analyze(*rb));
+  ASSERT_EQ(rbd.fields.size(), 2);
+  // The indices of the sliced column, with its validity bitmap.
+  ASSERT_TRUE(rbd.fields[0].type_->Equals(type));
+  ASSERT_FALSE(rbd.fields[0].dictionary);
+  ASSERT_EQ(rbd.fields[0].buffers.size(), 2);
+  ASSERT_EQ(rbd.fields[0].buffers[0].desc_, vs({"Category", "validity"}));
+  ASSERT_EQ(rbd.fields[0].buffers[1].desc_, vs({"Category", "values"}));
+  ASSERT_EQ(rbd.fields[0].buffers[1].size_, 5);
+  ASSERT_EQ(rbd.fields[0].buffers[1].raw_buffer_[0], 2);
+  // The whole dictionary.
+  ASSERT_TRUE(rbd.fields[1].type_->Equals(arrow::utf8()));
+  ASSERT_TRUE(rbd.fields[1].dictionary);
+  ASSERT_EQ(rbd.fields[1].column, 0);
+  ASSERT_EQ(rbd.fields[1].length, 3);
+  ASSERT_EQ(rbd.fields[1].buffers.size(), 2);
+  ASSERT_EQ(rbd.fields[1].buffers[0].desc_, vs({"Category_dictionary", "offsets"}));
+  ASSERT_EQ(rbd.fields[1].buffers[1].desc_, vs({"Category_dictionary", "values"}));
+  ASSERT_EQ(rbd.fields[1].buffers[1].size_, 17);
+
+  // A schema is described with the same buffers.
+  fletcher::RecordBatchDescription virtual_rbd;
+  fletcher::SchemaAnalyzer sa(&virtual_rbd);
+  ASSERT_TRUE(sa.Analyze(*schema));
+  ASSERT_EQ(virtual_rbd.fields.size(), 2);
+  for (size_t f = 0; f < 2; f++) {
+    ASSERT_EQ(virtual_rbd.fields[f].dictionary, rbd.fields[f].dictionary);
+    ASSERT_EQ(virtual_rbd.fields[f].buffers.size(), rbd.fields[f].buffers.size());
+    for (size_t b = 0; b < rbd.fields[f].buffers.size(); b++) {
+      ASSERT_EQ(virtual_rbd.fields[f].buffers[b].desc_, rbd.fields[f].buffers[b].desc_);
+    }
+  }
+}
+
+/// @brief Assert that the buffer layout extracts the same buffers from a RecordBatch as the RecordBatchAnalyzer.
+static void AssertLayoutMatchesAnalyzer(const arrow::RecordBatch &rb, const arrow::Schema *kernel_schema = nullptr) {
+  fletcher::RecordBatchDescription expected;
+  fletcher::RecordBatchAnalyzer rba(&expected);
+  ASSERT_TRUE(kernel_schema == nullptr ? rba.Analyze(rb) : rba.Analyze(rb, *kernel_schema));
+
+  std::shared_ptr<fletcher::BufferLayout> layout;
+  ASSERT_TRUE(fletcher::BufferLayout::Make(*rb.schema(), kernel_schema, &layout));
+  std::vector<fletcher::BufferRef> buffers;
+  ASSERT_TRUE(layout->Extract(rb, &buffers));
+  ASSERT_EQ(buffers.size(), layout->num_buffers());
+  auto actual = layout->Describe(rb, buffers);
+
+  ASSERT_EQ(actual.name, expected.name);
+  ASSERT_EQ(actual.mode, expected.mode);
+  ASSERT_EQ(actual.fields.size(), expected.fields.size());
+  for (size_t f = 0; f < expected.fields.size(); f++) {
+    const auto &af = actual.fields[f];
+    const auto &ef = expected.fields[f];
+    ASSERT_EQ(af.column, ef.column);
+    ASSERT_EQ(af.dictionary, ef.dictionary);
+    ASSERT_EQ(af.length, ef.length);
+    ASSERT_EQ(af.buffers.size(), ef.buffers.size());
+    for (size_t b = 0; b < ef.buffers.size(); b++) {
+      const auto &ab = af.buffers[b];
+      const auto &eb = ef.buffers[b];
+      ASSERT_EQ(ab.desc_, eb.desc_);
+      ASSERT_EQ(ab.implicit_, eb.implicit_);
+      ASSERT_EQ(ab.size_, eb.size_);
+      if (ab.size_ > 0) {
+        // Rebased offsets and realigned bitmaps are copies, so compare their contents.
+        ASSERT_EQ(std::memcmp(ab.raw_buffer_, eb.raw_buffer_, ab.size_), 0) << fletcher::ToString(eb.desc_);
+      }
+      ASSERT_EQ(ab.owner_ == nullptr, eb.owner_ == nullptr);
+      if (eb.owner_ == nullptr) {
+        ASSERT_EQ(ab.raw_buffer_, eb.raw_buffer_);
+      }
+    }
+  }
+}
+
+TEST(BufferLayout, MatchesAnalyzer) {
+  std::vector<std::shared_ptr<arrow::RecordBatch>> batches = {fletcher::GetStringRB(), fletcher::GetListUint8RB(),
+                                                              fletcher::GetStructRB(), fletcher::GetInt64ListWideRB(),
+                                                              fletcher::GetFilterRB()};
+  for (const auto &rb : batches) {
+    AssertLayoutMatchesAnalyzer(*rb);
+    // Slices start with rebased offsets and realigned bitmaps.
+    AssertLayoutMatchesAnalyzer(*rb->Slice(1, rb->num_rows() - 2));
+  }
+
+  // Nullable fields, with and without nulls in the slice.
+  arrow::StringBuilder builder;
+  ASSERT_TRUE(builder.AppendValues({"a", "bb", "ccc", "dddd"}).ok());
+  ASSERT_TRUE(builder.AppendNull().ok());
+  ASSERT_TRUE(builder.AppendValues({"e", "ff", "ggg", "hhhh", "iiiii", "j", "kk"}).ok());
+  auto schema = arrow::schema({arrow::field("s", arrow::utf8(), true)});
+  auto rb = arrow::RecordBatch::Make(schema, 12, {builder.Finish().ValueOrDie()});
+  AssertLayoutMatchesAnalyzer(*rb);
+  AssertLayoutMatchesAnalyzer(*rb->Slice(3, 7));
+  AssertLayoutMatchesAnalyzer(*rb->Slice(5));
+
+  // Dictionary-encoded columns, projected on a kernel schema.
+  auto type = arrow::dictionary(arrow::int8(), arrow::utf8());
+  arrow::Int8Builder indices;
+  ASSERT_TRUE(indices.AppendValues({1, 0, 2, 1, 1, 0}).ok());
+  arrow::StringBuilder dictionary;
+  ASSERT_TRUE(dictionary.AppendValues({"apple", "banana", "cherry"}).ok());
+  auto dict_array = arrow::DictionaryArray::FromArrays(type,
+                                                       indices.Finish().ValueOrDie(),
+                                                       dictionary.Finish().ValueOrDie()).ValueOrDie();
+  auto wide = arrow::RecordBatch::Make(arrow::schema({arrow::field("s", arrow::utf8(), true),
+                                                      arrow::field("Category", type)}),
+                                       6, {rb->column(0)->Slice(0, 6), dict_array});
+  auto kernel_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("Category", type, false)}),
+                                                  "DictRead",
+                                                  fletcher::Mode::READ);
+  AssertLayoutMatchesAnalyzer(*wide->Slice(2), kernel_schema.get());
+
+  // The validity bitmaps of output RecordBatches are always passed to the kernel, even if they hold no nulls.
+  auto out_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), true)}),
+                                               "Out",
+                                               fletcher::Mode::WRITE);
+  std::shared_ptr<arrow::Buffer> values = arrow::AllocateBuffer(12 * sizeof(uint32_t)).ValueOrDie();
+  auto all_valid = arrow::AllocateBuffer(2).ValueOrDie();
+  std::memset(all_valid->mutable_data(), 0xFF, 2);
+  std::vector<std::shared_ptr<arrow::Buffer>> bitmaps = {std::move(all_valid), nullptr};
+  for (const auto &bitmap : bitmaps) {
+    auto out = arrow::RecordBatch::Make(out_schema, 12, {arrow::MakeArray(
+        arrow::ArrayData::Make(arrow::uint32(), 12, {bitmap, values}, arrow::kUnknownNullCount))});
+    AssertLayoutMatchesAnalyzer(*out);
+    std::shared_ptr<fletcher::BufferLayout> out_layout;
+    ASSERT_TRUE(fletcher::BufferLayout::Make(*out_schema, nullptr, &out_layout));
+    std::vector<fletcher::BufferRef> out_buffers;
+    ASSERT_TRUE(out_layout->Extract(*out, &out_buffers));
+    ASSERT_FALSE(out_buffers[0].implicit);
+    ASSERT_EQ(out_buffers[0].size, 2);
+    ASSERT_EQ(out_buffers[0].data[1], 0xFF);
+    ASSERT_EQ(out_buffers[0].owner == nullptr, bitmap != nullptr);
+  }
+
+  // Kernel schemas that don't match the RecordBatch are rejected when the layout is compiled.
+  auto wrong_schema = arrow::schema({arrow::field("s", arrow::int64(), false)});
+  std::shared_ptr<fletcher::BufferLayout> layout;
+  ASSERT_FALSE(fletcher::BufferLayout::Make(*rb->schema(), wrong_schema.get(), &layout));
+}
+
 // TypeVisitor tests
 TEST(SchemaAnalyzer, VisitPrimitive) {
   auto schema = fletcher::GetPrimReadSchema();
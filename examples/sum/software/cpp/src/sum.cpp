@@ -28,24 +28,18 @@ int main(int argc, char **argv) {
     return -1;
   }
 
-  std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+  std::shared_ptr<fletcher::PrefetchingRecordBatchReader> reader;
   std::shared_ptr<arrow::RecordBatch> number_batch;
 
-  // Attempt to read the RecordBatch from the supplied argument.
-  fletcher::ReadRecordBatchesFromFile(argv[1], &batches);
-
-  // RecordBatch should contain exactly one batch.
-  if (batches.size() != 1) {
-    std::cerr << "File did not contain any Arrow RecordBatches." << std::endl;
+  // Open the file. RecordBatches are read on a background thread, a few ahead of the kernel, so the first kernel can
+  // start as soon as the first RecordBatch is read, regardless of the size of the file.
+  if (!fletcher::PrefetchingRecordBatchReader::Open(argv[1], &reader)) {
+    std::cerr << "Could not open the Arrow RecordBatch file." << std::endl;
     return -1;
   }
 
-  // The only RecordBatch in the file is our RecordBatch with the numbers.
-  number_batch = batches[0];
-
   fletcher::Status status;
   std::shared_ptr<fletcher::Platform> platform;
-  std::shared_ptr<fletcher::Context> context;
 
   // Create a Fletcher platform object, attempting to autodetect the platform.
   status = fletcher::Platform::Make(&platform);
@@ -63,62 +57,88 @@ int main(int argc, char **argv) {
     return -1;
   }
 
-  // Create a context for our application on the platform.
-  status = fletcher::Context::Make(&context, platform);
-
-  if (!status.ok()) {
-    std::cerr << "Could not create Fletcher context." << std::endl;
-    return -1;
-  }
-
-  // Queue the recordbatch to our context.
-  status = context->QueueRecordBatch(number_batch);
-
-  if (!status.ok()) {
-    std::cerr << "Could not queue the RecordBatch to the context." << std::endl;
-    return -1;
-  }
-
-  // "Enable" the context, potentially copying the recordbatch to the device. This depends on your platform.
-  // AWS EC2 F1 requires a copy, but OpenPOWER SNAP doesn't.
-  status = context->Enable();
-
-  if (!status.ok()) {
-    std::cerr << "Could not enable the context." << std::endl;
-    return -1;
-  }
-
-  // Create a kernel based on the context.
-  fletcher::Kernel kernel(context);
-
-  // Start the kernel.
-  status = kernel.Start();
-
-  if (!status.ok()) {
-    std::cerr << "Could not start the kernel." << std::endl;
-    return -1;
+  int32_t sum = 0;
+  size_t num_batches = 0;
+
+  // Obtain the RecordBatches with the numbers one by one.
+  while (true) {
+    if (!reader->ReadNext(&number_batch).ok()) {
+      std::cerr << "Could not read a RecordBatch from the file." << std::endl;
+      return -1;
+    }
+    if (number_batch == nullptr) {
+      break;
+    }
+
+    std::shared_ptr<fletcher::Context> context;
+
+    // Create a context for this RecordBatch on the platform.
+    status = fletcher::Context::Make(&context, platform);
+
+    if (!status.ok()) {
+      std::cerr << "Could not create Fletcher context." << std::endl;
+      return -1;
+    }
+
+    // Queue the recordbatch to our context.
+    status = context->QueueRecordBatch(number_batch);
+
+    if (!status.ok()) {
+      std::cerr << "Could not queue the RecordBatch to the context." << std::endl;
+      return -1;
+    }
+
+    // "Enable" the context, potentially copying the recordbatch to the device. This depends on your platform.
+    // AWS EC2 F1 requires a copy, but OpenPOWER SNAP doesn't.
+    status = context->Enable();
+
+    if (!status.ok()) {
+      std::cerr << "Could not enable the context." << std::endl;
+      return -1;
+    }
+
+    // Create a kernel based on the context.
+    fletcher::Kernel kernel(context);
+
+    // Start the kernel.
+    status = kernel.Start();
+
+    if (!status.ok()) {
+      std::cerr << "Could not start the kernel." << std::endl;
+      return -1;
+    }
+
+    // Wait for the kernel to finish.
+    status = kernel.PollUntilDone();
+
+    if (!status.ok()) {
+      std::cerr << "Something went wrong waiting for the kernel to finish." << std::endl;
+      return -1;
+    }
+
+    // Obtain the return value.
+    uint32_t return_value_0;
+    uint32_t return_value_1;
+    status = kernel.GetReturn(&return_value_0, &return_value_1);
+
+    if (!status.ok()) {
+      std::cerr << "Could not obtain the return value." << std::endl;
+      return -1;
+    }
+
+    // Accumulate the sums of all RecordBatches.
+    sum += *reinterpret_cast<int32_t*>(&return_value_0);
+    num_batches++;
   }
 
-  // Wait for the kernel to finish.
-  status = kernel.PollUntilDone();
-
-  if (!status.ok()) {
-    std::cerr << "Something went wrong waiting for the kernel to finish." << std::endl;
-    return -1;
-  }
-
-  // Obtain the return value.
-  uint32_t return_value_0;
-  uint32_t return_value_1;
-  status = kernel.GetReturn(&return_value_0, &return_value_1);
-
-  if (!status.ok()) {
-    std::cerr << "Could not obtain the return value." << std::endl;
+  // The file should contain at least one batch.
+  if (num_batches == 0) {
+    std::cerr << "File did not contain any Arrow RecordBatches." << std::endl;
     return -1;
   }
 
-  // Print the return value.
-  std::cout << *reinterpret_cast<int32_t*>(&return_value_0) << std::endl;
+  // Print the sum.
+  std::cout << sum << std::endl;
 
   return 0;
 }
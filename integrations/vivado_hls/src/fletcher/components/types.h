@@ -90,5 +90,31 @@ using f_mdate32 = f_mupacket<32, N>;
 template <unsigned int N>
 using f_mdate64 = f_mupacket<64, N>;
 
+// Arrow fixed-size list types, delivering a whole list of N elements per transfer:
+template <typename T, unsigned int N>
+using f_fixed_size_list = f_mpacket<T, N>;
+template <unsigned int N>
+using f_fixed_size_list_int8 = f_mint8<N>;
+template <unsigned int N>
+using f_fixed_size_list_int16 = f_mint16<N>;
+template <unsigned int N>
+using f_fixed_size_list_int32 = f_mint32<N>;
+template <unsigned int N>
+using f_fixed_size_list_int64 = f_mint64<N>;
+template <unsigned int N>
+using f_fixed_size_list_uint8 = f_muint8<N>;
+template <unsigned int N>
+using f_fixed_size_list_uint16 = f_muint16<N>;
+template <unsigned int N>
+using f_fixed_size_list_uint32 = f_muint32<N>;
+template <unsigned int N>
+using f_fixed_size_list_uint64 = f_muint64<N>;
+template <unsigned int N>
+using f_fixed_size_list_float16 = f_mfloat16<N>;
+template <unsigned int N>
+using f_fixed_size_list_float32 = f_mfloat32<N>;
+template <unsigned int N>
+using f_fixed_size_list_float64 = f_mfloat64<N>;
+
 //Strings
 using f_string = f_uint8 *;
\ No newline at end of file
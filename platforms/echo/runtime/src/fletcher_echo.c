@@ -139,3 +139,8 @@ fstatus_t platformCacheHostBuffer(const uint8_t *host_source, da_t *device_desti
 
   return status;
 }
+
+fstatus_t platformGetCapabilities(uint64_t *capabilities) {
+  *capabilities = 0;
+  return FLETCHER_STATUS_OK;
+}
@@ -93,6 +93,14 @@ fstatus_t platformPrepareHostBuffer(const uint8_t *host_source, da_t *device_des
  */
 fstatus_t platformCacheHostBuffer(const uint8_t *host_source, da_t *device_destination, int64_t size);
 
+/**
+ * @brief Store the capabilities of the platform in \p capabilities, see FLETCHER_CAP_* in fletcher.h.
+ *
+ * This function is optional for platforms. The Echo platform mimics a platform with on-board memory, so it reports no
+ * capabilities.
+ */
+fstatus_t platformGetCapabilities(uint64_t *capabilities);
+
 /**
  * @brief Terminate the platform.
  *
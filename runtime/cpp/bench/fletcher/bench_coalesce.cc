@@ -0,0 +1,131 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * Benchmark comparing one launch per RecordBatch with one launch over coalesced RecordBatches.
+ *
+ * A table of a fixed number of rows is split into RecordBatches of increasing size. For every size, the time to queue,
+ * enable and launch every RecordBatch separately is compared with the time to coalesce all RecordBatches and launch
+ * once. The crossover is the batch size at which coalescing no longer pays off.
+ *
+ * Usage: bench_coalesce [total rows] [repeats]
+ */
+
+#include <arrow/api.h>
+#include <fletcher/api.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using fletcher::Status;
+
+/// @brief Generate a RecordBatch with a number column and a string column.
+static std::shared_ptr<arrow::RecordBatch> GenerateBatch(int64_t num_rows) {
+  arrow::UInt32Builder nb;
+  arrow::StringBuilder sb;
+  for (int64_t i = 0; i < num_rows; i++) {
+    nb.Append(static_cast<uint32_t>(i)).ok();
+    sb.Append(std::string(1 + i % 16, 'a' + i % 26)).ok();
+  }
+  std::shared_ptr<arrow::Array> n, s;
+  nb.Finish(&n).ok();
+  sb.Finish(&s).ok();
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false),
+                                                           arrow::field("s", arrow::utf8(), false)}),
+                                           "Bench",
+                                           fletcher::Mode::READ);
+  return arrow::RecordBatch::Make(schema, num_rows, {n, s});
+}
+
+/// @brief Queue, enable and launch a single RecordBatch.
+static Status Launch(const std::shared_ptr<fletcher::Platform> &platform,
+                     const std::shared_ptr<arrow::RecordBatch> &batch,
+                     bool poll) {
+  std::shared_ptr<fletcher::Context> context;
+  auto status = fletcher::Context::Make(&context, platform);
+  if (!status.ok()) return status;
+  status = context->QueueRecordBatch(batch);
+  if (!status.ok()) return status;
+  status = context->Enable();
+  if (!status.ok()) return status;
+  fletcher::Kernel kernel(context);
+  status = kernel.Start();
+  if (!status.ok()) return status;
+  return poll ? kernel.PollUntilDone() : Status::OK();
+}
+
+int main(int argc, char **argv) {
+  int64_t total_rows = argc > 1 ? std::strtoll(argv[1], nullptr, 10) : 1 << 20;
+  int repeats = argc > 2 ? std::atoi(argv[2]) : 3;
+
+  std::shared_ptr<fletcher::Platform> platform;
+  fletcher::Platform::Make(&platform, true).ewf("Could not create platform.");
+  // The echo platform takes a single int option to suppress its output, and takes register values from stdin, so
+  // kernels are not polled for completion there.
+  int quiet = 1;
+  bool poll = platform->name() != "echo";
+  if (!poll) {
+    platform->init_data = &quiet;
+  }
+  platform->Init().ewf("Could not initialize platform.");
+
+  auto table = GenerateBatch(total_rows);
+
+  std::cout << std::setw(12) << "batch_rows," << std::setw(10) << "batches," << std::setw(15) << "separate_s,"
+            << std::setw(15) << "coalesced_s," << std::setw(10) << "speedup" << std::endl;
+
+  for (int64_t batch_rows = 1024; batch_rows <= total_rows; batch_rows *= 2) {
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+    for (int64_t first = 0; first < total_rows; first += batch_rows) {
+      batches.push_back(table->Slice(first, std::min(batch_rows, total_rows - first)));
+    }
+
+    double separate = 0.0;
+    double coalesced = 0.0;
+    fletcher::Timer t;
+    for (int r = 0; r < repeats; r++) {
+      t.start();
+      for (const auto &batch : batches) {
+        Launch(platform, batch, poll).ewf("Could not launch RecordBatch.");
+      }
+      t.stop();
+      separate += t.seconds();
+
+      t.start();
+      std::shared_ptr<fletcher::BatchCoalescer> coalescer;
+      fletcher::BatchCoalescer::Make(&coalescer, table->schema()).ewf("Could not create coalescer.");
+      for (const auto &batch : batches) {
+        coalescer->Append(batch).ewf("Could not append RecordBatch.");
+      }
+      std::shared_ptr<arrow::RecordBatch> combined;
+      coalescer->Finish(&combined).ewf("Could not coalesce RecordBatches.");
+      Launch(platform, combined, poll).ewf("Could not launch coalesced RecordBatch.");
+      t.stop();
+      coalesced += t.seconds();
+    }
+
+    std::cout << std::setw(11) << batch_rows << "," << std::setw(9) << batches.size() << ","
+              << std::setw(14) << std::fixed << std::setprecision(6) << separate / repeats << ","
+              << std::setw(14) << coalesced / repeats << ","
+              << std::setw(10) << std::setprecision(2) << separate / coalesced << std::endl;
+  }
+
+  platform->Terminate().ewf("Could not terminate platform.");
+  return 0;
+}
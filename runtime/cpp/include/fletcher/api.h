@@ -21,6 +21,7 @@
 #include "fletcher/status.h"
 #include "fletcher/timer.h"
 #include "fletcher/arrow-utils.h"
+#include "fletcher/arrow-reader.h"
 #include "fletcher/hex-view.h"
 #include "fletcher/arrow-recordbatch.h"
 #include "fletcher/arrow-schema.h"
@@ -29,6 +30,12 @@
 #include "fletcher/context.h"
 #include "fletcher/platform.h"
 #include "fletcher/kernel.h"
+#include "fletcher/executor.h"
+#include "fletcher/coalesce.h"
+#include "fletcher/lazy.h"
+#include "fletcher/catalog.h"
+#include "fletcher/metrics.h"
+#include "fletcher/c_api.h"
 
 /// Contains all Fletcher classes and functions for use in run-time applications.
 namespace fletcher {
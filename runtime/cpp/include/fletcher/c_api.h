@@ -0,0 +1,173 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * @file c_api.h
+ * @brief C-callable entry points of the run-time library, exchanging data through the Arrow C data interface.
+ *
+ * This allows engines that are not written in C++ to offload RecordBatches to a Fletcher kernel without copies.
+ */
+
+#pragma once
+
+#include <fletcher/fletcher.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The Arrow C data interface and C stream interface, as specified by the Apache Arrow project.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char *format;
+  const char *name;
+  const char *metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema **children;
+  struct ArrowSchema *dictionary;
+  void (*release)(struct ArrowSchema *);
+  void *private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void **buffers;
+  struct ArrowArray **children;
+  struct ArrowArray *dictionary;
+  void (*release)(struct ArrowArray *);
+  void *private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+#ifndef ARROW_C_STREAM_INTERFACE
+#define ARROW_C_STREAM_INTERFACE
+
+struct ArrowArrayStream {
+  int (*get_schema)(struct ArrowArrayStream *, struct ArrowSchema *out);
+  int (*get_next)(struct ArrowArrayStream *, struct ArrowArray *out);
+  const char *(*get_last_error)(struct ArrowArrayStream *);
+  void (*release)(struct ArrowArrayStream *);
+  void *private_data;
+};
+
+#endif  // ARROW_C_STREAM_INTERFACE
+
+/// Opaque handle to a platform, and the context and kernel that run on it.
+typedef struct FletcherHandle FletcherHandle;
+
+/// Function called with the return values of the kernel for every RecordBatch of a stream.
+typedef fstatus_t (*FletcherStreamCallback)(size_t index, uint32_t return0, uint32_t return1, void *user_data);
+
+/**
+ * @brief Create a handle to a platform with an empty context.
+ * @param[in]  platform_name  The name of the platform, or NULL to autodetect it.
+ * @param[out] handle         The new handle. Must be destroyed with fletcherDestroy().
+ * @return FLETCHER_STATUS_OK if successful, FLETCHER_STATUS_ERROR otherwise.
+ */
+fstatus_t fletcherCreate(const char *platform_name, FletcherHandle **handle);
+
+/**
+ * @brief Queue a RecordBatch, exported through the Arrow C data interface, without copies.
+ * @param[in] handle  The handle.
+ * @param[in] array   The array to queue, of a struct type. Ownership moves to the handle, and the array is marked
+ *                    released.
+ * @param[in] schema  The schema of the array, including the Fletcher metadata. Ownership moves to the handle, and the
+ *                    schema is marked released.
+ * @param[in] cache   Nonzero to guarantee that the RecordBatch is copied to on-board memory.
+ * @return FLETCHER_STATUS_OK if successful, FLETCHER_STATUS_ERROR otherwise.
+ */
+fstatus_t fletcherQueueArrowArray(FletcherHandle *handle,
+                                  struct ArrowArray *array,
+                                  struct ArrowSchema *schema,
+                                  int cache);
+
+/**
+ * @brief Make the queued RecordBatches available to the device.
+ * @param[in] handle  The handle.
+ * @return FLETCHER_STATUS_OK if successful, or an error status otherwise.
+ */
+fstatus_t fletcherEnable(FletcherHandle *handle);
+
+/**
+ * @brief Set the custom arguments of the kernel.
+ * @param[in] handle         The handle.
+ * @param[in] arguments      The arguments.
+ * @param[in] num_arguments  The number of arguments.
+ * @return FLETCHER_STATUS_OK if successful, FLETCHER_STATUS_ERROR otherwise.
+ */
+fstatus_t fletcherSetArguments(FletcherHandle *handle, const uint32_t *arguments, size_t num_arguments);
+
+/**
+ * @brief Start the kernel on the enabled RecordBatches and wait for it to complete.
+ * @param[in]  handle   The handle.
+ * @param[out] return0  Return value 0 of the kernel. May be NULL.
+ * @param[out] return1  Return value 1 of the kernel. May be NULL.
+ * @return FLETCHER_STATUS_OK if successful, FLETCHER_STATUS_ERROR otherwise.
+ */
+fstatus_t fletcherRun(FletcherHandle *handle, uint32_t *return0, uint32_t *return1);
+
+/**
+ * @brief Export a write-mode RecordBatch written by the kernel through the Arrow C data interface.
+ * @param[in]  handle       The handle.
+ * @param[in]  batch_index  The index of the queued RecordBatch.
+ * @param[in]  num_rows     The number of rows written by the kernel. All rows of the RecordBatch if negative.
+ * @param[out] array        The exported array. The consumer must release it.
+ * @param[out] schema       The exported schema. The consumer must release it.
+ * @return FLETCHER_STATUS_OK if successful, FLETCHER_STATUS_ERROR otherwise.
+ */
+fstatus_t fletcherExportRecordBatch(FletcherHandle *handle,
+                                    size_t batch_index,
+                                    int64_t num_rows,
+                                    struct ArrowArray *array,
+                                    struct ArrowSchema *schema);
+
+/**
+ * @brief Run the kernel over every RecordBatch of a stream, overlapping transfers with kernel execution.
+ *
+ * Every RecordBatch gets a context of its own, so the context of the handle is not used.
+ *
+ * @param[in] handle     The handle.
+ * @param[in] stream     The stream to consume. Ownership moves to this function, and the stream is marked released.
+ * @param[in] callback   Function called with the return values of every RecordBatch. May be NULL.
+ * @param[in] user_data  Passed to the callback.
+ * @return FLETCHER_STATUS_OK if successful, FLETCHER_STATUS_ERROR otherwise.
+ */
+fstatus_t fletcherRunArrowArrayStream(FletcherHandle *handle,
+                                      struct ArrowArrayStream *stream,
+                                      FletcherStreamCallback callback,
+                                      void *user_data);
+
+/// @brief Return the message of the last error of a handle, or an empty string.
+const char *fletcherGetLastError(FletcherHandle *handle);
+
+/// @brief Destroy a handle, releasing all queued RecordBatches and device buffers.
+void fletcherDestroy(FletcherHandle *handle);
+
+#ifdef __cplusplus
+}
+#endif
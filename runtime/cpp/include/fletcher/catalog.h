@@ -0,0 +1,150 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arrow/api.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "fletcher/context.h"
+#include "fletcher/platform.h"
+#include "fletcher/status.h"
+
+namespace fletcher {
+
+/**
+ * @brief A RecordBatch that is resident on the device, registered in a DeviceCatalog.
+ *
+ * Shared pointers to a CatalogEntry act as reference-counted handles. The device memory of the entry is freed when the
+ * entry is evicted from its catalog and no handles to it are left, e.g. in Contexts it was queued to.
+ */
+class CatalogEntry {
+ public:
+  /**
+   * @brief Construct a new CatalogEntry.
+   * @param[in] name     The name of the entry in the catalog.
+   * @param[in] context  The Context holding the device buffers of the entry.
+   */
+  CatalogEntry(std::string name, std::shared_ptr<Context> context)
+      : name_(std::move(name)), context_(std::move(context)) {}
+
+  /// @brief Return the name of this entry.
+  const std::string &name() const { return name_; }
+  /// @brief Return the host-side RecordBatch of this entry.
+  std::shared_ptr<arrow::RecordBatch> batch() const { return context_->recordbatch(0); }
+  /// @brief Return the Context holding the device buffers of this entry.
+  std::shared_ptr<Context> context() const { return context_; }
+  /// @brief Return the number of bytes this entry occupies on the device.
+  size_t size() const { return context_->GetQueueSize(); }
+
+ protected:
+  /// The name of this entry.
+  std::string name_;
+  /// The Context holding the device buffers.
+  std::shared_ptr<Context> context_;
+};
+
+/**
+ * @brief A catalog of tables that stay resident on the device beyond the lifetime of a single Context.
+ *
+ * Tables are transferred to the device once when they are registered. The resulting handle can be queued to any
+ * Context on the same platform with Context::QueueCatalogEntry(), without transferring the data again.
+ */
+class DeviceCatalog {
+ public:
+  /**
+   * @brief Construct a new DeviceCatalog.
+   * @param[in] platform  The platform the tables are resident on.
+   */
+  explicit DeviceCatalog(std::shared_ptr<Platform> platform) : platform_(std::move(platform)) {}
+
+  /**
+   * @brief Create a new DeviceCatalog.
+   * @param[out] catalog   A pointer to a shared pointer that will own the new DeviceCatalog.
+   * @param[in]  platform  The platform the tables are resident on.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  static Status Make(std::shared_ptr<DeviceCatalog> *catalog, const std::shared_ptr<Platform> &platform);
+
+  /**
+   * @brief Register a table, transferring it to the device.
+   *
+   * The chunks of the table are combined into a single RecordBatch first.
+   *
+   * @param[in]  name      A unique name for the table.
+   * @param[in]  table     The table to register. Its schema must be a read-mode schema.
+   * @param[out] handle    The handle to the new entry.
+   * @param[in]  mem_type  The memory type to make the table available to the device with.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Register(const std::string &name,
+                  const std::shared_ptr<arrow::Table> &table,
+                  std::shared_ptr<CatalogEntry> *handle,
+                  MemType mem_type = MemType::CACHE);
+
+  /**
+   * @brief Obtain the handle of a registered table.
+   * @param[in]  name    The name of the table.
+   * @param[out] handle  The handle to the entry.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Lookup(const std::string &name, std::shared_ptr<CatalogEntry> *handle) const;
+
+  /**
+   * @brief Remove a table from the catalog.
+   *
+   * Its device memory is freed as soon as no other handles to it are left.
+   *
+   * @param[in] name The name of the table.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Evict(const std::string &name);
+
+  /// @brief Return the names of all registered tables.
+  std::vector<std::string> names() const;
+
+  /// @brief Return the number of bytes occupied by registered tables, and by evicted tables that are still in use.
+  size_t bytes_resident() const;
+
+  /**
+   * @brief Set the maximum number of bytes that tables may occupy on the device. Registering fails beyond it.
+   * @param[in] bytes The capacity in bytes. Zero means unlimited.
+   */
+  void set_capacity(size_t bytes) { capacity_ = bytes; }
+
+  /// @brief Return the capacity of the catalog in bytes. Zero means unlimited.
+  size_t capacity() const { return capacity_; }
+
+ protected:
+  /// @brief Return the number of bytes resident on the device. The mutex must be held.
+  size_t BytesResident() const;
+
+  /// The platform the tables are resident on.
+  std::shared_ptr<Platform> platform_;
+  /// The registered tables.
+  std::map<std::string, std::shared_ptr<CatalogEntry>> entries_;
+  /// Evicted tables that may still be in use.
+  mutable std::vector<std::weak_ptr<CatalogEntry>> evicted_;
+  /// The maximum number of bytes tables may occupy on the device, or zero if unlimited.
+  size_t capacity_ = 0;
+  /// Protects the catalog against concurrent modification.
+  mutable std::mutex mutex_;
+};
+
+}  // namespace fletcher
@@ -0,0 +1,106 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arrow/api.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "fletcher/status.h"
+
+namespace fletcher {
+
+/**
+ * @brief Coalesces many small RecordBatches of the same schema into a single RecordBatch.
+ *
+ * Every RecordBatch queued to a Context and launched on a Kernel comes with a fixed overhead. For small RecordBatches,
+ * this overhead can dominate the run time. The BatchCoalescer concatenates the buffers of the appended RecordBatches
+ * into contiguous buffers, rebasing offsets and concatenating validity bitmaps, such that the kernel can process all
+ * of them in a single launch. Results per row of the coalesced RecordBatch can be mapped back to the source
+ * RecordBatches afterwards.
+ */
+class BatchCoalescer {
+ public:
+  /**
+   * @brief Construct a new BatchCoalescer.
+   * @param[in] schema The schema of the RecordBatches to coalesce, including the Fletcher metadata.
+   */
+  explicit BatchCoalescer(std::shared_ptr<arrow::Schema> schema) : schema_(std::move(schema)) {}
+
+  /**
+   * @brief Create a new BatchCoalescer.
+   * @param[out] coalescer  A pointer to a shared pointer that will own the new BatchCoalescer.
+   * @param[in]  schema     The schema of the RecordBatches to coalesce, including the Fletcher metadata.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  static Status Make(std::shared_ptr<BatchCoalescer> *coalescer, const std::shared_ptr<arrow::Schema> &schema);
+
+  /**
+   * @brief Append a RecordBatch.
+   * @param[in] batch The RecordBatch to append. Its schema must equal the schema of the BatchCoalescer, metadata aside.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Append(const std::shared_ptr<arrow::RecordBatch> &batch);
+
+  /**
+   * @brief Concatenate all appended RecordBatches into a single RecordBatch.
+   *
+   * A single appended RecordBatch is returned as is, without copies.
+   *
+   * @param[out] out The coalesced RecordBatch, with the schema of the BatchCoalescer.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Finish(std::shared_ptr<arrow::RecordBatch> *out) const;
+
+  /**
+   * @brief Find the source RecordBatch of a row of the coalesced RecordBatch.
+   * @param[in]  row          The row of the coalesced RecordBatch.
+   * @param[out] batch_index  The index of the source RecordBatch, in the order of appending.
+   * @param[out] batch_row    The row within the source RecordBatch.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Locate(int64_t row, size_t *batch_index, int64_t *batch_row) const;
+
+  /**
+   * @brief Split a RecordBatch with one row per row of the coalesced RecordBatch into one RecordBatch per source.
+   *
+   * This is typically used to map the results of a kernel, e.g. obtained with Context::Materialize(), back to the
+   * source RecordBatches. The resulting RecordBatches are zero-copy slices of the input.
+   *
+   * @param[in]  rows  The RecordBatch to split.
+   * @param[out] out   The slices, in the order the source RecordBatches were appended.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Split(const std::shared_ptr<arrow::RecordBatch> &rows,
+               std::vector<std::shared_ptr<arrow::RecordBatch>> *out) const;
+
+  /// @brief Return the schema of the coalesced RecordBatch.
+  std::shared_ptr<arrow::Schema> schema() const { return schema_; }
+  /// @brief Return the number of appended RecordBatches.
+  size_t num_batches() const { return batches_.size(); }
+  /// @brief Return the total number of rows of all appended RecordBatches.
+  int64_t num_rows() const { return offsets_.empty() ? 0 : offsets_.back(); }
+
+ protected:
+  /// The schema of the coalesced RecordBatch.
+  std::shared_ptr<arrow::Schema> schema_;
+  /// The appended RecordBatches.
+  std::vector<std::shared_ptr<arrow::RecordBatch>> batches_;
+  /// The first row of every source RecordBatch in the coalesced RecordBatch, followed by the total number of rows.
+  std::vector<int64_t> offsets_;
+};
+
+}  // namespace fletcher
@@ -20,14 +20,21 @@
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <string>
 
 #include "fletcher/platform.h"
 #include "fletcher/status.h"
 
+// Arrow C data interface structures, see arrow/c/abi.h.
+struct ArrowArray;
+struct ArrowSchema;
+
 namespace fletcher {
 
 using fletcher::Mode;
 
+class CatalogEntry;
+
 /// Enumeration for different types of memory management.
 enum class MemType {
   /**
@@ -49,7 +56,50 @@ enum class MemType {
    * Selecting CACHE may result in higher performance if there is data reuse by the kernel, but may result in lower
    * performance if the data is not reused by the kernel (for example fully streamable kernels).
    */
-      CACHE
+      CACHE,
+
+  /**
+   * @brief Start like ANY, and move buffers to on-board memory once their observed reuse makes that worthwhile.
+   *
+   * The Context counts how often the kernel is launched on every read-mode buffer. A buffer is promoted to on-board
+   * memory when the time saved by its launches so far, had it been cached, exceeds the time to copy it, according to
+   * the PlacementModel of the Context. Under memory pressure, the least reused promoted buffers are demoted again.
+   * On platforms where ANY already copies to on-board memory, AUTO behaves the same as ANY.
+   */
+      AUTO
+};
+
+/// Bandwidth characteristics used to decide on the placement of MemType::AUTO buffers, in bytes per second.
+struct PlacementModel {
+  /// The bandwidth of the kernel accessing host memory directly.
+  double host_access_bandwidth = 8e9;
+  /// The bandwidth of the kernel accessing on-board memory.
+  double device_access_bandwidth = 32e9;
+  /// The bandwidth of copying from host memory to on-board memory.
+  double transfer_bandwidth = 8e9;
+
+  /// @brief Return the time in seconds saved per launch by accessing a buffer of some size in on-board memory.
+  double SavedPerLaunch(int64_t size) const;
+  /// @brief Return the time in seconds to copy a buffer of some size to on-board memory.
+  double TransferTime(int64_t size) const;
+  /// @brief Return true if a buffer of some size, launched on a number of times, should be in on-board memory.
+  bool ShouldPromote(int64_t size, uint64_t launches) const;
+};
+
+/// Statistics of the placement decisions for MemType::AUTO buffers of a Context.
+struct PlacementStatistics {
+  /// The number of buffers promoted to on-board memory.
+  size_t promotions = 0;
+  /// The number of buffers demoted to host memory, due to memory pressure.
+  size_t demotions = 0;
+  /// The number of bytes copied to on-board memory by promotions.
+  size_t bytes_promoted = 0;
+  /// The estimated time in seconds saved by the placement decisions, i.e. the time saved by launches on promoted
+  /// buffers minus the time spent promoting them.
+  double seconds_saved = 0.0;
+
+  /// @brief Return a human-readable report of the statistics.
+  std::string ToString() const;
 };
 
 /// A buffer on the device
@@ -70,6 +120,10 @@ struct DeviceBuffer {
   bool available_to_device = false;
   /// Whether this buffer was allocated on the device using Platform malloc.
   bool was_alloced = false;
+  /// The number of kernel launches on this buffer, counted for MemType::AUTO buffers.
+  uint64_t launches = 0;
+  /// Whether this MemType::AUTO buffer was promoted to on-board memory.
+  bool promoted = false;
 
   /// @brief Construct a default DeviceBuffer.
   DeviceBuffer() = default;
@@ -112,12 +166,208 @@ class Context {
   Status QueueRecordBatch(const std::shared_ptr<arrow::RecordBatch> &record_batch,
                           MemType mem_type = MemType::ANY);
 
+  /**
+   * @brief Enqueue the columns of an arrow::RecordBatch that are used by a kernel with a specific schema.
+   *
+   * Only the columns named by the non-ignored fields of the kernel schema are analyzed, transferred and laid out in the
+   * buffer address registers, in the order of the kernel schema. Other columns of the RecordBatch are left on the host.
+   * This allows a kernel generated from a projection of a wider schema to be fed straight from the wide RecordBatches.
+   *
+   * @param[in] record_batch  The arrow::RecordBatch to queue.
+   * @param[in] kernel_schema The schema the kernel was generated from, or nullptr to use the schema of the RecordBatch.
+   * @param[in] mem_type      Force caching; i.e. the RecordBatch is guaranteed to be copied to on-board memory.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status QueueRecordBatch(const std::shared_ptr<arrow::RecordBatch> &record_batch,
+                          const std::shared_ptr<arrow::Schema> &kernel_schema,
+                          MemType mem_type = MemType::ANY);
+
+  /**
+   * @brief Enqueue a RecordBatch exported through the Arrow C data interface.
+   *
+   * The RecordBatch is imported without copies. Ownership of the array and the schema moves to this Context, which
+   * releases them when it is destructed. The array must be of a struct type, of which every child is a column.
+   *
+   * @param[in] array     The C data interface array to queue. It is marked released on success.
+   * @param[in] schema    The C data interface schema of the array, including the Fletcher metadata. It is marked
+   *                      released on success.
+   * @param[in] mem_type  Force caching; i.e. the RecordBatch is guaranteed to be copied to on-board memory.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status QueueArrowArray(struct ArrowArray *array, struct ArrowSchema *schema, MemType mem_type = MemType::ANY);
+
+  /**
+   * @brief Enqueue a RecordBatch that is resident on the device through a DeviceCatalog.
+   *
+   * The buffers of the entry are used by the device as they are, without transfers or allocations. The entry is kept
+   * alive at least as long as this Context.
+   *
+   * @param[in] entry The catalog entry to queue.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status QueueCatalogEntry(const std::shared_ptr<CatalogEntry> &entry);
+
   /// @brief Obtain the size (in bytes) of all buffers currently enqueued.
   size_t GetQueueSize() const;
 
-  /// @brief Enable the usage of the enqueued buffers by the device.
+  /// @brief Obtain the size (in bytes) of all enqueued buffers that are not resident on the device already.
+  size_t GetUploadSize() const;
+
+  /**
+   * @brief Set the maximum number of bytes this Context may make available to the device at once.
+   *
+   * If the queued RecordBatches exceed the budget, Enable() fails, and the kernel must be run over row ranges of the
+   * RecordBatches that fit the budget using Kernel::RunPartitioned().
+   *
+   * @param[in] bytes The budget in bytes. Zero means unlimited.
+   */
+  void set_memory_budget(size_t bytes) { memory_budget_ = bytes; }
+
+  /// @brief Return the device memory budget of this Context in bytes. Zero means unlimited.
+  size_t memory_budget() const { return memory_budget_; }
+
+  /**
+   * @brief Set the size of the chunks in which buffers with MemType::CACHE are copied to the device by Enable().
+   *
+   * Copying in chunks allows the next chunk of the host buffer to be read ahead while the current one is transferred.
+   * This avoids stalls on page faults when the RecordBatches reference a memory-mapped file, e.g. one opened with
+   * ReadRecordBatchesFromMappedFile().
+   *
+   * @param[in] bytes The chunk size in bytes. Zero means every buffer is copied at once.
+   */
+  void set_transfer_chunk_size(size_t bytes) { transfer_chunk_size_ = bytes; }
+
+  /// @brief Return the size of the chunks in which buffers are copied to the device. Zero means unchunked.
+  size_t transfer_chunk_size() const { return transfer_chunk_size_; }
+
+  /// @brief Return true if the queued RecordBatches fit the device memory budget.
+  bool FitsMemoryBudget() const;
+
+  /**
+   * @brief Split the rows of the queued RecordBatches into consecutive ranges that each fit the device memory budget.
+   *
+   * All queued RecordBatches must be read-mode and have the same number of rows.
+   *
+   * @param[out] ranges The first (inclusive) and last (exclusive) row of every range.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Partition(std::vector<std::pair<int64_t, int64_t>> *ranges) const;
+
+  /**
+   * @brief Create a new Context holding a row range of the queued RecordBatches.
+   * @param[in]  first  The first row of the range (inclusive).
+   * @param[in]  last   The last row of the range (exclusive).
+   * @param[out] out    The new Context, with the same memory types and budget. It must still be enabled.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Slice(int64_t first, int64_t last, std::shared_ptr<Context> *out) const;
+
+  /**
+   * @brief Enable the usage of the enqueued buffers by the device.
+   *
+   * Fails with Status::DEVICE_OUT_OF_MEMORY() if the queued RecordBatches exceed the device memory budget, and with an
+   * error if the Context is enabled already.
+   *
+   * Buffers of RecordBatches with a read-mode schema are made available to the device according to their MemType.
+   * Buffers of RecordBatches with a write-mode schema are only allocated; their host-side contents are not transferred
+   * to the device. With MemType::ANY on platforms that share the host address space, the kernel writes to the host
+   * buffers directly.
+   */
   Status Enable();
 
+  /**
+   * @brief Account for a kernel launch on this Context, and update the placement of MemType::AUTO buffers.
+   *
+   * This is called by Kernel::Start(). If any buffer is moved, the kernel must write its buffer addresses again.
+   *
+   * @param[out] moved Whether any device address changed.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status RecordLaunch(bool *moved);
+
+  /// @brief Set the bandwidth characteristics used for the placement of MemType::AUTO buffers.
+  void set_placement_model(const PlacementModel &model) { placement_model_ = model; }
+
+  /// @brief Return the statistics of the placement of MemType::AUTO buffers.
+  const PlacementStatistics &placement_statistics() const { return placement_statistics_; }
+
+  /**
+   * @brief Enable the usage of the enqueued buffers by the device, using a single device allocation for all buffers.
+   *
+   * All buffers are laid out consecutively in one arena, each starting at a multiple of the alignment. The contents of
+   * read-mode buffers are gathered in a host-side staging buffer, which is transferred to the device at once. This
+   * replaces an allocation and a transfer per buffer with one of each, and avoids the per-allocation padding of the
+   * platform. The buffers are always copied to the device, regardless of their MemType. The arena, including the
+   * padding of the buffers, must fit the device memory budget. A Context can only be enabled once.
+   *
+   * @param[in] alignment The alignment of every buffer in the arena in bytes, e.g. the bus burst size of the kernel.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status EnablePacked(int64_t alignment = 64);
+
+  /**
+   * @brief Read back the buffers of a write-mode RecordBatch from the device into a new arrow::RecordBatch.
+   *
+   * Buffers that were allocated on the device are copied back in parallel into newly allocated, Arrow-owned memory.
+   * Buffers that the device wrote to in host memory directly (i.e. MemType::ANY on platforms that share the host
+   * address space) are referenced without copies. The Context must be enabled and the kernel must have finished.
+   *
+   * Only the bytes used by the first num_rows rows are read back. The number of bytes or child elements used by
+   * variable-length arrays follows from the offsets written by the kernel, so output buffers may be sized for the
+   * expected case rather than the worst case. See Kernel::GetOverflow().
+   *
+   * @param[in]  batch_index  The index of the queued RecordBatch to materialize.
+   * @param[out] out          The resulting RecordBatch.
+   * @param[in]  num_rows     The number of rows written by the kernel. All rows of the RecordBatch if negative.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Materialize(size_t batch_index, std::shared_ptr<arrow::RecordBatch> *out, int64_t num_rows = -1);
+
+  /**
+   * @brief Read back a single column of a write-mode RecordBatch from the device.
+   *
+   * Like Materialize(), but only the buffers of one column are read back. See also LazyRecordBatch.
+   *
+   * @param[in]  batch_index  The index of the queued RecordBatch.
+   * @param[in]  column       The index of the column to read back.
+   * @param[out] out          The resulting column.
+   * @param[in]  num_rows     The number of rows written by the kernel. All rows of the RecordBatch if negative.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status MaterializeColumn(size_t batch_index, int column, std::shared_ptr<arrow::Array> *out, int64_t num_rows = -1);
+
+  /**
+   * @brief Materialize a write-mode RecordBatch and export it through the Arrow C data interface.
+   *
+   * The exported array references the materialized buffers without further copies. The consumer must call the
+   * release callbacks of the array and the schema when it is done with them.
+   *
+   * @param[in]  batch_index  The index of the queued RecordBatch to export.
+   * @param[out] array        The C data interface array to export to.
+   * @param[out] schema       The C data interface schema to export to.
+   * @param[in]  num_rows     The number of rows written by the kernel. All rows of the RecordBatch if negative.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status ExportRecordBatch(size_t batch_index,
+                           struct ArrowArray *array,
+                           struct ArrowSchema *schema,
+                           int64_t num_rows = -1);
+
+  /**
+   * @brief Create a new Context to resume processing from some row, e.g. after the kernel overflowed an output buffer.
+   *
+   * Read-mode RecordBatches are sliced such that they start at the resumed row. For write-mode RecordBatches, new
+   * output buffers are allocated for the remaining rows. The capacity of their variable-length data is the capacity
+   * of the original RecordBatch multiplied by the growth factor. The row applies to all RecordBatches, so the kernel
+   * must process the rows of all RecordBatches in lockstep. The new Context must still be enabled.
+   *
+   * @param[in]  row     The first row to process in the new Context.
+   * @param[out] out     The new Context.
+   * @param[in]  growth  The factor by which to grow the capacity of variable-length output data. Must be above 1.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status ResumeFrom(int64_t row, std::shared_ptr<Context> *out, double growth = 2.0) const;
+
   /// @brief Return the platform this context is active on.
   std::shared_ptr<Platform> platform() const { return platform_; }
 
@@ -141,17 +391,66 @@ class Context {
    */
   std::shared_ptr<arrow::RecordBatch> recordbatch(size_t i) const { return host_batches_[i]; }
 
+  /// @brief Return the description of the i-th arrow::RecordBatch of this context.
+  RecordBatchDescription recordbatch_description(size_t i) const {
+    return host_batch_layout_[i]->Describe(*host_batches_[i], host_batch_buffers_[i]);
+  }
+
+  /// @brief Return the buffer layout of the i-th arrow::RecordBatch of this context.
+  const std::shared_ptr<const BufferLayout> &buffer_layout(size_t i) const { return host_batch_layout_[i]; }
+
  protected:
+  /// @brief Return the index of the first DeviceBuffer of the i-th RecordBatch.
+  size_t first_buffer(size_t i) const;
+
+  /// @brief Read back some columns of a write-mode RecordBatch. Sets num_rows to the number of rows if negative.
+  Status ReadbackColumns(size_t batch_index,
+                         const std::vector<int> &columns,
+                         int64_t *num_rows,
+                         std::vector<std::shared_ptr<arrow::Array>> *out);
+
+  /// @brief Append the device buffers of the i-th RecordBatch, which is a catalog entry.
+  Status AppendCatalogBuffers(size_t i);
+
+  /// @brief Move a promoted MemType::AUTO buffer back to host memory.
+  Status Demote(DeviceBuffer *buffer);
+
+  /**
+   * @brief Make an output buffer available to the device without transferring its host-side contents.
+   *
+   * If the platform doesn't report its capabilities, the platform prepares the buffer, as it may share the address
+   * space of the host. Such platforms may still transfer the contents.
+   */
+  Status PrepareOutputBuffer(DeviceBuffer *buffer, bool capabilities_known, bool shared_address_space);
+  /// @brief Allocate a device buffer and copy the host buffer to it in chunks of transfer_chunk_size_ bytes.
+  Status CacheHostBufferChunked(DeviceBuffer *buffer);
+
   /// The platform this context is running on.
   std::shared_ptr<Platform> platform_;
   /// The RecordBatches on the host side.
   std::vector<std::shared_ptr<arrow::RecordBatch>> host_batches_;
-  /// The descriptions of the RecordBatches on the host side.
-  std::vector<RecordBatchDescription> host_batch_desc_;
+  /// The buffer layouts of the RecordBatches on the host side, shared by all RecordBatches with the same schema.
+  std::vector<std::shared_ptr<const BufferLayout>> host_batch_layout_;
+  /// The buffers of the RecordBatches on the host side, in the order of their buffer layout.
+  std::vector<std::vector<BufferRef>> host_batch_buffers_;
+  /// The kernel schema the RecordBatch was projected on, or nullptr if all its columns are used.
+  std::vector<std::shared_ptr<arrow::Schema>> host_batch_schema_;
   /// Whether the RecordBatch must be prepared or cached for the device.
   std::vector<MemType> host_batch_memtype_;
+  /// The catalog entry of every RecordBatch, or nullptr if the RecordBatch is not from a DeviceCatalog.
+  std::vector<std::shared_ptr<CatalogEntry>> host_batch_entry_;
   /// Prepared/cached buffers on the device.
   std::vector<DeviceBuffer> device_buffers_;
+  /// The device allocation holding all buffers, if the Context was enabled packed.
+  da_t arena_ = D_NULLPTR;
+  /// The bandwidth characteristics for the placement of MemType::AUTO buffers.
+  PlacementModel placement_model_;
+  /// The statistics of the placement of MemType::AUTO buffers.
+  PlacementStatistics placement_statistics_;
+  /// The maximum number of bytes to make available to the device at once, or zero if unlimited.
+  size_t memory_budget_ = 0;
+  /// The size of the chunks in which cached buffers are copied to the device, or zero if unchunked.
+  size_t transfer_chunk_size_ = 0;
 };
 
 }  // namespace fletcher
@@ -0,0 +1,168 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arrow/api.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "fletcher/context.h"
+#include "fletcher/kernel.h"
+#include "fletcher/platform.h"
+#include "fletcher/status.h"
+
+// Arrow C stream interface structure, see arrow/c/abi.h.
+struct ArrowArrayStream;
+
+namespace fletcher {
+
+/// A RecordBatch that is in flight in a StreamExecutor.
+struct StreamBatch {
+  /// The index of this RecordBatch in the stream.
+  size_t index = 0;
+  /// The RecordBatch on the host side.
+  std::shared_ptr<arrow::RecordBatch> batch;
+  /// The Context holding the device buffer set of this RecordBatch.
+  std::shared_ptr<Context> context;
+  /// The Kernel that processed this RecordBatch.
+  std::shared_ptr<Kernel> kernel;
+  /// Return value 0 of the kernel, read right after completion.
+  uint32_t return0 = 0;
+  /// Return value 1 of the kernel, read right after completion.
+  uint32_t return1 = 0;
+};
+
+/// Cumulative time (in seconds) spent in each stage of a StreamExecutor run.
+struct StreamStatistics {
+  /// Time spent obtaining RecordBatches from the source.
+  double source = 0.0;
+  /// Time spent making RecordBatches available to the device.
+  double upload = 0.0;
+  /// Time spent starting kernels and waiting for them to complete.
+  double compute = 0.0;
+  /// Time spent in the result handler and freeing device buffers.
+  double readback = 0.0;
+  /// Wall-clock time of the whole run.
+  double total = 0.0;
+  /// Number of RecordBatches processed.
+  size_t num_batches = 0;
+  /// Number of rows processed.
+  int64_t num_rows = 0;
+  /// Number of bytes made available to the device.
+  size_t num_bytes = 0;
+
+  /// @brief Return the name of the stage that took the most time.
+  std::string bottleneck() const;
+  /// @brief Return a human-readable report of the statistics.
+  std::string ToString() const;
+};
+
+/**
+ * @brief Streams RecordBatches through a Kernel, overlapping data transfers with kernel execution.
+ *
+ * While the kernel processes RecordBatch n, RecordBatch n+1 is made available to the device and the results of
+ * RecordBatch n-1 are handled. Every RecordBatch in flight gets its own Context, so up to three device buffer sets are
+ * allocated at the same time. The platform must allow its functions to be called from multiple threads concurrently.
+ */
+class StreamExecutor {
+ public:
+  /// A function that creates a Kernel to process the Context of a single RecordBatch.
+  using KernelFactory = std::function<std::shared_ptr<Kernel>(const std::shared_ptr<Context> &)>;
+  /// A function that handles the results of a processed RecordBatch, e.g. by copying back device buffers.
+  using ResultHandler = std::function<Status(const StreamBatch &)>;
+
+  /**
+   * @brief Construct a new StreamExecutor.
+   * @param[in] platform        The platform to run on.
+   * @param[in] kernel_factory  The factory to create a Kernel for every RecordBatch.
+   * @param[in] result_handler  An optional handler for the results of every RecordBatch.
+   */
+  StreamExecutor(std::shared_ptr<Platform> platform, KernelFactory kernel_factory, ResultHandler result_handler)
+      : platform_(std::move(platform)),
+        kernel_factory_(std::move(kernel_factory)),
+        result_handler_(std::move(result_handler)) {}
+
+  /**
+   * @brief Create a new StreamExecutor.
+   * @param[out] executor        A pointer to a shared pointer that will own the new StreamExecutor.
+   * @param[in]  platform        The platform to run on.
+   * @param[in]  kernel_factory  The factory to create a Kernel for every RecordBatch. When empty, a default Kernel is
+   *                             created.
+   * @param[in]  result_handler  An optional handler for the results of every RecordBatch.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  static Status Make(std::shared_ptr<StreamExecutor> *executor,
+                     const std::shared_ptr<Platform> &platform,
+                     KernelFactory kernel_factory = nullptr,
+                     ResultHandler result_handler = nullptr);
+
+  /**
+   * @brief Process all RecordBatches of a RecordBatchReader.
+   * @param[in] reader  The reader to obtain the RecordBatches from.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Run(const std::shared_ptr<arrow::RecordBatchReader> &reader);
+
+  /**
+   * @brief Process all RecordBatches of a stream exported through the Arrow C stream interface.
+   *
+   * The RecordBatches are imported without copies. Ownership of the stream moves to this function, which releases it
+   * when the run is done.
+   *
+   * @param[in] stream  The C stream interface stream to obtain the RecordBatches from. It is marked released.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Run(struct ArrowArrayStream *stream);
+
+  /**
+   * @brief Process an arrow::Table in chunks.
+   * @param[in] table       The table to process.
+   * @param[in] chunk_size  The maximum number of rows per chunk. Chunks never span multiple table chunks.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status Run(const std::shared_ptr<arrow::Table> &table, int64_t chunk_size);
+
+  /// @brief Return the statistics of the last run.
+  const StreamStatistics &statistics() const { return statistics_; }
+
+  /// The memory type used to make RecordBatches available to the device.
+  MemType mem_type = MemType::ANY;
+  /// The schema the kernel was generated from, to project the RecordBatches on, or nullptr to use all their columns.
+  std::shared_ptr<arrow::Schema> kernel_schema;
+  /// The interval in microseconds at which kernels are polled for completion.
+  unsigned int poll_interval_usec = 0;
+
+ protected:
+  /// @brief Obtain the next RecordBatch from the reader and make it available to the device. Sets *out to nullptr at
+  /// the end of the stream.
+  Status Upload(arrow::RecordBatchReader *reader, std::shared_ptr<StreamBatch> *out);
+  /// @brief Run the kernel on a RecordBatch that was made available to the device.
+  Status Compute(StreamBatch *item);
+  /// @brief Handle the results of a processed RecordBatch, and free its device buffers.
+  Status Readback(StreamBatch *item);
+
+  /// The platform to run on.
+  std::shared_ptr<Platform> platform_;
+  /// The factory for Kernels.
+  KernelFactory kernel_factory_;
+  /// The handler for results.
+  ResultHandler result_handler_;
+  /// Statistics of the last run.
+  StreamStatistics statistics_;
+};
+
+}  // namespace fletcher
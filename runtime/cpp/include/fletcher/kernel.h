@@ -17,6 +17,7 @@
 #include <arrow/api.h>
 #include <fletcher/fletcher.h>
 #include <cstdint>
+#include <functional>
 #include <vector>
 #include <memory>
 
@@ -28,6 +29,9 @@ namespace fletcher {
 /// The Kernel class is used to manage the computational kernel of the accelerator.
 class Kernel {
  public:
+  /// A function that merges the return values of a kernel run over a row range into the accumulated return values.
+  using Combiner = std::function<void(uint32_t *acc0, uint32_t *acc1, uint32_t ret0, uint32_t ret1)>;
+
   /**
    * @brief Construct a new kernel that can operate within a specific context.
    * @param[in] context The context to operate in.
@@ -49,12 +53,15 @@ class Kernel {
 
   /**
    * @brief Set the first (inclusive) and last (exclusive) row to process of some RecordBatch.
+   *
+   * With 32-bit index registers, the range must fit 32 bits. See index_width.
+   *
    * @param[in] recordbatch_index The index of the RecordBatch to set the range for.
    * @param[in] first             The first index of the range (inclusive).
    * @param[in] last              The last index of the range (exclusive).
    * @return Status::OK() if successful, otherwise a descriptive error status.
    */
-  Status SetRange(size_t recordbatch_index, int32_t first, int32_t last);
+  Status SetRange(size_t recordbatch_index, int64_t first, int64_t last);
 
   /**
    * @brief Set custom arguments to the kernel. Writes consecutive MMIO registers starting from custom register offset.
@@ -84,6 +91,21 @@ class Kernel {
    */
   Status GetReturn(uint32_t *ret0, uint32_t *ret1 = nullptr);
 
+  /**
+   * @brief Check whether the kernel stopped because it ran out of space in an output buffer.
+   *
+   * When a kernel runs out of space in a variable-length output buffer, it stops at a row boundary and asserts the
+   * done and overflow flags of the status register. It then reports the number of rows it completed in REG_RETURN0.
+   * Kernels with 64-bit index registers (see index_width) report it in REG_RETURN0 and REG_RETURN1, with the low word
+   * first. The bytes it wrote follow from the offsets of the completed rows. Use Context::Materialize() to read back the
+   * completed rows, and Context::ResumeFrom() to process the remaining rows with larger output buffers.
+   *
+   * @param[out] overflow        Whether the kernel overflowed an output buffer.
+   * @param[out] rows_completed  The number of rows the kernel completed, if it overflowed.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status GetOverflow(bool *overflow, int64_t *rows_completed);
+
   /**
    * @brief Poll (blocking) the done flag of the status register for assertion with an interval.
    * @param[in] poll_interval_usec The interval at which to poll the Kernel.
@@ -99,6 +121,23 @@ class Kernel {
    */
   Status PollUntilDone();
 
+  /**
+   * @brief Run the kernel to completion, over row ranges that fit the device memory budget of the Context.
+   *
+   * If the Context fits its budget, the kernel runs once on the Context itself, which must be enabled. Otherwise, the
+   * rows are partitioned with Context::Partition(). For every range, a Context holding only that range is enabled and
+   * the kernel runs over it, after which its device memory is freed again.
+   *
+   * @param[in]  combine             Merges the return values of a range into the accumulated return values. The
+   *                                 accumulated values start at the return values of the first range. If empty, the
+   *                                 return values of the last range are kept.
+   * @param[out] ret0                The accumulated return value 0.
+   * @param[out] ret1                The accumulated return value 1.
+   * @param[in]  poll_interval_usec  The interval at which to poll the Kernel.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status RunPartitioned(const Combiner &combine, uint32_t *ret0, uint32_t *ret1, unsigned int poll_interval_usec = 0);
+
   /// @brief Return the context of this Kernel.
   std::shared_ptr<Context> context();
 
@@ -117,8 +156,23 @@ class Kernel {
   uint32_t done_status = 1ul << FLETCHER_REG_STATUS_DONE;
   /// Status register done mask bits.
   uint32_t done_status_mask = 1ul << FLETCHER_REG_STATUS_DONE;
+  /// Status register overflow mask bits.
+  uint32_t overflow_status_mask = 1ul << FLETCHER_REG_STATUS_OVERFLOW;
+
+  // Register layout:
+  /// The width of the first and last index registers of the RecordBatches. Kernels generated from schemas with large
+  /// string, large binary or large list fields have 64-bit index registers, each taking two MMIO registers with the low
+  /// word first. All other kernels have 32-bit index registers.
+  uint32_t index_width = 32;
 
  protected:
+  /// @brief Return the number of MMIO registers of a single index register.
+  size_t index_regs() const { return index_width > 32 ? 2 : 1; }
+  /// @brief Write an index to the index register at some MMIO register offset.
+  Status WriteIndex(uint64_t offset, int64_t index);
+  /// @brief Write the device addresses of the buffers of the Context to the Kernel MMIO registers.
+  Status WriteBufferAddresses();
+
   /// Whether RecordBatch metadata was written.
   bool metadata_written = false;
   /// The context that this kernel should operate on.
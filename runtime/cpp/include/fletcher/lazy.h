@@ -0,0 +1,97 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arrow/api.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "fletcher/context.h"
+#include "fletcher/status.h"
+
+namespace fletcher {
+
+/**
+ * @brief A write-mode RecordBatch of a Context, of which every column is read back from the device on first access.
+ *
+ * Consumers that only inspect some columns of a result don't pay for reading back the other columns. Every column is
+ * read back at most once. The LazyRecordBatch keeps the Context, and therefore its device buffers, alive.
+ */
+class LazyRecordBatch {
+ public:
+  /**
+   * @brief Construct a new LazyRecordBatch.
+   * @param[in] context      The Context holding the RecordBatch.
+   * @param[in] batch_index  The index of the write-mode RecordBatch in the Context.
+   * @param[in] num_rows     The number of rows written by the kernel.
+   */
+  LazyRecordBatch(std::shared_ptr<Context> context, size_t batch_index, int64_t num_rows);
+
+  /**
+   * @brief Create a new LazyRecordBatch.
+   * @param[out] out          A pointer to a shared pointer that will own the new LazyRecordBatch.
+   * @param[in]  context      The Context holding the RecordBatch. It must be enabled and the kernel must have finished.
+   * @param[in]  batch_index  The index of the write-mode RecordBatch in the Context.
+   * @param[in]  num_rows     The number of rows written by the kernel. All rows of the RecordBatch if negative.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  static Status Make(std::shared_ptr<LazyRecordBatch> *out,
+                     const std::shared_ptr<Context> &context,
+                     size_t batch_index,
+                     int64_t num_rows = -1);
+
+  /// @brief Return the schema of the RecordBatch.
+  std::shared_ptr<arrow::Schema> schema() const { return schema_; }
+  /// @brief Return the number of rows of the RecordBatch.
+  int64_t num_rows() const { return num_rows_; }
+  /// @brief Return the number of columns of the RecordBatch.
+  int num_columns() const { return schema_->num_fields(); }
+
+  /**
+   * @brief Obtain a column, reading it back from the device if this is the first access.
+   * @param[in]  i    The index of the column.
+   * @param[out] out  The column.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status column(int i, std::shared_ptr<arrow::Array> *out);
+
+  /// @brief Return true if column i was read back already.
+  bool is_materialized(int i) const;
+
+  /**
+   * @brief Obtain the whole RecordBatch, reading back all columns that were not accessed yet.
+   * @param[out] out The RecordBatch.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status ToRecordBatch(std::shared_ptr<arrow::RecordBatch> *out);
+
+ protected:
+  /// The Context holding the device buffers.
+  std::shared_ptr<Context> context_;
+  /// The index of the RecordBatch in the Context.
+  size_t batch_index_;
+  /// The number of rows written by the kernel.
+  int64_t num_rows_;
+  /// The schema of the RecordBatch.
+  std::shared_ptr<arrow::Schema> schema_;
+  /// The columns that were read back, or nullptr.
+  std::vector<std::shared_ptr<arrow::Array>> columns_;
+  /// Protects the columns against concurrent first accesses.
+  mutable std::mutex mutex_;
+};
+
+}  // namespace fletcher
@@ -0,0 +1,240 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fletcher/status.h"
+
+namespace fletcher {
+
+/// A counter that can be incremented concurrently without locks.
+class Counter {
+ public:
+  /// @brief Add a value to the counter.
+  inline void Add(uint64_t value) { value_.fetch_add(value, std::memory_order_relaxed); }
+  /// @brief Return the value of the counter.
+  inline uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+  /// @brief Reset the counter to zero.
+  inline void Reset() { value_.store(0, std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+/// A snapshot of a Histogram.
+struct HistogramSnapshot {
+  /// The name of the histogram.
+  std::string name;
+  /// The number of recorded values.
+  uint64_t count = 0;
+  /// The sum of all recorded values.
+  uint64_t sum = 0;
+  /// The largest recorded value.
+  uint64_t max = 0;
+  /// The number of values per bucket. Bucket 0 holds zeroes, bucket i > 0 holds values in [2^(i-1), 2^i).
+  std::vector<uint64_t> buckets;
+
+  /// @brief Return the mean of the recorded values.
+  double mean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count); }
+  /**
+   * @brief Estimate a quantile of the recorded values.
+   * @param[in] q The quantile, in [0, 1].
+   * @return The upper bound of the bucket that holds the quantile, or the largest recorded value if that is smaller.
+   */
+  uint64_t Quantile(double q) const;
+};
+
+/**
+ * @brief A histogram of unsigned values, with power-of-two buckets, that can be recorded concurrently without locks.
+ *
+ * Values are typically durations in nanoseconds, or numbers of operations.
+ */
+class Histogram {
+ public:
+  /// The number of buckets.
+  static constexpr size_t kNumBuckets = 65;
+
+  Histogram() { Reset(); }
+
+  /// @brief Record a value.
+  void Record(uint64_t value);
+  /// @brief Return a snapshot of the histogram.
+  HistogramSnapshot Snapshot() const;
+  /// @brief Reset the histogram to its empty state.
+  void Reset();
+
+ private:
+  std::atomic<uint64_t> buckets_[kNumBuckets];
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+/// A snapshot of all metrics of the registry.
+struct MetricsSnapshot {
+  /// The time at which the snapshot was taken, in nanoseconds since the epoch of the system clock.
+  uint64_t timestamp = 0;
+  /// The names and values of all counters.
+  std::vector<std::pair<std::string, uint64_t>> counters;
+  /// The snapshots of all histograms.
+  std::vector<HistogramSnapshot> histograms;
+
+  /// @brief Return the value of a counter by its name, or 0 if there is no such counter.
+  uint64_t counter(const std::string &name) const;
+  /// @brief Return a histogram by its name, or an empty histogram if there is no such histogram.
+  HistogramSnapshot histogram(const std::string &name) const;
+  /// @brief Return the snapshot as a JSON object.
+  std::string ToJSON() const;
+};
+
+/**
+ * @brief The registry of the built-in run-time metrics.
+ *
+ * The Platform, Context and Kernel update the metrics of the global registry in their hot paths, such that it can be
+ * queried from a running application with Snapshot(), or dumped to a file periodically with StartDump(). Updates use
+ * relaxed atomics only.
+ *
+ * When the run-time library and the application are compiled with FLETCHER_DISABLE_METRICS defined, the updates are
+ * compiled out, and all metrics remain zero.
+ */
+class Metrics {
+ public:
+  /// @brief Return the global registry.
+  static Metrics &Global();
+
+  /// @brief Return true if the updates of the metrics are compiled in.
+  static constexpr bool enabled() {
+#ifdef FLETCHER_DISABLE_METRICS
+    return false;
+#else
+    return true;
+#endif
+  }
+
+  // Counters:
+  /// Number of MMIO register reads.
+  Counter mmio_reads;
+  /// Number of MMIO register writes.
+  Counter mmio_writes;
+  /// Number of bytes copied from host to device memory, by copies and caching.
+  Counter bytes_host_to_device;
+  /// Number of bytes copied from device to host memory.
+  Counter bytes_device_to_host;
+  /// Number of bytes of host buffers prepared for the device, which may or may not involve a copy.
+  Counter bytes_prepared;
+  /// Number of device memory allocations.
+  Counter device_allocations;
+  /// Number of device memory frees.
+  Counter device_frees;
+  /// Number of kernel launches.
+  Counter kernel_launches;
+
+  // Histograms:
+  /// Time spent enabling a Context, in nanoseconds.
+  Histogram context_enable_ns;
+  /// Time spent starting a Kernel, including writing its metadata, in nanoseconds.
+  Histogram kernel_start_ns;
+  /// Number of MMIO operations of starting a Kernel.
+  Histogram kernel_start_mmio;
+  /// Time spent polling a Kernel until it completes, in nanoseconds.
+  Histogram kernel_completion_ns;
+  /// Number of MMIO reads of polling a Kernel until it completes.
+  Histogram kernel_completion_mmio;
+
+  /// @brief Return a snapshot of all metrics.
+  MetricsSnapshot Snapshot() const;
+
+  /// @brief Reset all metrics to zero.
+  void Reset();
+
+  /**
+   * @brief Start dumping a snapshot of all metrics to a JSON file periodically, in a background thread.
+   *
+   * Every dump replaces the contents of the file atomically. A previous dump is stopped first.
+   *
+   * @param[in] file_name The name of the file.
+   * @param[in] interval  The interval between dumps.
+   * @return Status::OK() if successful, otherwise a descriptive error status.
+   */
+  Status StartDump(const std::string &file_name, std::chrono::milliseconds interval = std::chrono::seconds(1));
+
+  /// @brief Stop dumping, after writing a final snapshot.
+  void StopDump();
+
+  ~Metrics();
+
+ private:
+  Metrics() = default;
+
+  /// @brief Write a snapshot to the dump file.
+  Status Dump();
+
+  std::mutex dump_mutex_;
+  std::condition_variable dump_wake_;
+  std::thread dump_thread_;
+  std::string dump_file_;
+  bool dump_stop_ = false;
+};
+
+/// @brief Return the number of MMIO operations performed by the calling thread.
+inline uint64_t &ThreadMmioOps() {
+  static thread_local uint64_t ops = 0;
+  return ops;
+}
+
+/// Records the time between its construction and destruction in a Histogram.
+class ScopedMetricTimer {
+ public:
+  /// @brief Start timing.
+  explicit ScopedMetricTimer(Histogram *histogram)
+      : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+  /// @brief Stop timing and record the elapsed time in nanoseconds.
+  ~ScopedMetricTimer() {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+    histogram_->Record(static_cast<uint64_t>(elapsed.count()));
+  }
+
+ private:
+  Histogram *histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace fletcher
+
+#ifndef FLETCHER_DISABLE_METRICS
+/// Add a value to a counter of the global metrics registry.
+#define FLETCHER_METRIC_ADD(counter, value) ::fletcher::Metrics::Global().counter.Add(value)
+/// Record a value in a histogram of the global metrics registry.
+#define FLETCHER_METRIC_RECORD(histogram, value) ::fletcher::Metrics::Global().histogram.Record(value)
+/// Record the time until the end of the enclosing scope in a histogram of the global metrics registry.
+#define FLETCHER_METRIC_TIMER(histogram) \
+  ::fletcher::ScopedMetricTimer fletcher_metric_timer_##histogram(&::fletcher::Metrics::Global().histogram)
+/// Count an MMIO operation of the calling thread.
+#define FLETCHER_METRIC_MMIO(counter) (FLETCHER_METRIC_ADD(counter, 1), ::fletcher::ThreadMmioOps()++)
+#else
+// The values are not evaluated, but still referenced to avoid unused variable warnings.
+#define FLETCHER_METRIC_ADD(counter, value) static_cast<void>(sizeof(value))
+#define FLETCHER_METRIC_RECORD(histogram, value) static_cast<void>(sizeof(value))
+#define FLETCHER_METRIC_TIMER(histogram) static_cast<void>(0)
+#define FLETCHER_METRIC_MMIO(counter) static_cast<void>(0)
+#endif
@@ -20,6 +20,7 @@
 #include <string>
 #include <cassert>
 
+#include "fletcher/metrics.h"
 #include "fletcher/status.h"
 
 #if defined(__MACH__)
@@ -72,7 +73,10 @@ class Platform {
    * @param[in] value   Value to write.
    * @return Status::OK() if successful, otherwise a descriptive error status.
    */
-  inline Status WriteMMIO(uint64_t offset, uint32_t value) { return Status(platformWriteMMIO(offset, value)); }
+  inline Status WriteMMIO(uint64_t offset, uint32_t value) {
+    FLETCHER_METRIC_MMIO(mmio_writes);
+    return Status(platformWriteMMIO(offset, value));
+  }
 
   /**
   * @brief Read from an MMIO register.
@@ -80,7 +84,10 @@ class Platform {
   * @param[out] value   Pointer to a value to store the result.
   * @return Status::OK() if successful, otherwise a descriptive error status.
   */
-  inline Status ReadMMIO(uint64_t offset, uint32_t *value) { return Status(platformReadMMIO(offset, value)); }
+  inline Status ReadMMIO(uint64_t offset, uint32_t *value) {
+    FLETCHER_METRIC_MMIO(mmio_reads);
+    return Status(platformReadMMIO(offset, value));
+  }
 
   /**
   * @brief Read 64 bit value from two successive 32 bit MMIO registers. The lower register will go to the lower bits.
@@ -97,6 +104,7 @@ class Platform {
    * @return Status::OK() if successful, otherwise a descriptive error status.
    */
   inline Status DeviceMalloc(da_t *device_address, size_t size) {
+    FLETCHER_METRIC_ADD(device_allocations, 1);
     return Status(platformDeviceMalloc(device_address, size));
   }
 
@@ -105,7 +113,10 @@ class Platform {
    * @param[in] device_address  The device address of the memory region.
    * @return Status::OK() if successful, otherwise a descriptive error status.
    */
-  inline Status DeviceFree(da_t device_address) { return Status(platformDeviceFree(device_address)); }
+  inline Status DeviceFree(da_t device_address) {
+    FLETCHER_METRIC_ADD(device_frees, 1);
+    return Status(platformDeviceFree(device_address));
+  }
 
   /**
    * @brief Copy data from host memory to device memory.
@@ -115,6 +126,7 @@ class Platform {
    * @return Status::OK() if successful, otherwise a descriptive error status.
    */
   inline Status CopyHostToDevice(uint8_t *host_source, da_t device_destination, uint64_t size) {
+    FLETCHER_METRIC_ADD(bytes_host_to_device, size);
     return Status(platformCopyHostToDevice(host_source, device_destination, size));
   }
 
@@ -126,6 +138,7 @@ class Platform {
    * @return Status::OK() if successful, otherwise a descriptive error status.
    */
   inline Status CopyDeviceToHost(da_t device_source, uint8_t *host_destination, uint64_t size) {
+    FLETCHER_METRIC_ADD(bytes_device_to_host, size);
     return Status(platformCopyDeviceToHost(device_source, host_destination, size));
   }
 
@@ -139,6 +152,7 @@ class Platform {
    */
   inline Status PrepareHostBuffer(const uint8_t *host_source, da_t *device_destination, int64_t size, bool *alloced) {
     assert(platformPrepareHostBuffer != nullptr);
+    FLETCHER_METRIC_ADD(bytes_prepared, static_cast<uint64_t>(size));
     int ll_alloced = 0;
     auto stat = platformPrepareHostBuffer(host_source, device_destination, size, &ll_alloced);
     *alloced = ll_alloced == 1;
@@ -154,9 +168,42 @@ class Platform {
   */
   inline Status CacheHostBuffer(const uint8_t *host_source, da_t *device_destination, int64_t size) {
     assert(platformCacheHostBuffer != nullptr);
+    FLETCHER_METRIC_ADD(device_allocations, 1);
+    FLETCHER_METRIC_ADD(bytes_host_to_device, static_cast<uint64_t>(size));
     return Status(platformCacheHostBuffer(host_source, device_destination, size));
   }
 
+  /**
+   * @brief Obtain the capability flags of the platform (see FLETCHER_CAP_* in fletcher.h).
+   *
+   * Reporting capabilities is optional for platforms.
+   *
+   * @param[out] caps The capability flags, or 0 if the platform doesn't report them.
+   * @return True if the platform reported its capabilities, false if they are unknown.
+   */
+  inline bool GetCapabilities(uint64_t *caps) {
+    *caps = 0;
+    if ((platformGetCapabilities == nullptr) || (platformGetCapabilities(caps) != FLETCHER_STATUS_OK)) {
+      *caps = 0;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Return the capability flags of the platform (see FLETCHER_CAP_* in fletcher.h).
+   *
+   * Platforms that don't report their capabilities are assumed to have none. Use GetCapabilities() to tell them apart.
+   */
+  inline uint64_t capabilities() {
+    uint64_t caps = 0;
+    GetCapabilities(&caps);
+    return caps;
+  }
+
+  /// @brief Return true if the device operates in the address space of the host, i.e. it can use host memory directly.
+  inline bool SharesHostAddressSpace() { return (capabilities() & FLETCHER_CAP_SHARED_ADDRESS_SPACE) != 0; }
+
   /**
    * @brief Terminate the platform
    * @return Status::OK() if successful, otherwise a descriptive error status.
@@ -188,6 +235,8 @@ class Platform {
                                          int *alloced) = nullptr;
   fstatus_t (*platformCacheHostBuffer)(const uint8_t *host_source, da_t *device_destination, int64_t size) = nullptr;
   fstatus_t (*platformTerminate)(void *arg) = nullptr;
+  // Optional functions:
+  fstatus_t (*platformGetCapabilities)(uint64_t *capabilities) = nullptr;
 
   /// @brief Attempt to link all functions using a handle obtained by dlopen.
   Status Link(void *handle, bool quiet = true);
@@ -0,0 +1,171 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/c_api.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fletcher/context.h"
+#include "fletcher/executor.h"
+#include "fletcher/kernel.h"
+#include "fletcher/platform.h"
+#include "fletcher/status.h"
+
+struct FletcherHandle {
+  std::shared_ptr<fletcher::Platform> platform;
+  std::shared_ptr<fletcher::Context> context;
+  std::shared_ptr<fletcher::Kernel> kernel;
+  std::vector<uint32_t> arguments;
+  std::string last_error;
+};
+
+namespace {
+
+/// @brief Remember the message of a failure status in the handle, and return the raw status value.
+fstatus_t Check(FletcherHandle *handle, const fletcher::Status &status) {
+  if (status.val != FLETCHER_STATUS_OK) {
+    handle->last_error = status.message;
+  }
+  return status.val;
+}
+
+}  // namespace
+
+extern "C" {
+
+fstatus_t fletcherCreate(const char *platform_name, FletcherHandle **handle) {
+  if (handle == nullptr) {
+    return FLETCHER_STATUS_ERROR;
+  }
+  *handle = nullptr;
+  std::unique_ptr<FletcherHandle> result(new FletcherHandle());
+  fletcher::Status status = fletcher::Status::OK();
+  if (platform_name == nullptr) {
+    status = fletcher::Platform::Make(&result->platform);
+  } else {
+    status = fletcher::Platform::Make(platform_name, &result->platform);
+  }
+  if (!status.ok()) return status.val;
+  status = result->platform->Init();
+  if (!status.ok()) return status.val;
+  status = fletcher::Context::Make(&result->context, result->platform);
+  if (!status.ok()) return status.val;
+  *handle = result.release();
+  return FLETCHER_STATUS_OK;
+}
+
+fstatus_t fletcherQueueArrowArray(FletcherHandle *handle,
+                                  struct ArrowArray *array,
+                                  struct ArrowSchema *schema,
+                                  int cache) {
+  if (handle == nullptr) {
+    return FLETCHER_STATUS_ERROR;
+  }
+  auto mem_type = cache ? fletcher::MemType::CACHE : fletcher::MemType::ANY;
+  return Check(handle, handle->context->QueueArrowArray(array, schema, mem_type));
+}
+
+fstatus_t fletcherEnable(FletcherHandle *handle) {
+  if (handle == nullptr) {
+    return FLETCHER_STATUS_ERROR;
+  }
+  return Check(handle, handle->context->Enable());
+}
+
+fstatus_t fletcherSetArguments(FletcherHandle *handle, const uint32_t *arguments, size_t num_arguments) {
+  if ((handle == nullptr) || ((arguments == nullptr) && (num_arguments > 0))) {
+    return FLETCHER_STATUS_ERROR;
+  }
+  handle->arguments.assign(arguments, arguments + num_arguments);
+  return FLETCHER_STATUS_OK;
+}
+
+fstatus_t fletcherRun(FletcherHandle *handle, uint32_t *return0, uint32_t *return1) {
+  if (handle == nullptr) {
+    return FLETCHER_STATUS_ERROR;
+  }
+  if (handle->kernel == nullptr) {
+    handle->kernel = std::make_shared<fletcher::Kernel>(handle->context);
+  }
+  auto status = handle->kernel->Reset();
+  if (!status.ok()) return Check(handle, status);
+  if (!handle->arguments.empty()) {
+    status = handle->kernel->SetArguments(handle->arguments);
+    if (!status.ok()) return Check(handle, status);
+  }
+  status = handle->kernel->Start();
+  if (!status.ok()) return Check(handle, status);
+  status = handle->kernel->PollUntilDone();
+  if (!status.ok()) return Check(handle, status);
+  uint32_t ret0 = 0;
+  uint32_t ret1 = 0;
+  status = handle->kernel->GetReturn(&ret0, &ret1);
+  if (!status.ok()) return Check(handle, status);
+  if (return0 != nullptr) *return0 = ret0;
+  if (return1 != nullptr) *return1 = ret1;
+  return FLETCHER_STATUS_OK;
+}
+
+fstatus_t fletcherExportRecordBatch(FletcherHandle *handle,
+                                    size_t batch_index,
+                                    int64_t num_rows,
+                                    struct ArrowArray *array,
+                                    struct ArrowSchema *schema) {
+  if (handle == nullptr) {
+    return FLETCHER_STATUS_ERROR;
+  }
+  return Check(handle, handle->context->ExportRecordBatch(batch_index, array, schema, num_rows));
+}
+
+fstatus_t fletcherRunArrowArrayStream(FletcherHandle *handle,
+                                      struct ArrowArrayStream *stream,
+                                      FletcherStreamCallback callback,
+                                      void *user_data) {
+  if (handle == nullptr) {
+    return FLETCHER_STATUS_ERROR;
+  }
+  auto arguments = handle->arguments;
+  fletcher::StreamExecutor::KernelFactory factory = [arguments](const std::shared_ptr<fletcher::Context> &context) {
+    auto kernel = std::make_shared<fletcher::Kernel>(context);
+    if (!arguments.empty()) {
+      kernel->SetArguments(arguments);
+    }
+    return kernel;
+  };
+  fletcher::StreamExecutor::ResultHandler handler = nullptr;
+  if (callback != nullptr) {
+    handler = [callback, user_data](const fletcher::StreamBatch &batch) {
+      return fletcher::Status(callback(batch.index, batch.return0, batch.return1, user_data));
+    };
+  }
+  std::shared_ptr<fletcher::StreamExecutor> executor;
+  auto status = fletcher::StreamExecutor::Make(&executor, handle->platform, factory, handler);
+  if (!status.ok()) return Check(handle, status);
+  return Check(handle, executor->Run(stream));
+}
+
+const char *fletcherGetLastError(FletcherHandle *handle) {
+  if (handle == nullptr) {
+    return "";
+  }
+  return handle->last_error.c_str();
+}
+
+void fletcherDestroy(FletcherHandle *handle) {
+  delete handle;
+}
+
+}  // extern "C"
@@ -0,0 +1,147 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/catalog.h"
+
+#include <arrow/api.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fletcher {
+
+Status DeviceCatalog::Make(std::shared_ptr<DeviceCatalog> *catalog, const std::shared_ptr<Platform> &platform) {
+  if (platform == nullptr) {
+    return Status::ERROR("Platform is nullptr.");
+  }
+  *catalog = std::make_shared<DeviceCatalog>(platform);
+  return Status::OK();
+}
+
+Status DeviceCatalog::Register(const std::string &name,
+                               const std::shared_ptr<arrow::Table> &table,
+                               std::shared_ptr<CatalogEntry> *handle,
+                               MemType mem_type) {
+  if (table == nullptr) {
+    return Status::ERROR("Table is nullptr.");
+  }
+  if (GetSchemaOptions(*table->schema()).mode != Mode::READ) {
+    return Status::ERROR("Only tables with a read-mode schema can be registered.");
+  }
+
+  // Combine the chunks of the table into a single RecordBatch.
+  auto combined = table->CombineChunks();
+  if (!combined.ok()) {
+    return Status::ERROR("Could not combine chunks of table " + name + ". ARROW:[" + combined.status().ToString() + "]");
+  }
+  std::vector<std::shared_ptr<arrow::Array>> columns;
+  for (const auto &column : combined.ValueOrDie()->columns()) {
+    if (column->num_chunks() == 1) {
+      columns.push_back(column->chunk(0));
+    } else {
+      auto empty = arrow::MakeArrayOfNull(column->type(), 0);
+      if (!empty.ok()) {
+        return Status::ERROR("Could not create empty column. ARROW:[" + empty.status().ToString() + "]");
+      }
+      columns.push_back(empty.ValueOrDie());
+    }
+  }
+  auto batch = arrow::RecordBatch::Make(table->schema(), table->num_rows(), columns);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.count(name) > 0) {
+    return Status::ERROR("A table named " + name + " is registered already.");
+  }
+
+  std::shared_ptr<Context> context;
+  auto status = Context::Make(&context, platform_);
+  if (!status.ok()) return status;
+  status = context->QueueRecordBatch(batch, mem_type);
+  if (!status.ok()) return status;
+  if ((capacity_ > 0) && (BytesResident() + context->GetQueueSize() > capacity_)) {
+    status = Status::DEVICE_OUT_OF_MEMORY();
+    status.message = "Table " + name + " (" + std::to_string(context->GetQueueSize()) + " bytes) exceeds the "
+        "remaining capacity of the device catalog.";
+    return status;
+  }
+  status = context->Enable();
+  if (!status.ok()) return status;
+
+  auto entry = std::make_shared<CatalogEntry>(name, context);
+  entries_[name] = entry;
+  *handle = entry;
+  FLETCHER_LOG(DEBUG, "Registered table " << name << " (" << entry->size() << " bytes) in the device catalog.");
+  return Status::OK();
+}
+
+Status DeviceCatalog::Lookup(const std::string &name, std::shared_ptr<CatalogEntry> *handle) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(name);
+  if (it == entries_.end()) {
+    return Status::ERROR("No table named " + name + " is registered.");
+  }
+  *handle = it->second;
+  return Status::OK();
+}
+
+Status DeviceCatalog::Evict(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(name);
+  if (it == entries_.end()) {
+    return Status::ERROR("No table named " + name + " is registered.");
+  }
+  if (it->second.use_count() > 1) {
+    FLETCHER_LOG(DEBUG, "Evicted table " << name << " is still in use; its device memory is freed after last use.");
+    evicted_.push_back(it->second);
+  }
+  entries_.erase(it);
+  return Status::OK();
+}
+
+std::vector<std::string> DeviceCatalog::names() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> result;
+  for (const auto &e : entries_) {
+    result.push_back(e.first);
+  }
+  return result;
+}
+
+size_t DeviceCatalog::bytes_resident() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return BytesResident();
+}
+
+size_t DeviceCatalog::BytesResident() const {
+  size_t result = 0;
+  for (const auto &e : entries_) {
+    result += e.second->size();
+  }
+  // Forget evicted entries that are no longer in use.
+  evicted_.erase(std::remove_if(evicted_.begin(), evicted_.end(),
+                                [](const std::weak_ptr<CatalogEntry> &e) { return e.expired(); }),
+                 evicted_.end());
+  for (const auto &e : evicted_) {
+    auto entry = e.lock();
+    if (entry != nullptr) {
+      result += entry->size();
+    }
+  }
+  return result;
+}
+
+}  // namespace fletcher
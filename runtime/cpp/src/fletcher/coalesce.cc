@@ -0,0 +1,111 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/coalesce.h"
+
+#include <arrow/api.h>
+#include <arrow/array/concatenate.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fletcher {
+
+Status BatchCoalescer::Make(std::shared_ptr<BatchCoalescer> *coalescer, const std::shared_ptr<arrow::Schema> &schema) {
+  if (schema == nullptr) {
+    return Status::ERROR("Schema is nullptr.");
+  }
+  *coalescer = std::make_shared<BatchCoalescer>(schema);
+  return Status::OK();
+}
+
+Status BatchCoalescer::Append(const std::shared_ptr<arrow::RecordBatch> &batch) {
+  if (batch == nullptr) {
+    return Status::ERROR("RecordBatch is nullptr.");
+  }
+  if (!batch->schema()->Equals(*schema_, false)) {
+    return Status::ERROR("Schema of RecordBatch " + std::to_string(batches_.size())
+                             + " does not match the schema of the coalescer.");
+  }
+  if (offsets_.empty()) {
+    offsets_.push_back(0);
+  }
+  batches_.push_back(batch);
+  offsets_.push_back(offsets_.back() + batch->num_rows());
+  return Status::OK();
+}
+
+Status BatchCoalescer::Finish(std::shared_ptr<arrow::RecordBatch> *out) const {
+  if (batches_.size() == 1) {
+    *out = arrow::RecordBatch::Make(schema_, batches_[0]->num_rows(), batches_[0]->columns());
+    return Status::OK();
+  }
+  std::vector<std::shared_ptr<arrow::Array>> columns;
+  for (int c = 0; c < schema_->num_fields(); c++) {
+    arrow::ArrayVector chunks;
+    for (const auto &batch : batches_) {
+      chunks.push_back(batch->column(c));
+    }
+    std::shared_ptr<arrow::Array> column;
+    if (chunks.empty()) {
+      auto result = arrow::MakeArrayOfNull(schema_->field(c)->type(), 0);
+      if (!result.ok()) {
+        return Status::ERROR("Could not create empty column. ARROW:[" + result.status().ToString() + "]");
+      }
+      column = result.ValueOrDie();
+    } else {
+      // Concatenation rebases the offsets and realigns the validity bitmaps of every chunk.
+      auto result = arrow::Concatenate(chunks);
+      if (!result.ok()) {
+        return Status::ERROR("Could not concatenate column " + schema_->field(c)->name() + ". ARROW:["
+                                 + result.status().ToString() + "]");
+      }
+      column = result.ValueOrDie();
+    }
+    columns.push_back(column);
+  }
+  *out = arrow::RecordBatch::Make(schema_, num_rows(), columns);
+  return Status::OK();
+}
+
+Status BatchCoalescer::Locate(int64_t row, size_t *batch_index, int64_t *batch_row) const {
+  if ((row < 0) || (row >= num_rows())) {
+    return Status::ERROR("Row " + std::to_string(row) + " out of bounds.");
+  }
+  // Find the last source RecordBatch starting at or before the row. Empty RecordBatches are skipped this way.
+  auto it = std::upper_bound(offsets_.begin(), offsets_.end(), row) - 1;
+  *batch_index = static_cast<size_t>(it - offsets_.begin());
+  *batch_row = row - *it;
+  return Status::OK();
+}
+
+Status BatchCoalescer::Split(const std::shared_ptr<arrow::RecordBatch> &rows,
+                             std::vector<std::shared_ptr<arrow::RecordBatch>> *out) const {
+  if (rows == nullptr) {
+    return Status::ERROR("RecordBatch is nullptr.");
+  }
+  if (rows->num_rows() != num_rows()) {
+    return Status::ERROR("RecordBatch has " + std::to_string(rows->num_rows()) + " rows, but "
+                             + std::to_string(num_rows()) + " rows were coalesced.");
+  }
+  out->clear();
+  for (size_t i = 0; i < batches_.size(); i++) {
+    out->push_back(rows->Slice(offsets_[i], offsets_[i + 1] - offsets_[i]));
+  }
+  return Status::OK();
+}
+
+}  // namespace fletcher
@@ -13,11 +13,23 @@
 // limitations under the License.
 
 #include <arrow/api.h>
+#include <arrow/c/bridge.h>
 #include <fletcher/common.h>
 #include <vector>
 #include <memory>
+#include <future>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <cstring>
+#include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "fletcher/context.h"
+#include "fletcher/catalog.h"
 
 namespace fletcher {
 
@@ -29,6 +41,9 @@ Status Context::Make(std::shared_ptr<Context> *context, const std::shared_ptr<Pl
 Context::~Context() {
   Status status;
   FLETCHER_LOG(DEBUG, "Destructing Context...");
+  if (placement_statistics_.promotions > 0) {
+    FLETCHER_LOG(DEBUG, "Placement statistics:\n" << placement_statistics_.ToString());
+  }
   for (const auto &buf : device_buffers_) {
     if (buf.was_alloced) {
       status = platform_->DeviceFree(buf.device_address);
@@ -38,90 +53,1025 @@ Context::~Context() {
       }
     }
   }
+  if (arena_ != D_NULLPTR) {
+    status = platform_->DeviceFree(arena_);
+    if (!status.ok()) {
+      FLETCHER_LOG(ERROR, "Could not properly free context. Device memory may be corrupted. "
+                          "Status: " + status.message);
+    }
+  }
 }
 
 Status Context::Enable() {
+  FLETCHER_METRIC_TIMER(context_enable_ns);
   auto num_batches = host_batches_.size();
   // Sanity check
-  assert(num_batches == host_batch_desc_.size());
+  assert(num_batches == host_batch_layout_.size());
   assert(num_batches == host_batch_memtype_.size());
 
   FLETCHER_LOG(DEBUG, "Enabling context for " << num_batches << " queued RecordBatch(es)");
 
+  if ((arena_ != D_NULLPTR) || !device_buffers_.empty()) {
+    return Status::ERROR("Context is enabled already.");
+  }
+
+  if (!FitsMemoryBudget()) {
+    auto status = Status::DEVICE_OUT_OF_MEMORY();
+    status.message = "Queued RecordBatches (" + std::to_string(GetUploadSize()) + " bytes) exceed the device memory "
+        "budget (" + std::to_string(memory_budget_) + " bytes). Use Kernel::RunPartitioned().";
+    return status;
+  }
+
+  uint64_t capabilities = 0;
+  bool capabilities_known = platform_->GetCapabilities(&capabilities);
+  bool shared_address_space = (capabilities & FLETCHER_CAP_SHARED_ADDRESS_SPACE) != 0;
+
   // Loop over all batches queued on host
   for (size_t i = 0; i < num_batches; i++) {
-    auto rbd = host_batch_desc_[i];
+    if (host_batch_entry_[i] != nullptr) {
+      // RecordBatches of the device catalog are resident on the device already.
+      AppendCatalogBuffers(i);
+      continue;
+    }
+    auto mode = host_batch_layout_[i]->mode();
     auto type = host_batch_memtype_[i];
-    for (const auto &f : rbd.fields) {
-      for (const auto &b : f.buffers) {
-        fletcher::Status status;
-        DeviceBuffer device_buf(b.raw_buffer_, b.size_, type, rbd.mode);
-        if (type == MemType::ANY) {
-          status = platform_->PrepareHostBuffer(device_buf.host_address,
-                                                &device_buf.device_address,
-                                                device_buf.size,
-                                                &device_buf.was_alloced);
-        } else if (type == MemType::CACHE) {
+    for (const auto &b : host_batch_buffers_[i]) {
+      fletcher::Status status;
+      DeviceBuffer device_buf(b.data, b.size, type, mode);
+      if (mode == Mode::WRITE) {
+        // The kernel overwrites output buffers, so their host contents don't have to be transferred.
+        status = PrepareOutputBuffer(&device_buf, capabilities_known, shared_address_space);
+      } else if ((type == MemType::ANY) || (type == MemType::AUTO)) {
+        status = platform_->PrepareHostBuffer(device_buf.host_address,
+                                              &device_buf.device_address,
+                                              device_buf.size,
+                                              &device_buf.was_alloced);
+      } else if (type == MemType::CACHE) {
+        if ((transfer_chunk_size_ > 0) && (static_cast<size_t>(device_buf.size) > transfer_chunk_size_)) {
+          status = CacheHostBufferChunked(&device_buf);
+        } else {
           status = platform_->CacheHostBuffer(device_buf.host_address,
                                               &device_buf.device_address,
                                               device_buf.size);
-          // Cache always allocates on device.
-          device_buf.was_alloced = true;
-        } else {
-          status = Status::ERROR("Invalid / unsupported MemType.");
         }
-        if (!status.ok()) {
-          return status;
-        }
-        device_buffers_.push_back(device_buf);
+        // Cache always allocates on device.
+        device_buf.was_alloced = true;
+      } else {
+        status = Status::ERROR("Invalid / unsupported MemType.");
+      }
+      if (!status.ok()) {
+        return status;
+      }
+      device_buffers_.push_back(device_buf);
+    }
+  }
+
+  FLETCHER_LOG(DEBUG, "Context contains " << device_buffers_.size() << " device buffer(s).");
+  return Status::OK();
+}
+
+Status Context::EnablePacked(int64_t alignment) {
+  FLETCHER_METRIC_TIMER(context_enable_ns);
+  if (alignment <= 0) {
+    return Status::ERROR("Alignment must be positive.");
+  }
+  if ((arena_ != D_NULLPTR) || !device_buffers_.empty()) {
+    return Status::ERROR("Context is enabled already.");
+  }
+
+  // Determine the place of every buffer in the arena.
+  std::vector<DeviceBuffer> buffers;
+  std::vector<int64_t> offsets;
+  int64_t size = 0;
+  for (size_t i = 0; i < host_batches_.size(); i++) {
+    auto mode = host_batch_layout_[i]->mode();
+    for (const auto &b : host_batch_buffers_[i]) {
+      buffers.emplace_back(b.data, b.size, MemType::CACHE, mode);
+      if (host_batch_entry_[i] != nullptr) {
+        // RecordBatches of the device catalog are resident on the device already, so they take no arena space.
+        offsets.push_back(-1);
+        continue;
+      }
+      offsets.push_back(size);
+      size += (b.size + alignment - 1) / alignment * alignment;
+    }
+  }
+  // The padding of the buffers counts towards the budget as well.
+  if ((memory_budget_ > 0) && (static_cast<size_t>(size) > memory_budget_)) {
+    auto status = Status::DEVICE_OUT_OF_MEMORY();
+    status.message = "Arena of queued RecordBatches (" + std::to_string(size) + " bytes) exceeds the device memory "
+        "budget (" + std::to_string(memory_budget_) + " bytes). Use Kernel::RunPartitioned().";
+    return status;
+  }
+  FLETCHER_LOG(DEBUG, "Enabling context for " << host_batches_.size() << " queued RecordBatch(es) in an arena of "
+                                              << size << " bytes.");
+  if (size > 0) {
+    // Gather the contents of all input buffers in a staging buffer.
+    auto result = arrow::AllocateBuffer(size);
+    if (!result.ok()) {
+      return Status::ERROR("Could not allocate staging buffer. ARROW:[" + result.status().ToString() + "]");
+    }
+    std::shared_ptr<arrow::Buffer> staging = std::move(result).ValueOrDie();
+    std::memset(staging->mutable_data(), 0, staging->size());
+    for (size_t i = 0; i < buffers.size(); i++) {
+      if ((offsets[i] >= 0) && (buffers[i].mode == Mode::READ) && (buffers[i].host_address != nullptr)
+          && (buffers[i].size > 0)) {
+        std::memcpy(staging->mutable_data() + offsets[i], buffers[i].host_address, buffers[i].size);
       }
     }
+
+    auto status = platform_->DeviceMalloc(&arena_, size);
+    if (!status.ok()) {
+      arena_ = D_NULLPTR;
+      return status;
+    }
+    status = platform_->CopyHostToDevice(staging->mutable_data(), arena_, size);
+    if (!status.ok()) return status;
   }
 
+  // The buffers are part of the arena, so they are not freed separately.
+  size_t b = 0;
+  for (size_t i = 0; i < host_batches_.size(); i++) {
+    if (host_batch_entry_[i] != nullptr) {
+      AppendCatalogBuffers(i);
+      b += host_batch_entry_[i]->context()->num_buffers();
+      continue;
+    }
+    for (size_t j = 0; j < host_batch_buffers_[i].size(); j++, b++) {
+      if (arena_ != D_NULLPTR) {
+        buffers[b].device_address = arena_ + offsets[b];
+        buffers[b].available_to_device = true;
+      }
+      device_buffers_.push_back(buffers[b]);
+    }
+  }
   FLETCHER_LOG(DEBUG, "Context contains " << device_buffers_.size() << " device buffer(s).");
   return Status::OK();
 }
 
+double PlacementModel::SavedPerLaunch(int64_t size) const {
+  return static_cast<double>(size) / host_access_bandwidth - static_cast<double>(size) / device_access_bandwidth;
+}
+
+double PlacementModel::TransferTime(int64_t size) const {
+  return static_cast<double>(size) / transfer_bandwidth;
+}
+
+bool PlacementModel::ShouldPromote(int64_t size, uint64_t launches) const {
+  // The reuse observed so far is the best estimate of the reuse to come.
+  auto saved = SavedPerLaunch(size);
+  return (saved > 0.0) && (static_cast<double>(launches) * saved > TransferTime(size));
+}
+
+std::string PlacementStatistics::ToString() const {
+  std::stringstream ss;
+  ss << "Promotions     : " << promotions << "\n"
+     << "Demotions      : " << demotions << "\n"
+     << "Bytes promoted : " << bytes_promoted << "\n"
+     << "Saved (est.) s : " << seconds_saved << "\n";
+  return ss.str();
+}
+
+Status Context::RecordLaunch(bool *moved) {
+  *moved = false;
+  // Count the launch on all buffers that are subject to placement. Buffers that were not mapped directly to host
+  // memory are in on-board memory already.
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < device_buffers_.size(); i++) {
+    auto &buf = device_buffers_[i];
+    if ((buf.memory != MemType::AUTO) || (buf.mode != Mode::READ)) {
+      continue;
+    }
+    buf.launches++;
+    if (buf.promoted) {
+      placement_statistics_.seconds_saved += placement_model_.SavedPerLaunch(buf.size);
+    } else if (!buf.was_alloced && placement_model_.ShouldPromote(buf.size, buf.launches)) {
+      candidates.push_back(i);
+    }
+  }
+  if (candidates.empty()) {
+    return Status::OK();
+  }
+
+  // Promote the buffers with the most to gain first.
+  std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) {
+    const auto &x = device_buffers_[a];
+    const auto &y = device_buffers_[b];
+    return x.launches * placement_model_.SavedPerLaunch(x.size) > y.launches * placement_model_.SavedPerLaunch(y.size);
+  });
+  for (auto i : candidates) {
+    auto &buf = device_buffers_[i];
+    auto gain = static_cast<double>(buf.launches) * placement_model_.SavedPerLaunch(buf.size);
+
+    // Under memory pressure, make room by demoting promoted buffers that gain less.
+    auto fits = [this](int64_t size) {
+      if (memory_budget_ == 0) return true;
+      size_t used = 0;
+      for (const auto &b : device_buffers_) {
+        if (b.was_alloced) used += b.size;
+      }
+      return used + size <= memory_budget_;
+    };
+    while (!fits(buf.size)) {
+      size_t victim = device_buffers_.size();
+      double victim_gain = gain;
+      for (size_t v = 0; v < device_buffers_.size(); v++) {
+        const auto &b = device_buffers_[v];
+        auto b_gain = static_cast<double>(b.launches) * placement_model_.SavedPerLaunch(b.size);
+        if (b.promoted && (b_gain < victim_gain)) {
+          victim = v;
+          victim_gain = b_gain;
+        }
+      }
+      if (victim == device_buffers_.size()) {
+        break;
+      }
+      auto status = Demote(&device_buffers_[victim]);
+      if (!status.ok()) return status;
+      *moved = true;
+    }
+    if (!fits(buf.size)) {
+      continue;
+    }
+
+    da_t address = D_NULLPTR;
+    auto status = platform_->CacheHostBuffer(buf.host_address, &address, buf.size);
+    if (status == Status::DEVICE_OUT_OF_MEMORY()) {
+      FLETCHER_LOG(DEBUG, "Could not promote buffer of " << buf.size << " bytes: device out of memory.");
+      continue;
+    } else if (!status.ok()) {
+      return status;
+    }
+    FLETCHER_LOG(DEBUG, "Promoted buffer of " << buf.size << " bytes after " << buf.launches << " launches.");
+    buf.device_address = address;
+    buf.was_alloced = true;
+    buf.promoted = true;
+    placement_statistics_.promotions++;
+    placement_statistics_.bytes_promoted += buf.size;
+    // This launch already benefits from the promotion, but the transfer must be paid for.
+    placement_statistics_.seconds_saved += placement_model_.SavedPerLaunch(buf.size)
+        - placement_model_.TransferTime(buf.size);
+    *moved = true;
+  }
+  return Status::OK();
+}
+
+Status Context::Demote(DeviceBuffer *buffer) {
+  auto status = platform_->DeviceFree(buffer->device_address);
+  if (!status.ok()) return status;
+  bool alloced = false;
+  status = platform_->PrepareHostBuffer(buffer->host_address, &buffer->device_address, buffer->size, &alloced);
+  buffer->was_alloced = alloced;
+  buffer->promoted = false;
+  placement_statistics_.demotions++;
+  FLETCHER_LOG(DEBUG, "Demoted buffer of " << buffer->size << " bytes due to memory pressure.");
+  return status;
+}
+
+Status Context::CacheHostBufferChunked(DeviceBuffer *buffer) {
+  auto status = platform_->DeviceMalloc(&buffer->device_address, buffer->size);
+  if (!status.ok()) return status;
+  auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  auto chunk = static_cast<int64_t>(transfer_chunk_size_);
+  for (int64_t offset = 0; offset < buffer->size; offset += chunk) {
+    auto size = std::min(chunk, buffer->size - offset);
+    auto next = offset + size;
+    if (next < buffer->size) {
+      // Let the kernel fetch the next chunk while the current one is transferred. This matters when the host buffer
+      // lives in a memory-mapped file that is not in the page cache yet, and is harmless otherwise.
+      auto begin = reinterpret_cast<uintptr_t>(buffer->host_address + next);
+      auto aligned = begin / page * page;
+      auto length = std::min(chunk, buffer->size - next) + static_cast<int64_t>(begin - aligned);
+      posix_madvise(reinterpret_cast<void *>(aligned), static_cast<size_t>(length), POSIX_MADV_WILLNEED);
+    }
+    // The platform interface takes a mutable source pointer, but never writes to it.
+    status = platform_->CopyHostToDevice(const_cast<uint8_t *>(buffer->host_address + offset),
+                                         buffer->device_address + offset,
+                                         size);
+    if (!status.ok()) {
+      platform_->DeviceFree(buffer->device_address);
+      return status;
+    }
+  }
+  return Status::OK();
+}
+
+Status Context::PrepareOutputBuffer(DeviceBuffer *buffer, bool capabilities_known, bool shared_address_space) {
+  if ((buffer->memory != MemType::CACHE) && shared_address_space) {
+    // The kernel can write to the host buffer directly.
+    buffer->device_address = reinterpret_cast<da_t>(buffer->host_address);
+    buffer->was_alloced = false;
+    return Status::OK();
+  }
+  if ((buffer->memory != MemType::CACHE) && !capabilities_known) {
+    // Only the platform knows whether the kernel can write to the host buffer directly.
+    return platform_->PrepareHostBuffer(buffer->host_address, &buffer->device_address, buffer->size,
+                                        &buffer->was_alloced);
+  }
+  auto status = platform_->DeviceMalloc(&buffer->device_address, buffer->size);
+  buffer->was_alloced = status.ok();
+  return status;
+}
+
+/// The maximum number of buffer layouts that are cached.
+static constexpr size_t kMaxCachedLayouts = 64;
+
+/**
+ * @brief Obtain the buffer layout of RecordBatches with some schema, projected on a kernel schema if it is not nullptr.
+ *
+ * Consecutive RecordBatches of a stream, and slices of a RecordBatch, share the same schema object. Their layout is
+ * compiled once and cached. The cache holds on to the schemas, so the addresses used as keys are never reused. The
+ * Fletcher metadata of the schemas is validated when the layout is compiled.
+ */
+static Status GetBufferLayout(const std::shared_ptr<arrow::Schema> &batch_schema,
+                              const std::shared_ptr<arrow::Schema> &kernel_schema,
+                              std::shared_ptr<const BufferLayout> *out) {
+  struct CachedLayout {
+    std::shared_ptr<arrow::Schema> batch_schema;
+    std::shared_ptr<arrow::Schema> kernel_schema;
+    std::shared_ptr<const BufferLayout> layout;
+  };
+  static std::mutex mutex;
+  static std::deque<CachedLayout> cache;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto &entry : cache) {
+    if ((entry.batch_schema == batch_schema) && (entry.kernel_schema == kernel_schema)) {
+      *out = entry.layout;
+      return Status::OK();
+    }
+  }
+  std::string error;
+  if (!ValidateOptions(kernel_schema != nullptr ? *kernel_schema : *batch_schema, &error)) {
+    return Status::ERROR("Invalid Fletcher metadata. " + error);
+  }
+  std::shared_ptr<BufferLayout> layout;
+  if (!BufferLayout::Make(*batch_schema, kernel_schema.get(), &layout)) {
+    if (kernel_schema != nullptr) {
+      return Status::ERROR("RecordBatch does not contain all fields of kernel schema "
+                               + GetSchemaOptions(*kernel_schema).name + " with matching types.");
+    }
+    return Status::ERROR("Could not analyze RecordBatch.");
+  }
+  if (cache.size() == kMaxCachedLayouts) {
+    cache.pop_front();
+  }
+  cache.push_back({batch_schema, kernel_schema, layout});
+  *out = layout;
+  return Status::OK();
+}
+
 Status Context::QueueRecordBatch(const std::shared_ptr<arrow::RecordBatch> &record_batch, MemType mem_type) {
+  return QueueRecordBatch(record_batch, nullptr, mem_type);
+}
+
+Status Context::QueueRecordBatch(const std::shared_ptr<arrow::RecordBatch> &record_batch,
+                                 const std::shared_ptr<arrow::Schema> &kernel_schema,
+                                 MemType mem_type) {
   // Sanity check the recordbatch
   if (record_batch == nullptr) {
     return Status::ERROR("RecordBatch is nullptr.");
   }
 
-  host_batches_.push_back(record_batch);
+  // Obtain the buffer layout of the RecordBatch, projected on the kernel schema if there is any.
+  std::shared_ptr<const BufferLayout> layout;
+  auto status = GetBufferLayout(record_batch->schema(), kernel_schema, &layout);
+  if (!status.ok()) return status;
+  std::vector<BufferRef> buffers;
+  if (!layout->Extract(*record_batch, &buffers)) {
+    return Status::ERROR("Could not analyze RecordBatch.");
+  }
 
-  // Create a description of the RecordBatch
-  RecordBatchDescription rbd;
-  RecordBatchAnalyzer rba(&rbd);
-  rba.Analyze(*record_batch);
-  host_batch_desc_.push_back(rbd);
+  host_batches_.push_back(record_batch);
+  host_batch_layout_.push_back(layout);
+  host_batch_buffers_.push_back(std::move(buffers));
+  host_batch_schema_.push_back(kernel_schema);
 
   // Put the desired memory type of the RecordBatch
   host_batch_memtype_.push_back(mem_type);
+  host_batch_entry_.push_back(nullptr);
 
   return Status::OK();
 }
 
+Status Context::QueueArrowArray(struct ArrowArray *array, struct ArrowSchema *schema, MemType mem_type) {
+  if ((array == nullptr) || (schema == nullptr)) {
+    return Status::ERROR("ArrowArray or ArrowSchema is nullptr.");
+  }
+  auto result = arrow::ImportRecordBatch(array, schema);
+  if (!result.ok()) {
+    return Status::ERROR("Could not import ArrowArray. ARROW:[" + result.status().ToString() + "]");
+  }
+  return QueueRecordBatch(result.ValueOrDie(), mem_type);
+}
+
+Status Context::QueueCatalogEntry(const std::shared_ptr<CatalogEntry> &entry) {
+  if (entry == nullptr) {
+    return Status::ERROR("Catalog entry is nullptr.");
+  }
+  host_batches_.push_back(entry->batch());
+  host_batch_layout_.push_back(entry->context()->host_batch_layout_[0]);
+  host_batch_buffers_.push_back(entry->context()->host_batch_buffers_[0]);
+  host_batch_schema_.push_back(entry->context()->host_batch_schema_[0]);
+  host_batch_memtype_.push_back(MemType::CACHE);
+  host_batch_entry_.push_back(entry);
+  return Status::OK();
+}
+
+size_t Context::GetUploadSize() const {
+  size_t size = 0;
+  for (size_t i = 0; i < host_batch_buffers_.size(); i++) {
+    if (host_batch_entry_[i] != nullptr) {
+      continue;
+    }
+    for (const auto &buf : host_batch_buffers_[i]) {
+      size += buf.size;
+    }
+  }
+  return size;
+}
+
+bool Context::FitsMemoryBudget() const {
+  return (memory_budget_ == 0) || (GetUploadSize() <= memory_budget_);
+}
+
+Status Context::AppendCatalogBuffers(size_t i) {
+  // The buffers are owned by the catalog entry, so this Context must not free them.
+  for (auto buf : host_batch_entry_[i]->context()->device_buffers_) {
+    buf.was_alloced = false;
+    device_buffers_.push_back(buf);
+  }
+  return Status::OK();
+}
+
 uint64_t Context::num_buffers() const {
   uint64_t ret = 0;
-  for (const auto &rbd : host_batch_desc_) {
-    for (const auto &f : rbd.fields) {
-      ret += f.buffers.size();
-    }
+  for (const auto &buffers : host_batch_buffers_) {
+    ret += buffers.size();
   }
   return ret;
 }
 
 size_t Context::GetQueueSize() const {
   size_t size = 0;
-  for (const auto &desc : host_batch_desc_) {
-    for (const auto &f : desc.fields) {
-      for (const auto &buf : f.buffers) {
-        size += buf.size_;
-      }
+  for (const auto &buffers : host_batch_buffers_) {
+    for (const auto &buf : buffers) {
+      size += buf.size;
     }
   }
   return size;
 }
 
+Status Context::Slice(int64_t first, int64_t last, std::shared_ptr<Context> *out) const {
+  std::shared_ptr<Context> sliced;
+  auto status = Context::Make(&sliced, platform_);
+  if (!status.ok()) return status;
+  sliced->memory_budget_ = memory_budget_;
+  for (size_t i = 0; i < host_batches_.size(); i++) {
+    if (host_batch_entry_[i] != nullptr) {
+      // Catalog RecordBatches are not sliced; they are resident on the device as a whole.
+      status = sliced->QueueCatalogEntry(host_batch_entry_[i]);
+      if (!status.ok()) return status;
+      continue;
+    }
+    const auto &batch = host_batches_[i];
+    if ((first < 0) || (first > last) || (last > batch->num_rows())) {
+      return Status::ERROR("Row range [" + std::to_string(first) + ", " + std::to_string(last)
+                               + ") out of bounds for RecordBatch " + std::to_string(i));
+    }
+    status = sliced->QueueRecordBatch(batch->Slice(first, last - first), host_batch_schema_[i], host_batch_memtype_[i]);
+    if (!status.ok()) return status;
+  }
+  *out = sliced;
+  return Status::OK();
+}
+
+Status Context::Partition(std::vector<std::pair<int64_t, int64_t>> *ranges) const {
+  ranges->clear();
+  int64_t num_rows = -1;
+  for (size_t i = 0; i < host_batches_.size(); i++) {
+    if (host_batch_entry_[i] != nullptr) {
+      continue;
+    }
+    if (num_rows < 0) {
+      num_rows = host_batches_[i]->num_rows();
+    }
+    if (host_batch_layout_[i]->mode() != Mode::READ) {
+      return Status::ERROR("Only Contexts with read-mode RecordBatches can be partitioned.");
+    }
+    if (host_batches_[i]->num_rows() != num_rows) {
+      return Status::ERROR("Only Contexts with RecordBatches of equal length can be partitioned.");
+    }
+  }
+  if (num_rows < 0) {
+    return Status::OK();
+  }
+  if (FitsMemoryBudget()) {
+    ranges->emplace_back(0, num_rows);
+    return Status::OK();
+  }
+
+  // Start from the average number of rows that fit, and shrink ranges that contain larger rows.
+  auto budget = static_cast<int64_t>(memory_budget_);
+  auto estimate = std::max(static_cast<int64_t>(1),
+                           static_cast<int64_t>(static_cast<double>(budget) * num_rows / GetUploadSize()));
+  int64_t first = 0;
+  while (first < num_rows) {
+    int64_t length = std::min(estimate, num_rows - first);
+    while (true) {
+      std::shared_ptr<Context> range;
+      auto status = Slice(first, first + length, &range);
+      if (!status.ok()) return status;
+      auto size = static_cast<int64_t>(range->GetUploadSize());
+      if (size <= budget) {
+        break;
+      }
+      if (length == 1) {
+        status = Status::DEVICE_OUT_OF_MEMORY();
+        status.message = "Row " + std::to_string(first) + " (" + std::to_string(size) + " bytes) exceeds the device "
+            "memory budget (" + std::to_string(budget) + " bytes).";
+        return status;
+      }
+      // Scale in floating point; the product of the length and the budget may not fit in 64 bits.
+      auto scaled = static_cast<int64_t>(static_cast<double>(length) * budget / size);
+      length = std::max(static_cast<int64_t>(1), std::min(length - 1, scaled));
+    }
+    ranges->emplace_back(first, first + length);
+    first += length;
+  }
+  return Status::OK();
+}
+
+size_t Context::first_buffer(size_t i) const {
+  size_t ret = 0;
+  for (size_t b = 0; b < i; b++) {
+    ret += host_batch_buffers_[b].size();
+  }
+  return ret;
+}
+
+/// State of reading back the buffers of a RecordBatch from the device.
+struct Readback {
+  /// The platform to copy from.
+  std::shared_ptr<Platform> platform;
+  /// The host buffers of the RecordBatch, in the order of its buffer layout.
+  std::vector<const BufferRef *> refs;
+  /// The device buffers corresponding to the host buffers.
+  std::vector<DeviceBuffer> device_buffers;
+  /// The index of the next buffer to read back.
+  size_t index = 0;
+  /// Copies that are still in flight.
+  std::vector<std::future<Status>> copies;
+};
+
+/**
+ * @brief Read back the first used bytes of the next buffer.
+ *
+ * Buffers that the device wrote to in host memory directly are referenced from the host instead. Other buffers are
+ * copied in the background, unless the caller needs their contents right away.
+ */
+static Status TakeBuffer(Readback *rb,
+                         int64_t used,
+                         const std::shared_ptr<arrow::Buffer> &host_buffer,
+                         bool wait,
+                         std::shared_ptr<arrow::Buffer> *out) {
+  if (rb->index >= rb->refs.size()) {
+    return Status::ERROR("RecordBatch has less buffers than its schema requires.");
+  }
+  auto i = rb->index++;
+  const auto &ref = *rb->refs[i];
+  const auto &device_buf = rb->device_buffers[i];
+  used = std::max(static_cast<int64_t>(0), std::min(used, ref.size));
+
+  if (!device_buf.was_alloced && (device_buf.device_address == reinterpret_cast<da_t>(device_buf.host_address))) {
+    auto parent = ref.owner != nullptr ? ref.owner : host_buffer;
+    *out = parent == nullptr ? nullptr : arrow::SliceBuffer(parent, ref.data - parent->data(), used);
+    return Status::OK();
+  }
+
+  auto result = arrow::AllocateBuffer(used);
+  if (!result.ok()) {
+    return Status::ERROR("Could not allocate buffer. ARROW:[" + result.status().ToString() + "]");
+  }
+  std::shared_ptr<arrow::Buffer> buffer = std::move(result).ValueOrDie();
+  *out = buffer;
+  if (used == 0) {
+    return Status::OK();
+  }
+  if (wait) {
+    return rb->platform->CopyDeviceToHost(device_buf.device_address, buffer->mutable_data(), used);
+  }
+  auto platform = rb->platform;
+  auto address = device_buf.device_address;
+  rb->copies.push_back(std::async(std::launch::async, [platform, address, buffer, used]() {
+    return platform->CopyDeviceToHost(address, buffer->mutable_data(), used);
+  }));
+  return Status::OK();
+}
+
+/// @brief Return the size in bytes of a single offset of a variable-length type.
+static int64_t OffsetSize(const arrow::DataType &type) {
+  switch (type.id()) {
+    case arrow::Type::LARGE_BINARY:
+    case arrow::Type::LARGE_STRING:
+    case arrow::Type::LARGE_LIST: return sizeof(int64_t);
+    default: return sizeof(int32_t);
+  }
+}
+
+/**
+ * @brief Read back the offsets of a variable-length array, and obtain the number of elements or bytes they span.
+ */
+static Status TakeOffsets(Readback *rb,
+                          const arrow::DataType &type,
+                          int64_t length,
+                          const std::shared_ptr<arrow::Buffer> &host_buffer,
+                          std::shared_ptr<arrow::Buffer> *offsets,
+                          int64_t *span) {
+  // The span of the values is needed to read back the values, so the offsets have to be copied right away.
+  auto offset_size = OffsetSize(type);
+  auto status = TakeBuffer(rb, (length + 1) * offset_size, host_buffer, true, offsets);
+  if (!status.ok()) return status;
+  *span = 0;
+  if ((*offsets != nullptr) && ((*offsets)->size() >= (length + 1) * offset_size)) {
+    if (offset_size == sizeof(int64_t)) {
+      *span = reinterpret_cast<const int64_t *>((*offsets)->data())[length];
+    } else {
+      *span = reinterpret_cast<const int32_t *>((*offsets)->data())[length];
+    }
+  }
+  if (*span < 0) {
+    return Status::ERROR("Kernel wrote invalid offsets.");
+  }
+  return Status::OK();
+}
+
+/**
+ * @brief Read back and rebuild the ArrayData of a field, in the order of the slots of its buffer layout. Only the bytes
+ * used by the first length elements are read back.
+ */
+static Status RebuildArray(const arrow::Field &field,
+                           const std::shared_ptr<arrow::Array> &host,
+                           int64_t length,
+                           Readback *rb,
+                           std::shared_ptr<arrow::ArrayData> *out) {
+  Status status = Status::OK();
+  std::shared_ptr<arrow::Buffer> validity;
+  int64_t null_count = 0;
+  if (field.nullable()) {
+    // The kernel determined the validity of the elements, so the null count is unknown.
+    status = TakeBuffer(rb, (length + 7) / 8, host->null_bitmap(), false, &validity);
+    if (!status.ok()) return status;
+    if ((validity == nullptr) || (validity->size() < (length + 7) / 8)) {
+      return Status::ERROR("Validity bitmap of " + field.name() + " is too small.");
+    }
+    null_count = arrow::kUnknownNullCount;
+  }
+
+  const auto &type = field.type();
+  switch (type->id()) {
+    case arrow::Type::BINARY:
+    case arrow::Type::STRING:
+    case arrow::Type::LARGE_BINARY:
+    case arrow::Type::LARGE_STRING: {
+      std::shared_ptr<arrow::Buffer> offsets, values;
+      int64_t num_bytes = 0;
+      status = TakeOffsets(rb, *type, length, host->data()->buffers[1], &offsets, &num_bytes);
+      if (!status.ok()) return status;
+      if (rb->index >= rb->refs.size()) {
+        return Status::ERROR("RecordBatch has less buffers than its schema requires.");
+      }
+      if (num_bytes > rb->refs[rb->index]->size) {
+        return Status::ERROR("Offsets of " + field.name() + " exceed its values buffer.");
+      }
+      status = TakeBuffer(rb, num_bytes, host->data()->buffers[2], false, &values);
+      if (!status.ok()) return status;
+      *out = arrow::ArrayData::Make(type, length, {validity, offsets, values}, null_count);
+      break;
+    }
+    case arrow::Type::LIST:
+    case arrow::Type::LARGE_LIST: {
+      std::shared_ptr<arrow::Buffer> offsets;
+      // The length of the child array follows from the last offset written by the kernel.
+      int64_t child_length = 0;
+      status = TakeOffsets(rb, *type, length, host->data()->buffers[1], &offsets, &child_length);
+      if (!status.ok()) return status;
+      auto host_child = arrow::MakeArray(host->data()->child_data[0]);
+      if (child_length > host_child->length()) {
+        return Status::ERROR("Offsets of " + field.name() + " exceed its child array.");
+      }
+      std::shared_ptr<arrow::ArrayData> child;
+      status = RebuildArray(*type->field(0), host_child, child_length, rb, &child);
+      if (!status.ok()) return status;
+      *out = arrow::ArrayData::Make(type, length, {validity, offsets}, {child}, null_count);
+      break;
+    }
+    case arrow::Type::FIXED_SIZE_LIST: {
+      // Every list has the same size, so the length of the child array follows from the number of lists.
+      auto list_size = static_cast<const arrow::FixedSizeListType &>(*type).list_size();
+      std::shared_ptr<arrow::ArrayData> child;
+      status = RebuildArray(*type->field(0), arrow::MakeArray(host->data()->child_data[0]), length * list_size, rb,
+                            &child);
+      if (!status.ok()) return status;
+      *out = arrow::ArrayData::Make(type, length, {validity}, {child}, null_count);
+      break;
+    }
+    case arrow::Type::STRUCT: {
+      auto host_struct = std::static_pointer_cast<arrow::StructArray>(host);
+      std::vector<std::shared_ptr<arrow::ArrayData>> children;
+      for (int c = 0; c < type->num_fields(); c++) {
+        std::shared_ptr<arrow::ArrayData> child;
+        status = RebuildArray(*type->field(c), host_struct->field(c), length, rb, &child);
+        if (!status.ok()) return status;
+        children.push_back(child);
+      }
+      *out = arrow::ArrayData::Make(type, length, {validity}, children, null_count);
+      break;
+    }
+    default: {
+      auto fixed_width = std::dynamic_pointer_cast<arrow::FixedWidthType>(type);
+      if (fixed_width == nullptr) {
+        return Status::ERROR("Cannot materialize arrays of type " + type->ToString());
+      }
+      std::shared_ptr<arrow::Buffer> values;
+      status = TakeBuffer(rb, (length * fixed_width->bit_width() + 7) / 8, host->data()->buffers[1], false, &values);
+      if (!status.ok()) return status;
+      *out = arrow::ArrayData::Make(type, length, {validity, values}, null_count);
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+Status Context::ReadbackColumns(size_t batch_index,
+                                const std::vector<int> &columns,
+                                int64_t *num_rows,
+                                std::vector<std::shared_ptr<arrow::Array>> *out) {
+  if (batch_index >= host_batches_.size()) {
+    return Status::ERROR("RecordBatch index out of bounds.");
+  }
+  const auto &layout = *host_batch_layout_[batch_index];
+  const auto &refs = host_batch_buffers_[batch_index];
+  if (layout.mode() != Mode::WRITE) {
+    return Status::ERROR("Only write-mode RecordBatches can be materialized.");
+  }
+  auto host = host_batches_[batch_index];
+  if (*num_rows < 0) {
+    *num_rows = host->num_rows();
+  } else if (*num_rows > host->num_rows()) {
+    return Status::ERROR("Cannot materialize more rows than the RecordBatch holds.");
+  }
+  auto first = first_buffer(batch_index);
+  if (first + refs.size() > device_buffers_.size()) {
+    return Status::ERROR("Context must be enabled before RecordBatches can be materialized.");
+  }
+
+  // Select the buffers of the requested columns. Every field of the layout holds the slots of one column. Columns that
+  // were projected away have no field, and are not on the device.
+  Readback rb;
+  rb.platform = platform_;
+  std::vector<int> field_index;
+  for (auto c : columns) {
+    if ((c < 0) || (c >= host->num_columns())) {
+      return Status::ERROR("Column index " + std::to_string(c) + " out of bounds.");
+    }
+    const auto &fields = layout.fields();
+    size_t f = 0;
+    while ((f < fields.size()) && (fields[f].column != c)) {
+      f++;
+    }
+    if (f == fields.size()) {
+      field_index.push_back(-1);
+      continue;
+    }
+    field_index.push_back(static_cast<int>(f));
+    for (size_t b = fields[f].first_slot; b < fields[f].first_slot + fields[f].num_slots; b++) {
+      rb.refs.push_back(&refs[b]);
+      rb.device_buffers.push_back(device_buffers_[first + b]);
+    }
+  }
+
+  // Rebuild the columns. Independent buffers are copied back in parallel in the meantime.
+  const auto &kernel_schema = host_batch_schema_[batch_index];
+  out->clear();
+  Status status = Status::OK();
+  for (size_t i = 0; i < columns.size(); i++) {
+    auto c = columns[i];
+    if (field_index[i] < 0) {
+      // The kernel did not write this column, so it is returned as it is on the host.
+      out->push_back(host->column(c)->Slice(0, *num_rows));
+      continue;
+    }
+    // The kernel sees the field as described by its own schema, if it has one.
+    auto field = host->schema()->field(c);
+    if (kernel_schema != nullptr) {
+      field = kernel_schema->GetFieldByName(field->name());
+    }
+    std::shared_ptr<arrow::ArrayData> data;
+    status = RebuildArray(*field, host->column(c), *num_rows, &rb, &data);
+    if (!status.ok()) {
+      break;
+    }
+    out->push_back(arrow::MakeArray(data));
+  }
+  for (auto &copy : rb.copies) {
+    auto copy_status = copy.get();
+    if (status.ok() && !copy_status.ok()) {
+      status = copy_status;
+    }
+  }
+  return status;
+}
+
+Status Context::Materialize(size_t batch_index, std::shared_ptr<arrow::RecordBatch> *out, int64_t num_rows) {
+  if (batch_index >= host_batches_.size()) {
+    return Status::ERROR("RecordBatch index out of bounds.");
+  }
+  std::vector<int> indices;
+  for (int c = 0; c < host_batches_[batch_index]->num_columns(); c++) {
+    indices.push_back(c);
+  }
+  std::vector<std::shared_ptr<arrow::Array>> columns;
+  auto status = ReadbackColumns(batch_index, indices, &num_rows, &columns);
+  if (!status.ok()) {
+    return status;
+  }
+  *out = arrow::RecordBatch::Make(host_batches_[batch_index]->schema(), num_rows, columns);
+  return Status::OK();
+}
+
+Status Context::MaterializeColumn(size_t batch_index,
+                                  int column,
+                                  std::shared_ptr<arrow::Array> *out,
+                                  int64_t num_rows) {
+  std::vector<std::shared_ptr<arrow::Array>> columns;
+  auto status = ReadbackColumns(batch_index, {column}, &num_rows, &columns);
+  if (!status.ok()) {
+    return status;
+  }
+  *out = columns[0];
+  return Status::OK();
+}
+
+Status Context::ExportRecordBatch(size_t batch_index,
+                                  struct ArrowArray *array,
+                                  struct ArrowSchema *schema,
+                                  int64_t num_rows) {
+  if ((array == nullptr) || (schema == nullptr)) {
+    return Status::ERROR("ArrowArray or ArrowSchema is nullptr.");
+  }
+  std::shared_ptr<arrow::RecordBatch> batch;
+  auto status = Materialize(batch_index, &batch, num_rows);
+  if (!status.ok()) return status;
+  auto arrow_status = arrow::ExportRecordBatch(*batch, array, schema);
+  if (!arrow_status.ok()) {
+    return Status::ERROR("Could not export RecordBatch. ARROW:[" + arrow_status.ToString() + "]");
+  }
+  return Status::OK();
+}
+
+/**
+ * @brief Allocate the buffers of an uninitialized output array with a number of elements.
+ *
+ * The capacity of variable-length data is the capacity of the host-side array, grown by some factor.
+ */
+static Status AllocateOutputArray(const arrow::Field &field,
+                                  const std::shared_ptr<arrow::Array> &host,
+                                  int64_t length,
+                                  double growth,
+                                  std::shared_ptr<arrow::ArrayData> *out) {
+  std::vector<std::shared_ptr<arrow::Buffer>> buffers;
+  auto allocate = [&buffers](int64_t size) -> Status {
+    auto result = arrow::AllocateBuffer(size);
+    if (!result.ok()) {
+      return Status::ERROR("Could not allocate buffer. ARROW:[" + result.status().ToString() + "]");
+    }
+    buffers.push_back(std::move(result).ValueOrDie());
+    return Status::OK();
+  };
+  auto grow = [growth](int64_t capacity) -> int64_t {
+    return std::max(static_cast<int64_t>(1), static_cast<int64_t>(std::ceil(capacity * growth)));
+  };
+
+  Status status = Status::OK();
+  if (field.nullable()) {
+    status = allocate((length + 7) / 8);
+    if (!status.ok()) return status;
+    // The kernel writes the validity, but the bitmap must not hold uninitialized memory until it does.
+    std::memset(buffers.back()->mutable_data(), 0, buffers.back()->size());
+  } else {
+    buffers.push_back(nullptr);
+  }
+
+  const auto &type = field.type();
+  std::vector<std::shared_ptr<arrow::ArrayData>> children;
+  switch (type->id()) {
+    case arrow::Type::BINARY:
+    case arrow::Type::STRING:
+    case arrow::Type::LARGE_BINARY:
+    case arrow::Type::LARGE_STRING: {
+      status = allocate((length + 1) * OffsetSize(*type));
+      if (!status.ok()) return status;
+      auto values = host->data()->buffers[2];
+      status = allocate(grow(values != nullptr ? values->size() : 0));
+      if (!status.ok()) return status;
+      break;
+    }
+    case arrow::Type::LIST:
+    case arrow::Type::LARGE_LIST: {
+      status = allocate((length + 1) * OffsetSize(*type));
+      if (!status.ok()) return status;
+      auto host_child = arrow::MakeArray(host->data()->child_data[0]);
+      std::shared_ptr<arrow::ArrayData> child;
+      status = AllocateOutputArray(*type->field(0), host_child, grow(host_child->length()), growth, &child);
+      if (!status.ok()) return status;
+      children.push_back(child);
+      break;
+    }
+    case arrow::Type::FIXED_SIZE_LIST: {
+      auto list_size = static_cast<const arrow::FixedSizeListType &>(*type).list_size();
+      std::shared_ptr<arrow::ArrayData> child;
+      status = AllocateOutputArray(*type->field(0), arrow::MakeArray(host->data()->child_data[0]), length * list_size,
+                                   growth, &child);
+      if (!status.ok()) return status;
+      children.push_back(child);
+      break;
+    }
+    case arrow::Type::STRUCT: {
+      auto host_struct = std::static_pointer_cast<arrow::StructArray>(host);
+      for (int c = 0; c < type->num_fields(); c++) {
+        std::shared_ptr<arrow::ArrayData> child;
+        status = AllocateOutputArray(*type->field(c), host_struct->field(c), length, growth, &child);
+        if (!status.ok()) return status;
+        children.push_back(child);
+      }
+      break;
+    }
+    default: {
+      auto fixed_width = std::dynamic_pointer_cast<arrow::FixedWidthType>(type);
+      if (fixed_width == nullptr) {
+        return Status::ERROR("Cannot allocate output arrays of type " + type->ToString());
+      }
+      status = allocate((length * fixed_width->bit_width() + 7) / 8);
+      if (!status.ok()) return status;
+      break;
+    }
+  }
+  // The contents are written by the kernel, so the null count is unknown.
+  *out = arrow::ArrayData::Make(type, length, buffers, children, field.nullable() ? arrow::kUnknownNullCount : 0);
+  return Status::OK();
+}
+
+Status Context::ResumeFrom(int64_t row, std::shared_ptr<Context> *out, double growth) const {
+  if (growth <= 1.0) {
+    return Status::ERROR("Growth factor must be larger than 1.");
+  }
+  std::shared_ptr<Context> resumed;
+  auto status = Context::Make(&resumed, platform_);
+  if (!status.ok()) return status;
+
+  for (size_t i = 0; i < host_batches_.size(); i++) {
+    if (host_batch_entry_[i] != nullptr) {
+      status = resumed->QueueCatalogEntry(host_batch_entry_[i]);
+      if (!status.ok()) return status;
+      continue;
+    }
+    const auto &batch = host_batches_[i];
+    if ((row < 0) || (row > batch->num_rows())) {
+      return Status::ERROR("Cannot resume RecordBatch " + std::to_string(i) + " from row " + std::to_string(row));
+    }
+    std::shared_ptr<arrow::RecordBatch> remainder;
+    if (host_batch_layout_[i]->mode() == Mode::WRITE) {
+      // Allocate new output buffers for the remaining rows, with more room for variable-length data.
+      int64_t length = batch->num_rows() - row;
+      std::vector<std::shared_ptr<arrow::Array>> columns;
+      for (int c = 0; c < batch->num_columns(); c++) {
+        // The kernel sees the field as described by the layout, i.e. by its own schema if it has one.
+        const BufferLayout::Field *field = nullptr;
+        for (const auto &f : host_batch_layout_[i]->fields()) {
+          if ((f.column == c) && !f.dictionary) {
+            field = &f;
+          }
+        }
+        if (field == nullptr) {
+          // Columns that were projected away are not written by the kernel.
+          columns.push_back(batch->column(c)->Slice(row));
+          continue;
+        }
+        std::shared_ptr<arrow::ArrayData> data;
+        status = AllocateOutputArray(*field->field, batch->column(c), length, growth, &data);
+        if (!status.ok()) return status;
+        columns.push_back(arrow::MakeArray(data));
+      }
+      remainder = arrow::RecordBatch::Make(batch->schema(), length, columns);
+    } else {
+      remainder = batch->Slice(row);
+    }
+    status = resumed->QueueRecordBatch(remainder, host_batch_schema_[i], host_batch_memtype_[i]);
+    if (!status.ok()) return status;
+  }
+  *out = resumed;
+  return Status::OK();
+}
+
 }  // namespace fletcher
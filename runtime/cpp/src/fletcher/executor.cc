@@ -0,0 +1,218 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/executor.h"
+
+#include <arrow/api.h>
+#include <arrow/c/bridge.h>
+#include <fletcher/common.h>
+
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace fletcher {
+
+std::string StreamStatistics::bottleneck() const {
+  std::string result = "source";
+  double max = source;
+  if (upload > max) {
+    result = "upload";
+    max = upload;
+  }
+  if (compute > max) {
+    result = "compute";
+    max = compute;
+  }
+  if (readback > max) {
+    result = "readback";
+  }
+  return result;
+}
+
+std::string StreamStatistics::ToString() const {
+  std::stringstream ss;
+  ss << "Batches    : " << num_batches << "\n"
+     << "Rows       : " << num_rows << "\n"
+     << "Bytes      : " << num_bytes << "\n"
+     << "Source   s : " << source << "\n"
+     << "Upload   s : " << upload << "\n"
+     << "Compute  s : " << compute << "\n"
+     << "Readback s : " << readback << "\n"
+     << "Total    s : " << total << "\n"
+     << "Bottleneck : " << bottleneck() << "\n";
+  return ss.str();
+}
+
+Status StreamExecutor::Make(std::shared_ptr<StreamExecutor> *executor,
+                            const std::shared_ptr<Platform> &platform,
+                            KernelFactory kernel_factory,
+                            ResultHandler result_handler) {
+  if (platform == nullptr) {
+    return Status::ERROR("Platform is nullptr.");
+  }
+  if (!kernel_factory) {
+    kernel_factory = [](const std::shared_ptr<Context> &context) { return std::make_shared<Kernel>(context); };
+  }
+  *executor = std::make_shared<StreamExecutor>(platform, std::move(kernel_factory), std::move(result_handler));
+  return Status::OK();
+}
+
+Status StreamExecutor::Upload(arrow::RecordBatchReader *reader, std::shared_ptr<StreamBatch> *out) {
+  Timer t;
+  *out = nullptr;
+
+  // Obtain the next RecordBatch.
+  std::shared_ptr<arrow::RecordBatch> batch;
+  t.start();
+  auto arrow_status = reader->ReadNext(&batch);
+  t.stop();
+  statistics_.source += t.seconds();
+  if (!arrow_status.ok()) {
+    return Status::ERROR("Could not read next RecordBatch. ARROW:[" + arrow_status.ToString() + "]");
+  }
+  if (batch == nullptr) {
+    return Status::OK();
+  }
+
+  // Make it available to the device in a Context of its own.
+  t.start();
+  auto item = std::make_shared<StreamBatch>();
+  item->index = statistics_.num_batches;
+  item->batch = batch;
+  auto status = Context::Make(&item->context, platform_);
+  if (!status.ok()) return status;
+  status = item->context->QueueRecordBatch(batch, kernel_schema, mem_type);
+  if (!status.ok()) return status;
+  status = item->context->Enable();
+  if (!status.ok()) return status;
+  t.stop();
+
+  statistics_.upload += t.seconds();
+  statistics_.num_batches++;
+  statistics_.num_rows += batch->num_rows();
+  statistics_.num_bytes += item->context->GetQueueSize();
+  *out = item;
+  return Status::OK();
+}
+
+Status StreamExecutor::Compute(StreamBatch *item) {
+  Timer t;
+  t.start();
+  item->kernel = kernel_factory_(item->context);
+  if (item->kernel == nullptr) {
+    return Status::ERROR("Kernel factory did not return a Kernel.");
+  }
+  auto status = item->kernel->Start();
+  if (!status.ok()) return status;
+  status = item->kernel->PollUntilDoneInterval(poll_interval_usec);
+  if (!status.ok()) return status;
+  // The return registers are shared by all batches, so they must be read before the next kernel starts.
+  status = item->kernel->GetReturn(&item->return0, &item->return1);
+  if (!status.ok()) return status;
+  t.stop();
+  statistics_.compute += t.seconds();
+  return Status::OK();
+}
+
+Status StreamExecutor::Readback(StreamBatch *item) {
+  Timer t;
+  t.start();
+  Status status = Status::OK();
+  if (result_handler_) {
+    status = result_handler_(*item);
+  }
+  // Release the device buffer set of this batch, unless the handler kept a reference to the context.
+  item->kernel.reset();
+  item->context.reset();
+  t.stop();
+  statistics_.readback += t.seconds();
+  return status;
+}
+
+Status StreamExecutor::Run(const std::shared_ptr<arrow::RecordBatchReader> &reader) {
+  if (reader == nullptr) {
+    return Status::ERROR("RecordBatchReader is nullptr.");
+  }
+  statistics_ = StreamStatistics();
+  Timer total;
+  total.start();
+
+  std::shared_ptr<StreamBatch> next;
+  std::shared_ptr<StreamBatch> current;
+  std::shared_ptr<StreamBatch> previous;
+
+  // Fill the pipeline with the first batch.
+  auto status = Upload(reader.get(), &next);
+  if (!status.ok()) return status;
+
+  while (next != nullptr) {
+    previous = current;
+    current = next;
+    next = nullptr;
+
+    FLETCHER_LOG(DEBUG, "Streaming RecordBatch " << current->index);
+
+    // Upload batch n+1 and handle the results of batch n-1 while the kernel runs on batch n.
+    auto upload = std::async(std::launch::async, [&]() { return Upload(reader.get(), &next); });
+    auto readback = std::async(std::launch::async, [&]() {
+      return previous != nullptr ? Readback(previous.get()) : Status::OK();
+    });
+    auto compute_status = Compute(current.get());
+    auto upload_status = upload.get();
+    auto readback_status = readback.get();
+    previous.reset();
+
+    if (!compute_status.ok()) return compute_status;
+    if (!upload_status.ok()) return upload_status;
+    if (!readback_status.ok()) return readback_status;
+  }
+
+  // Drain the pipeline.
+  if (current != nullptr) {
+    status = Readback(current.get());
+    if (!status.ok()) return status;
+  }
+
+  total.stop();
+  statistics_.total = total.seconds();
+  FLETCHER_LOG(DEBUG, "Stream statistics:\n" << statistics_.ToString());
+  return Status::OK();
+}
+
+Status StreamExecutor::Run(struct ArrowArrayStream *stream) {
+  if (stream == nullptr) {
+    return Status::ERROR("ArrowArrayStream is nullptr.");
+  }
+  auto result = arrow::ImportRecordBatchReader(stream);
+  if (!result.ok()) {
+    return Status::ERROR("Could not import ArrowArrayStream. ARROW:[" + result.status().ToString() + "]");
+  }
+  return Run(result.ValueOrDie());
+}
+
+Status StreamExecutor::Run(const std::shared_ptr<arrow::Table> &table, int64_t chunk_size) {
+  if (table == nullptr) {
+    return Status::ERROR("Table is nullptr.");
+  }
+  if (chunk_size <= 0) {
+    return Status::ERROR("Chunk size must be positive.");
+  }
+  auto reader = std::make_shared<arrow::TableBatchReader>(*table);
+  reader->set_chunksize(chunk_size);
+  return Run(reader);
+}
+
+}  // namespace fletcher
@@ -15,7 +15,9 @@
 #include "fletcher/kernel.h"
 
 #include <unistd.h>
+#include <cstdint>
 #include <utility>
+#include <vector>
 
 #include "fletcher/context.h"
 
@@ -40,43 +42,60 @@ Status Kernel::Reset() {
   }
 }
 
-Status Kernel::SetRange(size_t recordbatch_index, int32_t first, int32_t last) {
-  if (first >= last) {
+Status Kernel::WriteIndex(uint64_t offset, int64_t index) {
+  auto status = context_->platform()->WriteMMIO(offset, static_cast<uint32_t>(index));
+  if (!status.ok() || (index_regs() == 1)) return status;
+  return context_->platform()->WriteMMIO(offset + 1, static_cast<uint32_t>(static_cast<uint64_t>(index) >> 32u));
+}
+
+Status Kernel::SetRange(size_t recordbatch_index, int64_t first, int64_t last) {
+  if ((first < 0) || (first >= last)) {
     FLETCHER_LOG(ERROR, "Row range invalid: [ " + std::to_string(first) + ", " + std::to_string(last) + " )");
     return Status::ERROR();
   }
-
-  Status ret;
-  if (!context_->platform()->WriteMMIO(FLETCHER_REG_SCHEMA + 2 * recordbatch_index,
-                                       static_cast<uint32_t>(first)).ok()) {
-    ret = Status::ERROR();
-  }
-  if (!context_->platform()->WriteMMIO(FLETCHER_REG_SCHEMA + 2 * recordbatch_index + 1,
-                                       static_cast<uint32_t>(last)).ok()) {
-    ret = Status::ERROR();
+  if ((index_regs() == 1) && (last > INT32_MAX)) {
+    return Status::ERROR("Row range [ " + std::to_string(first) + ", " + std::to_string(last)
+                             + " ) does not fit 32-bit index registers.");
   }
-  return Status::OK();
+
+  uint64_t offset = FLETCHER_REG_SCHEMA + 2 * index_regs() * recordbatch_index;
+  auto status = WriteIndex(offset, first);
+  if (!status.ok()) return status;
+  return WriteIndex(offset + index_regs(), last);
 }
 
 Status Kernel::SetArguments(const std::vector<uint32_t> &arguments) {
+  uint64_t offset = FLETCHER_REG_SCHEMA + 2 * index_regs() * context_->num_recordbatches()
+      + 2 * context_->num_buffers();
   for (int i = 0; (size_t) i < arguments.size(); i++) {
-    context_->platform()->WriteMMIO(
-        FLETCHER_REG_SCHEMA + 2 * context_->num_recordbatches() + 2 * context_->num_buffers() + i, arguments[i]);
+    context_->platform()->WriteMMIO(offset + i, arguments[i]);
   }
 
   return Status::OK();
 }
 
 Status Kernel::Start() {
-  Status status;
+  FLETCHER_METRIC_ADD(kernel_launches, 1);
+  FLETCHER_METRIC_TIMER(kernel_start_ns);
+  auto mmio_ops = ThreadMmioOps();
+  // Buffers may move between host and on-board memory depending on their reuse.
+  bool moved = false;
+  auto status = context_->RecordLaunch(&moved);
+  if (!status.ok()) return status;
   if (!metadata_written) {
-    WriteMetaData();
+    status = WriteMetaData();
+  } else if (moved) {
+    // Only the addresses changed; keep the ranges that may have been set with SetRange().
+    status = WriteBufferAddresses();
   }
+  if (!status.ok()) return status;
   FLETCHER_LOG(DEBUG, "Starting kernel.");
   status = context_->platform()->WriteMMIO(FLETCHER_REG_CONTROL, ctrl_start);
-  if (!status.ok())
-    return status;
-  return context_->platform()->WriteMMIO(FLETCHER_REG_CONTROL, 0);
+  if (status.ok()) {
+    status = context_->platform()->WriteMMIO(FLETCHER_REG_CONTROL, 0);
+  }
+  FLETCHER_METRIC_RECORD(kernel_start_mmio, ThreadMmioOps() - mmio_ops);
+  return status;
 }
 
 Status Kernel::GetStatus(uint32_t *status_out) {
@@ -93,13 +112,35 @@ Status Kernel::GetReturn(uint32_t *ret0, uint32_t *ret1) {
   return status;
 }
 
+Status Kernel::GetOverflow(bool *overflow, int64_t *rows_completed) {
+  uint32_t status_reg = 0;
+  auto status = GetStatus(&status_reg);
+  if (!status.ok()) return status;
+  *overflow = (status_reg & overflow_status_mask) != 0;
+  if (!*overflow) {
+    return Status::OK();
+  }
+  if (index_regs() == 2) {
+    uint64_t rows = 0;
+    status = context_->platform()->ReadMMIO64(FLETCHER_REG_RETURN0, &rows);
+    *rows_completed = static_cast<int64_t>(rows);
+    return status;
+  }
+  uint32_t rows = 0;
+  status = context_->platform()->ReadMMIO(FLETCHER_REG_RETURN0, &rows);
+  *rows_completed = rows;
+  return status;
+}
+
 Status Kernel::PollUntilDone() {
   return PollUntilDoneInterval(0);
 }
 
 Status Kernel::PollUntilDoneInterval(unsigned int poll_interval_usec) {
+  FLETCHER_METRIC_TIMER(kernel_completion_ns);
   bool done = false;
   uint32_t status = 0;
+  auto mmio_ops = ThreadMmioOps();
   FLETCHER_LOG(DEBUG, "Polling kernel for completion.");
   if (poll_interval_usec == 0) {
     while (!done) {
@@ -114,10 +155,60 @@ Status Kernel::PollUntilDoneInterval(unsigned int poll_interval_usec) {
       usleep(poll_interval_usec);
     }
   }
+  FLETCHER_METRIC_RECORD(kernel_completion_mmio, ThreadMmioOps() - mmio_ops);
   FLETCHER_LOG(DEBUG, "Kernel status done bit asserted.");
   return Status::OK();
 }
 
+Status Kernel::RunPartitioned(const Combiner &combine, uint32_t *ret0, uint32_t *ret1, unsigned int poll_interval_usec) {
+  Status status;
+  if (context_->FitsMemoryBudget()) {
+    status = Start();
+    if (!status.ok()) return status;
+    status = PollUntilDoneInterval(poll_interval_usec);
+    if (!status.ok()) return status;
+    return GetReturn(ret0, ret1);
+  }
+
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+  status = context_->Partition(&ranges);
+  if (!status.ok()) return status;
+  FLETCHER_LOG(DEBUG, "Running kernel over " << ranges.size() << " row range(s) to fit device memory budget.");
+
+  uint32_t acc0 = 0, acc1 = 0;
+  for (size_t r = 0; r < ranges.size(); r++) {
+    std::shared_ptr<Context> range;
+    status = context_->Slice(ranges[r].first, ranges[r].second, &range);
+    if (!status.ok()) return status;
+    status = range->Enable();
+    if (!status.ok()) return status;
+
+    // Run a copy of this kernel, with the same control and status values, on the range.
+    Kernel part(*this);
+    part.context_ = range;
+    part.metadata_written = false;
+    status = part.Start();
+    if (!status.ok()) return status;
+    status = part.PollUntilDoneInterval(poll_interval_usec);
+    if (!status.ok()) return status;
+    uint32_t r0 = 0, r1 = 0;
+    status = part.GetReturn(&r0, &r1);
+    if (!status.ok()) return status;
+
+    if ((r == 0) || !combine) {
+      acc0 = r0;
+      acc1 = r1;
+    } else {
+      combine(&acc0, &acc1, r0, r1);
+    }
+  }
+  *ret0 = acc0;
+  if (ret1 != nullptr) {
+    *ret1 = acc1;
+  }
+  return Status::OK();
+}
+
 std::shared_ptr<Context> Kernel::context() {
   return context_;
 }
@@ -129,35 +220,43 @@ Status Kernel::WriteMetaData() {
   // Set the starting offset to the first schema-derived register index.
   uint64_t offset = FLETCHER_REG_SCHEMA;
 
-  // Get the platform pointer.
-  auto platform = context_->platform();
-
-  // Write RecordBatch ranges.
+  // Write RecordBatch ranges. The buffers of sliced RecordBatches are rebased by their BufferLayout, such that
+  // the first row of the slice is always at index 0 on the device.
   for (size_t i = 0; i < context_->num_recordbatches(); i++) {
     auto rb = context_->recordbatch(i);
-    status = platform->WriteMMIO(offset, 0);               // First index
+    status = WriteIndex(offset, 0);               // First index
     if (!status.ok()) return status;
-    offset++;
-    status = platform->WriteMMIO(offset, rb->num_rows());  // Last index (exclusive)
+    offset += index_regs();
+    status = WriteIndex(offset, rb->num_rows());  // Last index (exclusive)
     if (!status.ok()) return status;
-    offset++;
+    offset += index_regs();
   }
 
-  // Write buffer addresses
+  status = WriteBufferAddresses();
+  if (!status.ok()) return status;
+  metadata_written = true;
+  return Status::OK();
+}
+
+Status Kernel::WriteBufferAddresses() {
+  Status status;
+  auto platform = context_->platform();
+
+  // The buffer addresses follow the RecordBatch ranges.
+  uint64_t offset = FLETCHER_REG_SCHEMA + 2 * index_regs() * context_->num_recordbatches();
   for (size_t i = 0; i < context_->num_buffers(); i++) {
     // Get the device address
     auto device_buf = context_->device_buffer(i);
     dau_t address;
     address.full = device_buf.device_address;
     // Write the address
-    platform->WriteMMIO(offset, address.lo);
+    status = platform->WriteMMIO(offset, address.lo);
     if (!status.ok()) return status;
     offset++;
-    platform->WriteMMIO(offset, address.hi);
+    status = platform->WriteMMIO(offset, address.hi);
     if (!status.ok()) return status;
     offset++;
   }
-  metadata_written = true;
   return Status::OK();
 }
 
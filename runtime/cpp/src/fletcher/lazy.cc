@@ -0,0 +1,92 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/lazy.h"
+
+#include <arrow/api.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fletcher {
+
+LazyRecordBatch::LazyRecordBatch(std::shared_ptr<Context> context, size_t batch_index, int64_t num_rows)
+    : context_(std::move(context)), batch_index_(batch_index), num_rows_(num_rows) {
+  auto batch = context_->recordbatch(batch_index_);
+  schema_ = batch->schema();
+  columns_.resize(batch->num_columns());
+}
+
+Status LazyRecordBatch::Make(std::shared_ptr<LazyRecordBatch> *out,
+                             const std::shared_ptr<Context> &context,
+                             size_t batch_index,
+                             int64_t num_rows) {
+  if (context == nullptr) {
+    return Status::ERROR("Context is nullptr.");
+  }
+  if (batch_index >= context->num_recordbatches()) {
+    return Status::ERROR("RecordBatch index out of bounds.");
+  }
+  auto batch = context->recordbatch(batch_index);
+  // The mode follows from the kernel schema the RecordBatch was queued with, if any.
+  if (context->buffer_layout(batch_index)->mode() != Mode::WRITE) {
+    return Status::ERROR("Only write-mode RecordBatches can be materialized.");
+  }
+  if (num_rows < 0) {
+    num_rows = batch->num_rows();
+  } else if (num_rows > batch->num_rows()) {
+    return Status::ERROR("Cannot materialize more rows than the RecordBatch holds.");
+  }
+  *out = std::make_shared<LazyRecordBatch>(context, batch_index, num_rows);
+  return Status::OK();
+}
+
+Status LazyRecordBatch::column(int i, std::shared_ptr<arrow::Array> *out) {
+  if ((i < 0) || (i >= num_columns())) {
+    return Status::ERROR("Column index " + std::to_string(i) + " out of bounds.");
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (columns_[i] == nullptr) {
+    FLETCHER_LOG(DEBUG, "Reading back column " << schema_->field(i)->name() << " from the device.");
+    auto status = context_->MaterializeColumn(batch_index_, i, &columns_[i], num_rows_);
+    if (!status.ok()) {
+      columns_[i] = nullptr;
+      return status;
+    }
+  }
+  *out = columns_[i];
+  return Status::OK();
+}
+
+bool LazyRecordBatch::is_materialized(int i) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return (i >= 0) && (i < num_columns()) && (columns_[i] != nullptr);
+}
+
+Status LazyRecordBatch::ToRecordBatch(std::shared_ptr<arrow::RecordBatch> *out) {
+  std::vector<std::shared_ptr<arrow::Array>> columns;
+  for (int i = 0; i < num_columns(); i++) {
+    std::shared_ptr<arrow::Array> column;
+    auto status = this->column(i, &column);
+    if (!status.ok()) return status;
+    columns.push_back(column);
+  }
+  *out = arrow::RecordBatch::Make(schema_, num_rows_, columns);
+  return Status::OK();
+}
+
+}  // namespace fletcher
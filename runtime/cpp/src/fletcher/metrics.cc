@@ -0,0 +1,245 @@
+// Copyright 2018 Delft University of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fletcher/metrics.h"
+
+#include <fletcher/common.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fletcher {
+
+/// @brief Return the bucket of a value, i.e. the number of significant bits.
+static size_t BucketOf(uint64_t value) {
+  size_t bucket = 0;
+  while (value != 0) {
+    value >>= 1u;
+    bucket++;
+  }
+  return bucket;
+}
+
+void Histogram::Record(uint64_t value) {
+  buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  auto max = max_.load(std::memory_order_relaxed);
+  while ((value > max) && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+HistogramSnapshot Histogram::Snapshot() const {
+  HistogramSnapshot result;
+  // Values recorded while taking the snapshot may be partially included, which is fine for monitoring.
+  result.count = count_.load(std::memory_order_relaxed);
+  result.sum = sum_.load(std::memory_order_relaxed);
+  result.max = max_.load(std::memory_order_relaxed);
+  result.buckets.reserve(kNumBuckets);
+  for (const auto &bucket : buckets_) {
+    result.buckets.push_back(bucket.load(std::memory_order_relaxed));
+  }
+  return result;
+}
+
+void Histogram::Reset() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t HistogramSnapshot::Quantile(double q) const {
+  uint64_t total = 0;
+  for (auto b : buckets) {
+    total += b;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(q * static_cast<double>(total));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if ((seen > rank) || (seen == total)) {
+      // The upper bound of bucket i, inclusive.
+      uint64_t bound = i == 0 ? 0 : (i == 64 ? UINT64_MAX : (uint64_t(1) << i) - 1);
+      return bound < max ? bound : max;
+    }
+  }
+  return max;
+}
+
+uint64_t MetricsSnapshot::counter(const std::string &name) const {
+  for (const auto &c : counters) {
+    if (c.first == name) {
+      return c.second;
+    }
+  }
+  return 0;
+}
+
+HistogramSnapshot MetricsSnapshot::histogram(const std::string &name) const {
+  for (const auto &h : histograms) {
+    if (h.name == name) {
+      return h;
+    }
+  }
+  HistogramSnapshot empty;
+  empty.name = name;
+  return empty;
+}
+
+std::string MetricsSnapshot::ToJSON() const {
+  std::stringstream ss;
+  ss << "{\"timestamp\":" << timestamp << ",\"counters\":{";
+  for (size_t i = 0; i < counters.size(); i++) {
+    ss << (i > 0 ? "," : "") << "\"" << counters[i].first << "\":" << counters[i].second;
+  }
+  ss << "},\"histograms\":{";
+  for (size_t i = 0; i < histograms.size(); i++) {
+    const auto &h = histograms[i];
+    ss << (i > 0 ? "," : "") << "\"" << h.name << "\":{"
+       << "\"count\":" << h.count
+       << ",\"sum\":" << h.sum
+       << ",\"max\":" << h.max
+       << ",\"mean\":" << h.mean()
+       << ",\"p50\":" << h.Quantile(0.5)
+       << ",\"p90\":" << h.Quantile(0.9)
+       << ",\"p99\":" << h.Quantile(0.99)
+       << ",\"buckets\":[";
+    // Leave out the empty buckets beyond the largest value.
+    size_t num_buckets = h.buckets.size();
+    while ((num_buckets > 0) && (h.buckets[num_buckets - 1] == 0)) {
+      num_buckets--;
+    }
+    for (size_t b = 0; b < num_buckets; b++) {
+      ss << (b > 0 ? "," : "") << h.buckets[b];
+    }
+    ss << "]}";
+  }
+  ss << "}}";
+  return ss.str();
+}
+
+Metrics &Metrics::Global() {
+  static Metrics metrics;
+  return metrics;
+}
+
+MetricsSnapshot Metrics::Snapshot() const {
+  MetricsSnapshot result;
+  result.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count());
+  result.counters = {
+      {"mmio_reads", mmio_reads.value()},
+      {"mmio_writes", mmio_writes.value()},
+      {"bytes_host_to_device", bytes_host_to_device.value()},
+      {"bytes_device_to_host", bytes_device_to_host.value()},
+      {"bytes_prepared", bytes_prepared.value()},
+      {"device_allocations", device_allocations.value()},
+      {"device_frees", device_frees.value()},
+      {"kernel_launches", kernel_launches.value()},
+  };
+  std::vector<std::pair<std::string, const Histogram *>> histograms = {
+      {"context_enable_ns", &context_enable_ns},
+      {"kernel_start_ns", &kernel_start_ns},
+      {"kernel_start_mmio", &kernel_start_mmio},
+      {"kernel_completion_ns", &kernel_completion_ns},
+      {"kernel_completion_mmio", &kernel_completion_mmio},
+  };
+  for (const auto &h : histograms) {
+    result.histograms.push_back(h.second->Snapshot());
+    result.histograms.back().name = h.first;
+  }
+  return result;
+}
+
+void Metrics::Reset() {
+  for (auto *c : {&mmio_reads, &mmio_writes, &bytes_host_to_device, &bytes_device_to_host, &bytes_prepared,
+                  &device_allocations, &device_frees, &kernel_launches}) {
+    c->Reset();
+  }
+  for (auto *h : {&context_enable_ns, &kernel_start_ns, &kernel_start_mmio, &kernel_completion_ns,
+                  &kernel_completion_mmio}) {
+    h->Reset();
+  }
+}
+
+Status Metrics::Dump() {
+  // Write to a temporary file first, such that readers never observe a partial dump.
+  auto temp_file = dump_file_ + ".tmp";
+  {
+    std::ofstream file(temp_file, std::ios::out | std::ios::trunc);
+    file << Snapshot().ToJSON() << std::endl;
+    if (!file.good()) {
+      return Status::ERROR("Could not write metrics to " + temp_file);
+    }
+  }
+  if (std::rename(temp_file.c_str(), dump_file_.c_str()) != 0) {
+    return Status::ERROR("Could not rename " + temp_file + " to " + dump_file_);
+  }
+  return Status::OK();
+}
+
+Status Metrics::StartDump(const std::string &file_name, std::chrono::milliseconds interval) {
+  StopDump();
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  dump_file_ = file_name;
+  dump_stop_ = false;
+  auto status = Dump();
+  if (!status.ok()) {
+    return status;
+  }
+  dump_thread_ = std::thread([this, interval]() {
+    std::unique_lock<std::mutex> lock(dump_mutex_);
+    while (!dump_wake_.wait_for(lock, interval, [this]() { return dump_stop_; })) {
+      auto status = Dump();
+      if (!status.ok()) {
+        FLETCHER_LOG(WARNING, status.message);
+      }
+    }
+  });
+  return Status::OK();
+}
+
+void Metrics::StopDump() {
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    if (!dump_thread_.joinable()) {
+      return;
+    }
+    dump_stop_ = true;
+    thread.swap(dump_thread_);
+  }
+  dump_wake_.notify_all();
+  thread.join();
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  auto status = Dump();
+  if (!status.ok()) {
+    FLETCHER_LOG(WARNING, status.message);
+  }
+}
+
+Metrics::~Metrics() {
+  StopDump();
+}
+
+}  // namespace fletcher
@@ -96,6 +96,9 @@ Status Platform::Link(void *handle, bool quiet) {
     char *err = dlerror();
 
     if (err == nullptr) {
+      // Link optional functions. Clear the error state afterwards, since they may not exist.
+      *reinterpret_cast<void **>((&platformGetCapabilities)) = dlsym(handle, "platformGetCapabilities");
+      dlerror();
       return Status::OK();
     } else {
       if (!quiet) {
@@ -15,16 +15,27 @@
 #include <fletcher/fletcher.h>
 #include <arrow/api.h>
 #include <arrow/builder.h>
+#include <arrow/c/bridge.h>
 #include <arrow/record_batch.h>
 #include <fletcher_echo.h>
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <memory>
 
 #include "fletcher/platform.h"
 #include "fletcher/context.h"
+#include "fletcher/kernel.h"
+#include "fletcher/executor.h"
+#include "fletcher/coalesce.h"
+#include "fletcher/lazy.h"
+#include "fletcher/catalog.h"
+#include "fletcher/metrics.h"
+#include "fletcher/c_api.h"
 
 TEST(Platform, NoPlatform) {
   std::shared_ptr<fletcher::Platform> platform;
@@ -129,5 +140,870 @@ TEST(Context, ContextFunctions) {
   ASSERT_EQ(context->GetQueueSize(), 168);
   ASSERT_EQ(context->num_buffers(), 8);
   ASSERT_TRUE(context->Enable().ok());
+  // A Context can be enabled only once.
+  ASSERT_FALSE(context->Enable().ok());
+  ASSERT_FALSE(context->EnablePacked(64).ok());
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, SlicedRecordBatch) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = arrow::schema({arrow::field("a", arrow::uint64(), false),
+                               arrow::field("b", arrow::utf8(), false)});
+
+  arrow::UInt64Builder ba;
+  arrow::StringBuilder bb;
+  ASSERT_TRUE(ba.AppendValues({1, 2, 3, 4, 5, 6, 7, 8}).ok());
+  ASSERT_TRUE(bb.AppendValues({"a", "bb", "ccc", "dddd", "eeeee", "ffffff", "ggggggg", "hhhhhhhh"}).ok());
+  std::shared_ptr<arrow::Array> a;
+  std::shared_ptr<arrow::Array> b;
+  ASSERT_TRUE(ba.Finish(&a).ok());
+  ASSERT_TRUE(bb.Finish(&b).ok());
+
+  // Rows 2 up to 6 only cover ccc, dddd, eeeee and ffffff.
+  auto rb = arrow::RecordBatch::Make(schema, 8, {a, b})->Slice(2, 4);
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  ASSERT_EQ(context->GetQueueSize(), 4 * sizeof(uint64_t) + 5 * sizeof(int32_t) + 18);
+  ASSERT_TRUE(context->Enable().ok());
+
+  // The device copy of the offsets must be rebased to the first string of the slice.
+  auto offsets = context->device_buffer(1);
+  std::vector<int32_t> device_offsets(5);
+  ASSERT_TRUE(platform->CopyDeviceToHost(offsets.device_address,
+                                         reinterpret_cast<uint8_t *>(device_offsets.data()),
+                                         offsets.size).ok());
+  ASSERT_EQ(device_offsets, std::vector<int32_t>({0, 3, 7, 12, 18}));
+
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(StreamExecutor, TableChunks) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = arrow::schema({arrow::field("a", arrow::uint32(), false)});
+  arrow::UInt32Builder ba;
+  ASSERT_TRUE(ba.AppendValues({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}).ok());
+  std::shared_ptr<arrow::Array> a;
+  ASSERT_TRUE(ba.Finish(&a).ok());
+  auto table = arrow::Table::Make(schema, {a});
+
+  // The echo platform cannot signal completion, so don't wait for the done bit.
+  auto factory = [](const std::shared_ptr<fletcher::Context> &context) {
+    auto kernel = std::make_shared<fletcher::Kernel>(context);
+    kernel->done_status_mask = 0;
+    kernel->done_status = 0;
+    return kernel;
+  };
+
+  std::vector<size_t> indices;
+  std::vector<int64_t> rows;
+  auto handler = [&](const fletcher::StreamBatch &item) {
+    indices.push_back(item.index);
+    rows.push_back(item.batch->num_rows());
+    return fletcher::Status::OK();
+  };
+
+  std::shared_ptr<fletcher::StreamExecutor> executor;
+  ASSERT_TRUE(fletcher::StreamExecutor::Make(&executor, platform, factory, handler).ok());
+  ASSERT_TRUE(executor->Run(table, 4).ok());
+  ASSERT_EQ(indices, std::vector<size_t>({0, 1, 2}));
+  ASSERT_EQ(rows, std::vector<int64_t>({4, 4, 2}));
+  ASSERT_EQ(executor->statistics().num_batches, 3);
+  ASSERT_EQ(executor->statistics().num_rows, 10);
+  ASSERT_EQ(executor->statistics().num_bytes, 10 * sizeof(uint32_t));
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(StreamExecutor, ArrowArrayStream) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = arrow::schema({arrow::field("a", arrow::uint32(), false)});
+  arrow::UInt32Builder ba;
+  ASSERT_TRUE(ba.AppendValues({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}).ok());
+  std::shared_ptr<arrow::Array> a;
+  ASSERT_TRUE(ba.Finish(&a).ok());
+  auto table = arrow::Table::Make(schema, {a});
+  auto reader = std::make_shared<arrow::TableBatchReader>(*table);
+  reader->set_chunksize(5);
+
+  // Export the reader as a producer in another engine would.
+  struct ArrowArrayStream stream;
+  ASSERT_TRUE(arrow::ExportRecordBatchReader(reader, &stream).ok());
+
+  auto factory = [](const std::shared_ptr<fletcher::Context> &context) {
+    auto kernel = std::make_shared<fletcher::Kernel>(context);
+    kernel->done_status_mask = 0;
+    kernel->done_status = 0;
+    return kernel;
+  };
+  std::vector<const uint8_t *> addresses;
+  auto handler = [&](const fletcher::StreamBatch &item) {
+    addresses.push_back(item.context->device_buffer(0).host_address);
+    return fletcher::Status::OK();
+  };
+  std::shared_ptr<fletcher::StreamExecutor> executor;
+  ASSERT_TRUE(fletcher::StreamExecutor::Make(&executor, platform, factory, handler).ok());
+  ASSERT_TRUE(executor->Run(&stream).ok());
+  ASSERT_EQ(stream.release, nullptr);
+  ASSERT_EQ(executor->statistics().num_rows, 10);
+  // The imported batches reference the memory of the producer.
+  auto values = std::static_pointer_cast<arrow::UInt32Array>(a)->raw_values();
+  ASSERT_EQ(addresses, std::vector<const uint8_t *>({reinterpret_cast<const uint8_t *>(values),
+                                                     reinterpret_cast<const uint8_t *>(values + 5)}));
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(CApi, QueueAndExport) {
+  auto in_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::uint32(), false)}),
+                                              "In",
+                                              fletcher::Mode::READ);
+  arrow::UInt32Builder ba;
+  ASSERT_TRUE(ba.AppendValues({1, 2, 3, 4}).ok());
+  std::shared_ptr<arrow::Array> a;
+  ASSERT_TRUE(ba.Finish(&a).ok());
+  auto in = arrow::RecordBatch::Make(in_schema, 4, {a});
+
+  auto out_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("b", arrow::uint32(), false)}),
+                                               "Out",
+                                               fletcher::Mode::WRITE);
+  auto b = std::make_shared<arrow::UInt32Array>(4, arrow::AllocateBuffer(4 * sizeof(uint32_t)).ValueOrDie());
+  auto out = arrow::RecordBatch::Make(out_schema, 4, {b});
+
+  FletcherHandle *handle = nullptr;
+  ASSERT_EQ(fletcherCreate(nullptr, &handle), FLETCHER_STATUS_OK);
+
+  struct ArrowArray array;
+  struct ArrowSchema schema;
+  ASSERT_TRUE(arrow::ExportRecordBatch(*in, &array, &schema).ok());
+  ASSERT_EQ(fletcherQueueArrowArray(handle, &array, &schema, 0), FLETCHER_STATUS_OK);
+  ASSERT_EQ(array.release, nullptr);
+  ASSERT_TRUE(arrow::ExportRecordBatch(*out, &array, &schema).ok());
+  ASSERT_EQ(fletcherQueueArrowArray(handle, &array, &schema, 0), FLETCHER_STATUS_OK);
+  ASSERT_EQ(fletcherEnable(handle), FLETCHER_STATUS_OK);
+
+  ASSERT_EQ(fletcherExportRecordBatch(handle, 1, -1, &array, nullptr), FLETCHER_STATUS_ERROR);
+  ASSERT_NE(std::string(fletcherGetLastError(handle)), "");
+
+  ASSERT_EQ(fletcherExportRecordBatch(handle, 1, 2, &array, &schema), FLETCHER_STATUS_OK);
+  auto result = arrow::ImportRecordBatch(&array, &schema);
+  ASSERT_TRUE(result.ok());
+  ASSERT_EQ(result.ValueOrDie()->num_rows(), 2);
+  ASSERT_TRUE(result.ValueOrDie()->schema()->field(0)->Equals(out_schema->field(0)));
+  fletcherDestroy(handle);
+}
+
+TEST(Context, WriteModeRecordBatch) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::uint32(), false)}),
+                                           "Out",
+                                           fletcher::Mode::WRITE);
+  auto values = arrow::AllocateBuffer(16 * sizeof(uint32_t)).ValueOrDie();
+  auto array = std::make_shared<arrow::UInt32Array>(16, std::move(values));
+  auto rb = arrow::RecordBatch::Make(schema, 16, {array});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  ASSERT_TRUE(context->Enable().ok());
+  ASSERT_EQ(context->num_buffers(), 1);
+  auto buf = context->device_buffer(0);
+  ASSERT_EQ(buf.mode, fletcher::Mode::WRITE);
+  ASSERT_EQ(buf.size, 16 * sizeof(uint32_t));
+  // Echo does not share the host address space, so the output buffer must be allocated on the device.
+  ASSERT_TRUE(buf.was_alloced);
+  ASSERT_NE(buf.device_address, reinterpret_cast<da_t>(buf.host_address));
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, Materialize) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::uint32(), false),
+                                                           arrow::field("b", arrow::utf8(), false)}),
+                                           "Out",
+                                           fletcher::Mode::WRITE);
+  // Prepare uninitialized output buffers.
+  auto a = std::make_shared<arrow::UInt32Array>(4, arrow::AllocateBuffer(4 * sizeof(uint32_t)).ValueOrDie());
+  auto b = std::make_shared<arrow::StringArray>(4,
+                                                arrow::AllocateBuffer(5 * sizeof(int32_t)).ValueOrDie(),
+                                                arrow::AllocateBuffer(32).ValueOrDie());
+  auto rb = arrow::RecordBatch::Make(schema, 4, {a, b});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  ASSERT_TRUE(context->Enable().ok());
+
+  // Mimic a kernel writing to the device buffers.
+  std::vector<uint32_t> a_values = {1, 2, 3, 4};
+  std::vector<int32_t> b_offsets = {0, 5, 10, 18, 23};
+  std::string b_values = "helloworldfletcherarrow";
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(a_values.data()),
+                                         context->device_buffer(0).device_address,
+                                         a_values.size() * sizeof(uint32_t)).ok());
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(b_offsets.data()),
+                                         context->device_buffer(1).device_address,
+                                         b_offsets.size() * sizeof(int32_t)).ok());
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(&b_values[0]),
+                                         context->device_buffer(2).device_address,
+                                         b_values.size()).ok());
+
+  std::shared_ptr<arrow::RecordBatch> result;
+  ASSERT_TRUE(context->Materialize(0, &result).ok());
+  ASSERT_TRUE(result->ValidateFull().ok());
+  auto result_a = std::static_pointer_cast<arrow::UInt32Array>(result->column(0));
+  auto result_b = std::static_pointer_cast<arrow::StringArray>(result->column(1));
+  ASSERT_EQ(result_a->Value(3), 4);
+  ASSERT_EQ(result_b->GetString(0), "hello");
+  ASSERT_EQ(result_b->GetString(2), "fletcher");
+  ASSERT_EQ(result_b->GetString(3), "arrow");
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, MaterializeNulls) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::uint32(), true)}),
+                                           "Out",
+                                           fletcher::Mode::WRITE);
+  // An output column without nulls on the host side, of which the kernel writes the validity.
+  arrow::UInt32Builder builder;
+  ASSERT_TRUE(builder.AppendValues({0, 0, 0, 0}).ok());
+  auto rb = arrow::RecordBatch::Make(schema, 4, {builder.Finish().ValueOrDie()});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  ASSERT_TRUE(context->Enable().ok());
+  ASSERT_EQ(context->device_buffer(0).size, 1);
+
+  // Mimic a kernel writing to the device buffers, with element 2 being null.
+  uint8_t validity = 0x0B;
+  std::vector<uint32_t> values = {1, 2, 3, 4};
+  ASSERT_TRUE(platform->CopyHostToDevice(&validity, context->device_buffer(0).device_address, 1).ok());
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(values.data()),
+                                         context->device_buffer(1).device_address,
+                                         values.size() * sizeof(uint32_t)).ok());
+
+  std::shared_ptr<arrow::RecordBatch> result;
+  ASSERT_TRUE(context->Materialize(0, &result).ok());
+  ASSERT_TRUE(result->ValidateFull().ok());
+  ASSERT_EQ(result->column(0)->null_count(), 1);
+  ASSERT_TRUE(result->column(0)->IsNull(2));
+  ASSERT_EQ(std::static_pointer_cast<arrow::UInt32Array>(result->column(0))->Value(3), 4);
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, MaterializeLargeString) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("s", arrow::large_utf8(), false)}),
+                                           "Out",
+                                           fletcher::Mode::WRITE);
+  auto s = std::make_shared<arrow::LargeStringArray>(3,
+                                                     arrow::AllocateBuffer(4 * sizeof(int64_t)).ValueOrDie(),
+                                                     arrow::AllocateBuffer(32).ValueOrDie());
+  auto rb = arrow::RecordBatch::Make(schema, 3, {s});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  ASSERT_TRUE(context->Enable().ok());
+  ASSERT_EQ(context->device_buffer(0).size, 4 * sizeof(int64_t));
+
+  // Mimic a kernel writing 64-bit offsets.
+  std::vector<int64_t> s_offsets = {0, 5, 10, 18};
+  std::string s_values = "helloworldfletcher";
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(s_offsets.data()),
+                                         context->device_buffer(0).device_address,
+                                         s_offsets.size() * sizeof(int64_t)).ok());
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(&s_values[0]),
+                                         context->device_buffer(1).device_address,
+                                         s_values.size()).ok());
+
+  std::shared_ptr<arrow::RecordBatch> result;
+  ASSERT_TRUE(context->Materialize(0, &result).ok());
+  ASSERT_TRUE(result->ValidateFull().ok());
+  auto result_s = std::static_pointer_cast<arrow::LargeStringArray>(result->column(0));
+  ASSERT_EQ(result_s->GetString(1), "world");
+  ASSERT_EQ(result_s->GetString(2), "fletcher");
+
+  // Kernels with 64-bit index registers take ranges beyond 32 bits.
+  fletcher::Kernel kernel(context);
+  ASSERT_FALSE(kernel.SetRange(0, 0, int64_t(1) << 32).ok());
+  kernel.index_width = 64;
+  ASSERT_TRUE(kernel.SetRange(0, 0, int64_t(1) << 32).ok());
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, ProjectedRecordBatch) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::uint32(), false),
+                                                           arrow::field("b", arrow::utf8(), false),
+                                                           fletcher::WithMetaIgnore(*arrow::field("c",
+                                                                                                  arrow::uint8(),
+                                                                                                  false))}),
+                                           "Out",
+                                           fletcher::Mode::WRITE);
+  auto a = std::make_shared<arrow::UInt32Array>(4, arrow::AllocateBuffer(4 * sizeof(uint32_t)).ValueOrDie());
+  auto b = std::make_shared<arrow::StringArray>(4,
+                                                arrow::AllocateBuffer(5 * sizeof(int32_t)).ValueOrDie(),
+                                                arrow::AllocateBuffer(32).ValueOrDie());
+  arrow::UInt8Builder c_builder;
+  ASSERT_TRUE(c_builder.AppendValues({7, 8, 9, 10}).ok());
+  auto c = c_builder.Finish().ValueOrDie();
+  auto rb = arrow::RecordBatch::Make(schema, 4, {a, b, c});
+
+  // The ignored column is not made available to the device.
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  ASSERT_TRUE(context->Enable().ok());
+  ASSERT_EQ(context->num_buffers(), 3);
+
+  // A kernel schema selects a subset of the columns.
+  auto kernel_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::uint32(), false)}),
+                                                  "Out",
+                                                  fletcher::Mode::WRITE);
+  std::shared_ptr<fletcher::Context> projected;
+  ASSERT_TRUE(fletcher::Context::Make(&projected, platform).ok());
+  ASSERT_TRUE(projected->QueueRecordBatch(rb, kernel_schema).ok());
+  ASSERT_TRUE(projected->Enable().ok());
+  ASSERT_EQ(projected->num_buffers(), 1);
+  ASSERT_EQ(projected->GetQueueSize(), 4 * sizeof(uint32_t));
+
+  // Mimic a kernel writing the projected column. Other columns are materialized as they are on the host.
+  std::vector<uint32_t> a_values = {1, 2, 3, 4};
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(a_values.data()),
+                                         projected->device_buffer(0).device_address,
+                                         a_values.size() * sizeof(uint32_t)).ok());
+  std::shared_ptr<arrow::Array> result_a;
+  ASSERT_TRUE(projected->MaterializeColumn(0, 0, &result_a, 2).ok());
+  ASSERT_EQ(result_a->length(), 2);
+  ASSERT_EQ(std::static_pointer_cast<arrow::UInt32Array>(result_a)->Value(1), 2);
+  std::shared_ptr<arrow::Array> result_c;
+  ASSERT_TRUE(projected->MaterializeColumn(0, 2, &result_c, 2).ok());
+  ASSERT_TRUE(result_c->Equals(c->Slice(0, 2)));
+
+  // Slices keep the projection.
+  std::shared_ptr<fletcher::Context> sliced;
+  ASSERT_TRUE(projected->Slice(0, 2, &sliced).ok());
+  ASSERT_EQ(sliced->recordbatch_description(0).fields.size(), 1);
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, ResumeAfterOverflow) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto in_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false)}),
+                                              "In",
+                                              fletcher::Mode::READ);
+  arrow::UInt32Builder builder;
+  ASSERT_TRUE(builder.AppendValues({3, 4, 8, 5}).ok());
+  std::shared_ptr<arrow::Array> n;
+  ASSERT_TRUE(builder.Finish(&n).ok());
+  auto in = arrow::RecordBatch::Make(in_schema, 4, {n});
+
+  // Size the output for the expected case, which is too small for the actual output.
+  auto out_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("s", arrow::utf8(), false)}),
+                                               "Out",
+                                               fletcher::Mode::WRITE);
+  auto s = std::make_shared<arrow::StringArray>(4,
+                                                arrow::AllocateBuffer(5 * sizeof(int32_t)).ValueOrDie(),
+                                                arrow::AllocateBuffer(8).ValueOrDie());
+  auto out = arrow::RecordBatch::Make(out_schema, 4, {s});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(in).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(out).ok());
+  ASSERT_TRUE(context->Enable().ok());
+
+  // Mimic a kernel that completes two rows before it runs out of space.
+  std::vector<int32_t> offsets = {0, 3, 7};
+  std::string values = "abcdefg";
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(offsets.data()),
+                                         context->device_buffer(1).device_address,
+                                         offsets.size() * sizeof(int32_t)).ok());
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(&values[0]),
+                                         context->device_buffer(2).device_address,
+                                         values.size()).ok());
+
+  // Read back only the completed rows.
+  std::shared_ptr<arrow::RecordBatch> first;
+  ASSERT_TRUE(context->Materialize(1, &first, 2).ok());
+  ASSERT_TRUE(first->ValidateFull().ok());
+  ASSERT_EQ(first->num_rows(), 2);
+  auto first_s = std::static_pointer_cast<arrow::StringArray>(first->column(0));
+  ASSERT_EQ(first_s->value_data()->size(), 7);
+  ASSERT_EQ(first_s->GetString(1), "defg");
+
+  // Resume from the first row that was not completed, with larger output buffers.
+  std::shared_ptr<fletcher::Context> resumed;
+  ASSERT_FALSE(context->ResumeFrom(2, &resumed, 1.0).ok());
+  ASSERT_TRUE(context->ResumeFrom(2, &resumed).ok());
+  ASSERT_EQ(resumed->recordbatch(0)->num_rows(), 2);
+  ASSERT_EQ(std::static_pointer_cast<arrow::UInt32Array>(resumed->recordbatch(0)->column(0))->Value(0), 8);
+  ASSERT_EQ(resumed->recordbatch(1)->num_rows(), 2);
+  ASSERT_TRUE(resumed->Enable().ok());
+  ASSERT_EQ(resumed->device_buffer(2).size, 16);
+
+  offsets = {0, 8, 13};
+  values = "fletcherarrow";
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(offsets.data()),
+                                         resumed->device_buffer(1).device_address,
+                                         offsets.size() * sizeof(int32_t)).ok());
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(&values[0]),
+                                         resumed->device_buffer(2).device_address,
+                                         values.size()).ok());
+  std::shared_ptr<arrow::RecordBatch> second;
+  ASSERT_TRUE(resumed->Materialize(1, &second).ok());
+  ASSERT_TRUE(second->ValidateFull().ok());
+  auto second_s = std::static_pointer_cast<arrow::StringArray>(second->column(0));
+  ASSERT_EQ(second_s->GetString(0), "fletcher");
+  ASSERT_EQ(second_s->GetString(1), "arrow");
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Kernel, GetOverflow) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  fletcher::Kernel kernel(context);
+
+  // The echo platform reads MMIO registers from stdin: the status registers, followed by the return registers.
+  {
+    std::ofstream mmio("test-runtime-overflow.txt");
+    mmio << "4\n"            // Done, without overflow.
+         << "C\n2\n"         // Overflow after 2 rows.
+         << "C\n1\n2\n";    // Overflow after 2^32 + 2 rows, with 64-bit indices (high word first).
+  }
+  ASSERT_NE(freopen("test-runtime-overflow.txt", "r", stdin), nullptr);
+
+  bool overflow = true;
+  int64_t rows = 0;
+  ASSERT_TRUE(kernel.GetOverflow(&overflow, &rows).ok());
+  ASSERT_FALSE(overflow);
+  ASSERT_TRUE(kernel.GetOverflow(&overflow, &rows).ok());
+  ASSERT_TRUE(overflow);
+  ASSERT_EQ(rows, 2);
+  kernel.index_width = 64;
+  ASSERT_TRUE(kernel.GetOverflow(&overflow, &rows).ok());
+  ASSERT_TRUE(overflow);
+  ASSERT_EQ(rows, (int64_t(1) << 32) + 2);
+
+  ASSERT_NE(freopen("/dev/null", "r", stdin), nullptr);
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, MemoryBudget) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false),
+                                                           arrow::field("s", arrow::utf8(), false)}),
+                                           "In",
+                                           fletcher::Mode::READ);
+  arrow::UInt32Builder nb;
+  arrow::StringBuilder sb;
+  for (uint32_t i = 0; i < 100; i++) {
+    ASSERT_TRUE(nb.Append(i).ok());
+    // Make the last rows much larger than the others.
+    ASSERT_TRUE(sb.Append(std::string(i < 90 ? 1 : 40, 'x')).ok());
+  }
+  std::shared_ptr<arrow::Array> n, s;
+  ASSERT_TRUE(nb.Finish(&n).ok());
+  ASSERT_TRUE(sb.Finish(&s).ok());
+  auto rb = arrow::RecordBatch::Make(schema, 100, {n, s});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  context->set_memory_budget(256);
+  ASSERT_FALSE(context->FitsMemoryBudget());
+  ASSERT_EQ(context->Enable(), fletcher::Status::DEVICE_OUT_OF_MEMORY());
+
+  // The ranges must cover all rows and each fit the budget.
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+  ASSERT_TRUE(context->Partition(&ranges).ok());
+  ASSERT_GT(ranges.size(), 1);
+  int64_t next = 0;
+  for (const auto &r : ranges) {
+    ASSERT_EQ(r.first, next);
+    std::shared_ptr<fletcher::Context> range;
+    ASSERT_TRUE(context->Slice(r.first, r.second, &range).ok());
+    ASSERT_TRUE(range->FitsMemoryBudget());
+    next = r.second;
+  }
+  ASSERT_EQ(next, 100);
+
+  // Run the kernel over every range, and merge the return values.
+  fletcher::Kernel kernel(context);
+  kernel.done_status_mask = 0;
+  kernel.done_status = 0;
+  size_t combined = 0;
+  uint32_t ret0 = 0, ret1 = 0;
+  ASSERT_TRUE(kernel.RunPartitioned([&combined](uint32_t *acc0, uint32_t *acc1, uint32_t r0, uint32_t r1) {
+    combined++;
+  }, &ret0, &ret1).ok());
+  ASSERT_EQ(combined, ranges.size() - 1);
+
+  // A single row that exceeds the budget can't be partitioned.
+  context->set_memory_budget(16);
+  ASSERT_EQ(context->Partition(&ranges), fletcher::Status::DEVICE_OUT_OF_MEMORY());
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(BatchCoalescer, CoalesceAndSplit) {
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("s", arrow::utf8(), true)}),
+                                           "In",
+                                           fletcher::Mode::READ);
+  std::shared_ptr<fletcher::BatchCoalescer> coalescer;
+  ASSERT_TRUE(fletcher::BatchCoalescer::Make(&coalescer, schema).ok());
+
+  std::vector<std::vector<std::string>> values = {{"a", "bb"}, {}, {"ccc", "dddd", "e"}};
+  for (const auto &v : values) {
+    arrow::StringBuilder builder;
+    for (const auto &s : v) {
+      ASSERT_TRUE(s == "dddd" ? builder.AppendNull().ok() : builder.Append(s).ok());
+    }
+    std::shared_ptr<arrow::Array> array;
+    ASSERT_TRUE(builder.Finish(&array).ok());
+    ASSERT_TRUE(coalescer->Append(arrow::RecordBatch::Make(schema, array->length(), {array})).ok());
+  }
+  ASSERT_EQ(coalescer->num_batches(), 3);
+  ASSERT_EQ(coalescer->num_rows(), 5);
+
+  auto other = arrow::schema({arrow::field("n", arrow::uint32(), false)});
+  ASSERT_FALSE(coalescer->Append(arrow::RecordBatch::Make(other, 0, {std::make_shared<arrow::UInt32Array>(
+      0, nullptr)})).ok());
+
+  std::shared_ptr<arrow::RecordBatch> combined;
+  ASSERT_TRUE(coalescer->Finish(&combined).ok());
+  ASSERT_TRUE(combined->ValidateFull().ok());
+  auto s = std::static_pointer_cast<arrow::StringArray>(combined->column(0));
+  ASSERT_EQ(s->GetString(2), "ccc");
+  ASSERT_TRUE(s->IsNull(3));
+  ASSERT_EQ(s->GetString(4), "e");
+
+  size_t batch = 0;
+  int64_t row = 0;
+  ASSERT_TRUE(coalescer->Locate(2, &batch, &row).ok());
+  ASSERT_EQ(batch, 2);
+  ASSERT_EQ(row, 0);
+  ASSERT_FALSE(coalescer->Locate(5, &batch, &row).ok());
+
+  std::vector<std::shared_ptr<arrow::RecordBatch>> split;
+  ASSERT_TRUE(coalescer->Split(combined, &split).ok());
+  ASSERT_EQ(split.size(), 3);
+  ASSERT_EQ(split[1]->num_rows(), 0);
+  ASSERT_EQ(std::static_pointer_cast<arrow::StringArray>(split[2]->column(0))->GetString(0), "ccc");
+}
+
+TEST(Context, EnablePacked) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto in_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("s", arrow::utf8(), true)}),
+                                              "In",
+                                              fletcher::Mode::READ);
+  arrow::StringBuilder builder;
+  ASSERT_TRUE(builder.Append("fletcher").ok());
+  ASSERT_TRUE(builder.AppendNull().ok());
+  ASSERT_TRUE(builder.Append("arrow").ok());
+  std::shared_ptr<arrow::Array> s;
+  ASSERT_TRUE(builder.Finish(&s).ok());
+  auto in = arrow::RecordBatch::Make(in_schema, 3, {s});
+
+  auto out_schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false)}),
+                                               "Out",
+                                               fletcher::Mode::WRITE);
+  auto n = std::make_shared<arrow::UInt32Array>(3, arrow::AllocateBuffer(3 * sizeof(uint32_t)).ValueOrDie());
+  auto out = arrow::RecordBatch::Make(out_schema, 3, {n});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(in).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(out).ok());
+  ASSERT_FALSE(context->EnablePacked(0).ok());
+  // The padding of the buffers in the arena counts towards the budget.
+  context->set_memory_budget(128);
+  ASSERT_TRUE(context->FitsMemoryBudget());
+  ASSERT_EQ(context->EnablePacked(64), fletcher::Status::DEVICE_OUT_OF_MEMORY());
+  context->set_memory_budget(0);
+  ASSERT_TRUE(context->EnablePacked(64).ok());
+  ASSERT_EQ(context->num_buffers(), 4);
+  // A Context can be enabled only once.
+  ASSERT_FALSE(context->EnablePacked(64).ok());
+  ASSERT_EQ(context->num_buffers(), 4);
+
+  // All buffers are consecutive and aligned within a single allocation, and hold the input data.
+  auto base = context->device_buffer(0).device_address;
+  for (size_t i = 0; i < context->num_buffers(); i++) {
+    auto buf = context->device_buffer(i);
+    ASSERT_FALSE(buf.was_alloced);
+    ASSERT_EQ((buf.device_address - base) % 64, 0);
+    ASSERT_EQ(buf.device_address - base, 64 * i);
+    if (buf.mode == fletcher::Mode::READ) {
+      std::vector<uint8_t> data(buf.size);
+      ASSERT_TRUE(platform->CopyDeviceToHost(buf.device_address, data.data(), buf.size).ok());
+      ASSERT_EQ(std::memcmp(data.data(), buf.host_address, buf.size), 0);
+    }
+  }
+
+  // Outputs are read back from the arena.
+  std::vector<uint32_t> values = {1, 2, 3};
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(values.data()),
+                                         context->device_buffer(3).device_address,
+                                         values.size() * sizeof(uint32_t)).ok());
+  std::shared_ptr<arrow::RecordBatch> result;
+  ASSERT_TRUE(context->Materialize(1, &result).ok());
+  ASSERT_EQ(std::static_pointer_cast<arrow::UInt32Array>(result->column(0))->Value(2), 3);
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, ChunkedTransfer) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false)}),
+                                           "In",
+                                           fletcher::Mode::READ);
+  arrow::UInt32Builder builder;
+  for (uint32_t i = 0; i < 1000; i++) {
+    ASSERT_TRUE(builder.Append(i).ok());
+  }
+  std::shared_ptr<arrow::Array> n;
+  ASSERT_TRUE(builder.Finish(&n).ok());
+  auto batch = arrow::RecordBatch::Make(schema, 1000, {n});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  // Chunks that don't divide the buffer size, so the last one is partial.
+  context->set_transfer_chunk_size(999);
+  ASSERT_EQ(context->transfer_chunk_size(), 999);
+  ASSERT_TRUE(context->QueueRecordBatch(batch, fletcher::MemType::CACHE).ok());
+  ASSERT_TRUE(context->Enable().ok());
+
+  auto buf = context->device_buffer(0);
+  ASSERT_TRUE(buf.was_alloced);
+  ASSERT_EQ(buf.size, 4000);
+  std::vector<uint8_t> data(buf.size);
+  ASSERT_TRUE(platform->CopyDeviceToHost(buf.device_address, data.data(), buf.size).ok());
+  ASSERT_EQ(std::memcmp(data.data(), buf.host_address, buf.size), 0);
+}
+
+TEST(Context, LazyRecordBatch) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("a", arrow::uint32(), false),
+                                                           arrow::field("b", arrow::utf8(), false)}),
+                                           "Out",
+                                           fletcher::Mode::WRITE);
+  auto a = std::make_shared<arrow::UInt32Array>(2, arrow::AllocateBuffer(2 * sizeof(uint32_t)).ValueOrDie());
+  auto b = std::make_shared<arrow::StringArray>(2,
+                                                arrow::AllocateBuffer(3 * sizeof(int32_t)).ValueOrDie(),
+                                                arrow::AllocateBuffer(16).ValueOrDie());
+  auto rb = arrow::RecordBatch::Make(schema, 2, {a, b});
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(rb).ok());
+  ASSERT_TRUE(context->Enable().ok());
+
+  std::vector<int32_t> b_offsets = {0, 5, 10};
+  std::string b_values = "helloworld";
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(b_offsets.data()),
+                                         context->device_buffer(1).device_address,
+                                         b_offsets.size() * sizeof(int32_t)).ok());
+  ASSERT_TRUE(platform->CopyHostToDevice(reinterpret_cast<uint8_t *>(&b_values[0]),
+                                         context->device_buffer(2).device_address,
+                                         b_values.size()).ok());
+
+  std::shared_ptr<fletcher::LazyRecordBatch> lazy;
+  ASSERT_TRUE(fletcher::LazyRecordBatch::Make(&lazy, context, 0).ok());
+  ASSERT_FALSE(lazy->is_materialized(1));
+
+  // Only the accessed column is read back, once.
+  std::shared_ptr<arrow::Array> column, again;
+  ASSERT_TRUE(lazy->column(1, &column).ok());
+  ASSERT_TRUE(lazy->is_materialized(1));
+  ASSERT_FALSE(lazy->is_materialized(0));
+  ASSERT_EQ(std::static_pointer_cast<arrow::StringArray>(column)->GetString(1), "world");
+  ASSERT_TRUE(lazy->column(1, &again).ok());
+  ASSERT_EQ(column, again);
+  ASSERT_FALSE(lazy->column(2, &column).ok());
+
+  std::shared_ptr<arrow::RecordBatch> result;
+  ASSERT_TRUE(lazy->ToRecordBatch(&result).ok());
+  ASSERT_TRUE(lazy->is_materialized(0));
+  ASSERT_EQ(result->num_columns(), 2);
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Context, AutoPlacement) {
+  fletcher::PlacementModel model;
+  model.host_access_bandwidth = 1e9;
+  model.device_access_bandwidth = 4e9;
+  model.transfer_bandwidth = 1e9;
+  // Caching costs 1 host access and saves 0.75 per launch, so it pays off from the second launch.
+  ASSERT_FALSE(model.ShouldPromote(1024, 1));
+  ASSERT_TRUE(model.ShouldPromote(1024, 2));
+  // Never promote if on-board memory is not faster.
+  model.device_access_bandwidth = 1e9;
+  ASSERT_FALSE(model.ShouldPromote(1024, 1000));
+
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false)}),
+                                           "In",
+                                           fletcher::Mode::READ);
+  arrow::UInt32Builder builder;
+  ASSERT_TRUE(builder.AppendValues({1, 2, 3}).ok());
+  std::shared_ptr<arrow::Array> n;
+  ASSERT_TRUE(builder.Finish(&n).ok());
+
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(arrow::RecordBatch::Make(schema, 3, {n}), fletcher::MemType::AUTO).ok());
+  ASSERT_TRUE(context->Enable().ok());
+
+  // Echo copies buffers to its "on-board" memory in any case, so there is nothing to promote.
+  fletcher::Kernel kernel(context);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(kernel.Start().ok());
+  }
+  ASSERT_EQ(context->device_buffer(0).launches, 3);
+  ASSERT_EQ(context->placement_statistics().promotions, 0);
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(DeviceCatalog, QueueResidentTable) {
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false)}),
+                                           "Ref",
+                                           fletcher::Mode::READ);
+  arrow::UInt32Builder builder;
+  ASSERT_TRUE(builder.AppendValues({1, 2, 3, 4}).ok());
+  std::shared_ptr<arrow::Array> n;
+  ASSERT_TRUE(builder.Finish(&n).ok());
+  auto table = arrow::Table::Make(schema, {std::make_shared<arrow::ChunkedArray>(arrow::ArrayVector{n->Slice(0, 2),
+                                                                                                   n->Slice(2)})});
+
+  std::shared_ptr<fletcher::DeviceCatalog> catalog;
+  ASSERT_TRUE(fletcher::DeviceCatalog::Make(&catalog, platform).ok());
+  catalog->set_capacity(24);
+  std::shared_ptr<fletcher::CatalogEntry> handle;
+  ASSERT_TRUE(catalog->Register("ref", table, &handle).ok());
+  ASSERT_FALSE(catalog->Register("ref", table, &handle).ok());
+  ASSERT_EQ(catalog->Register("other", table, &handle), fletcher::Status::DEVICE_OUT_OF_MEMORY());
+  ASSERT_TRUE(catalog->Lookup("ref", &handle).ok());
+  ASSERT_EQ(handle->batch()->num_rows(), 4);
+  ASSERT_EQ(catalog->bytes_resident(), 16);
+
+  // Queue the resident table in two Contexts; both use the same device buffer.
+  da_t addresses[2];
+  for (int i = 0; i < 2; i++) {
+    std::shared_ptr<fletcher::Context> context;
+    ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+    ASSERT_TRUE(context->QueueCatalogEntry(handle).ok());
+    ASSERT_EQ(context->GetUploadSize(), 0);
+    ASSERT_TRUE(context->Enable().ok());
+    ASSERT_FALSE(context->device_buffer(0).was_alloced);
+    addresses[i] = context->device_buffer(0).device_address;
+  }
+  ASSERT_EQ(addresses[0], addresses[1]);
+  ASSERT_EQ(addresses[0], handle->context()->device_buffer(0).device_address);
+
+  // Evicted tables stay resident while handles to them exist.
+  ASSERT_TRUE(catalog->Evict("ref").ok());
+  ASSERT_FALSE(catalog->Lookup("ref", &handle).ok());
+  ASSERT_EQ(catalog->bytes_resident(), 16);
+  handle.reset();
+  ASSERT_EQ(catalog->bytes_resident(), 0);
+  ASSERT_TRUE(platform->Terminate().ok());
+}
+
+TEST(Metrics, Registry) {
+  if (!fletcher::Metrics::enabled()) {
+    GTEST_SKIP() << "Metrics are disabled.";
+  }
+  auto &metrics = fletcher::Metrics::Global();
+  metrics.Reset();
+
+  std::shared_ptr<fletcher::Platform> platform;
+  ASSERT_TRUE(fletcher::Platform::Make(&platform, false).ok());
+  ASSERT_TRUE(platform->Init().ok());
+  auto schema = fletcher::WithMetaRequired(*arrow::schema({arrow::field("n", arrow::uint32(), false)}),
+                                           "Ref",
+                                           fletcher::Mode::READ);
+  arrow::UInt32Builder builder;
+  ASSERT_TRUE(builder.AppendValues({1, 2, 3, 4}).ok());
+  std::shared_ptr<arrow::Array> n;
+  ASSERT_TRUE(builder.Finish(&n).ok());
+  std::shared_ptr<fletcher::Context> context;
+  ASSERT_TRUE(fletcher::Context::Make(&context, platform).ok());
+  ASSERT_TRUE(context->QueueRecordBatch(arrow::RecordBatch::Make(schema, 4, {n}), fletcher::MemType::CACHE).ok());
+  ASSERT_TRUE(context->Enable().ok());
+
+  fletcher::Kernel kernel(context);
+  kernel.done_status_mask = 0;
+  kernel.done_status = 0;
+  ASSERT_TRUE(kernel.Start().ok());
+  ASSERT_TRUE(kernel.PollUntilDone().ok());
+
+  auto snapshot = metrics.Snapshot();
+  ASSERT_EQ(snapshot.counter("bytes_host_to_device"), 16);
+  ASSERT_EQ(snapshot.counter("kernel_launches"), 1);
+  // Starting writes the range, the buffer address, and the control register twice.
+  ASSERT_EQ(snapshot.counter("mmio_writes"), 6);
+  ASSERT_EQ(snapshot.histogram("kernel_start_mmio").max, 6);
+  ASSERT_EQ(snapshot.histogram("kernel_completion_mmio").max, 1);
+  ASSERT_EQ(snapshot.histogram("context_enable_ns").count, 1);
+  ASSERT_EQ(snapshot.histogram("kernel_completion_ns").count, 1);
+  ASSERT_GT(snapshot.histogram("kernel_start_ns").Quantile(0.5), 0);
+
+  // The dump holds the JSON representation of a snapshot.
+  ASSERT_TRUE(metrics.StartDump("test-metrics.json", std::chrono::milliseconds(1)).ok());
+  metrics.StopDump();
+  std::ifstream file("test-metrics.json");
+  std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  ASSERT_NE(json.find("\"kernel_launches\":1"), std::string::npos);
+  ASSERT_NE(json.find("\"kernel_start_mmio\":{\"count\":1,\"sum\":6,\"max\":6"), std::string::npos);
   ASSERT_TRUE(platform->Terminate().ok());
 }